@@ -0,0 +1,949 @@
+//
+// Copyright (c) 2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+// Headless benchmark, renders the demo and stress scenes with the CPU back-end
+// and prints the timings and counters per frame as JSON.
+//
+// Usage: bench [-frames n] [-warmup n] [-scene name] [-null] [-analytic] [-textcache] [-verify-simd] [-verify-textcache] [-verify-triangulation] [-verify-allocations]
+//   -null              discards the rasterization, measures nanovg only.
+//   -analytic          flattens the curves using NVG_FLATTEN_ANALYTIC.
+//   -textcache         enables the text layout cache.
+//   -verify-simd       checks that the SIMD kernels produce the same vertices and glyph blur as the scalar code.
+//                      The blur is checked with every radius, "-scene blur" checks only the blur.
+//   -verify-textcache  checks that the text layout cache renders the same pixels as without it.
+//   -verify-triangulation  checks that triangulated concave fills render the same pixels as stenciled ones.
+//   -verify-allocations    checks that the frames after the warmup make no heap calls.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#else
+#	include <time.h>
+#endif
+#include "nanovg.h"
+#include "fontstash.h"
+#define NANOVG_SW_IMPLEMENTATION
+#include "nanovg_sw.h"
+#include "demo.h"
+
+#define BENCH_WIDTH 1000
+#define BENCH_HEIGHT 600
+#define BENCH_STROKES 10000
+#define BENCH_GLYPHS 100000
+#define BENCH_GLYPHS_PER_LINE 100
+#define BENCH_GLYPH_SIZES 24
+#define BENCH_CODEPOINTS (94 + 223)
+#define BENCH_BLUR_RADII 20
+#define BENCH_BLUR_GLYPHS 32
+#define BENCH_SCISSOR_STACKS 64
+#define BENCH_SCISSOR_DEPTH 24
+#define BENCH_GRADIENTS 24
+#define BENCH_IMAGES 256
+#define BENCH_IMAGE_SIZE 64
+#define BENCH_BLUR_MAX_SIZE 40
+#define BENCH_CONCAVE 540
+
+struct BenchData {
+	DemoData demo;
+	int images[BENCH_IMAGES];
+	char text[BENCH_GLYPHS_PER_LINE+1];
+	char latinText[BENCH_CODEPOINTS*2+1];
+};
+typedef struct BenchData BenchData;
+
+struct BenchScene {
+	const char* name;
+	void (*render)(NVGcontext* vg, BenchData* data, float t);
+};
+typedef struct BenchScene BenchScene;
+
+struct BenchCounters {
+	int allocs;
+	int frees;
+};
+typedef struct BenchCounters BenchCounters;
+
+// Geometry passed to the back-end during a frame.
+struct BenchCapture {
+	NVGparams backend;	// Callbacks of the wrapped back-end.
+	unsigned char* data;
+	int size;
+	int capacity;
+};
+typedef struct BenchCapture BenchCapture;
+
+static double getTime()
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq, t;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t);
+	return (double)t.QuadPart / (double)freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Allocator counting the heap traffic of the context.
+static void* benchAlloc(void* userPtr, int size)
+{
+	((BenchCounters*)userPtr)->allocs++;
+	return malloc(size);
+}
+
+static void* benchResize(void* userPtr, void* ptr, int size)
+{
+	((BenchCounters*)userPtr)->allocs++;
+	return realloc(ptr, size);
+}
+
+static void benchRelease(void* userPtr, void* ptr)
+{
+	((BenchCounters*)userPtr)->frees++;
+	free(ptr);
+}
+
+// Deterministic random numbers so that every run draws the same scene.
+static unsigned int randState = 1;
+static float frand()
+{
+	randState = randState * 1664525u + 1013904223u;
+	return (float)(randState >> 8) / 16777216.0f;
+}
+
+static BenchCapture captures[2];
+
+static BenchCapture* findCapture(void* uptr)
+{
+	return captures[0].backend.userPtr == uptr ? &captures[0] : &captures[1];
+}
+
+static void captureBytes(BenchCapture* cap, const void* data, int size)
+{
+	if (cap->size + size > cap->capacity) {
+		int capacity = cap->size + size + cap->capacity/2;
+		unsigned char* bytes = (unsigned char*)realloc(cap->data, capacity);
+		if (bytes == NULL) return;
+		cap->data = bytes;
+		cap->capacity = capacity;
+	}
+	memcpy(&cap->data[cap->size], data, size);
+	cap->size += size;
+}
+
+static void capturePaths(BenchCapture* cap, const NVGpath* paths, int npaths)
+{
+	int i;
+	for (i = 0; i < npaths; i++) {
+		int counts[3];
+		counts[0] = paths[i].nfill;
+		counts[1] = paths[i].nstroke;
+		counts[2] = paths[i].convex;
+		captureBytes(cap, counts, sizeof(counts));
+		captureBytes(cap, paths[i].fill, sizeof(NVGvertex) * paths[i].nfill);
+		captureBytes(cap, paths[i].stroke, sizeof(NVGvertex) * paths[i].nstroke);
+	}
+}
+
+static void captureFill(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+						const float* bounds, const NVGpath* paths, int npaths)
+{
+	BenchCapture* cap = findCapture(uptr);
+	captureBytes(cap, bounds, sizeof(float)*4);
+	capturePaths(cap, paths, npaths);
+	cap->backend.renderFill(uptr, paint, compositeOperation, scissor, fringe, bounds, paths, npaths);
+}
+
+static void captureStroke(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+						  float strokeWidth, const NVGpath* paths, int npaths)
+{
+	BenchCapture* cap = findCapture(uptr);
+	capturePaths(cap, paths, npaths);
+	cap->backend.renderStroke(uptr, paint, compositeOperation, scissor, fringe, strokeWidth, paths, npaths);
+}
+
+static void captureTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+							 const NVGvertex* verts, int nverts, float fringe)
+{
+	BenchCapture* cap = findCapture(uptr);
+	captureBytes(cap, verts, sizeof(NVGvertex) * nverts);
+	cap->backend.renderTriangles(uptr, paint, compositeOperation, scissor, verts, nverts, fringe);
+}
+
+// Routes the geometry of the context through the capture callbacks.
+static void hookCapture(NVGcontext* vg, BenchCapture* cap)
+{
+	NVGparams* params = nvgInternalParams(vg);
+	memset(cap, 0, sizeof(*cap));
+	cap->backend = *params;
+	params->renderFill = captureFill;
+	params->renderStroke = captureStroke;
+	params->renderTriangles = captureTriangles;
+}
+
+static void renderDemoScene(NVGcontext* vg, BenchData* data, float t)
+{
+	renderDemo(vg, BENCH_WIDTH*0.5f, BENCH_HEIGHT*0.5f, BENCH_WIDTH, BENCH_HEIGHT, t, 0, &data->demo);
+}
+
+static void renderStrokes(NVGcontext* vg, BenchData* data, float t)
+{
+	int i;
+	NVG_NOTUSED(data);
+	NVG_NOTUSED(t);
+	randState = 1;
+	nvgLineCap(vg, NVG_ROUND);
+	nvgLineJoin(vg, NVG_ROUND);
+	for (i = 0; i < BENCH_STROKES; i++) {
+		float x = frand()*BENCH_WIDTH, y = frand()*BENCH_HEIGHT;
+		nvgBeginPath(vg);
+		nvgMoveTo(vg, x, y);
+		if (i & 1)
+			nvgBezierTo(vg, x + frand()*80-40, y + frand()*80-40, x + frand()*80-40, y + frand()*80-40, x + frand()*80-40, y + frand()*80-40);
+		else
+			nvgLineTo(vg, x + frand()*80-40, y + frand()*80-40);
+		nvgStrokeColor(vg, nvgRGBA((unsigned char)(frand()*255), (unsigned char)(frand()*255), 128, 160));
+		nvgStrokeWidth(vg, 0.5f + frand()*3.0f);
+		nvgStroke(vg);
+	}
+}
+
+static void renderGlyphs(NVGcontext* vg, BenchData* data, float t)
+{
+	int i, nlines = BENCH_GLYPHS / BENCH_GLYPHS_PER_LINE;
+	NVG_NOTUSED(t);
+	nvgFontFaceId(vg, data->demo.fontNormal);
+	nvgFontSize(vg, 11.0f);
+	nvgTextAlign(vg, NVG_ALIGN_LEFT|NVG_ALIGN_TOP);
+	nvgFillColor(vg, nvgRGBA(255,255,255,200));
+	for (i = 0; i < nlines; i++) {
+		float x = (float)((i / 50) % 2) * BENCH_WIDTH*0.5f;
+		float y = (float)(i % 50) * 12.0f;
+		nvgText(vg, x, y, data->text, NULL);
+	}
+}
+
+// Many sizes of the same code points, stresses the glyph lookup.
+static void renderGlyphSizes(NVGcontext* vg, BenchData* data, float t)
+{
+	int i;
+	float y = 0.0f;
+	NVG_NOTUSED(t);
+	nvgFontFaceId(vg, data->demo.fontNormal);
+	nvgTextAlign(vg, NVG_ALIGN_LEFT|NVG_ALIGN_TOP);
+	nvgFillColor(vg, nvgRGBA(255,255,255,200));
+	for (i = 0; i < BENCH_GLYPH_SIZES; i++) {
+		float size = 8.0f + i;
+		nvgFontSize(vg, size);
+		nvgText(vg, 0, y, data->latinText, NULL);
+		y += size;
+	}
+}
+
+// Text shadows with blur radii 1-20. The size changes every frame so that the glyphs
+// are rasterized and blurred again, glyphRasterizeTime measures the blur.
+static void renderGlyphBlur(NVGcontext* vg, BenchData* data, float t)
+{
+	int i, frame = (int)(t * 60.0f + 0.5f);
+	nvgFontFaceId(vg, data->demo.fontNormal);
+	nvgFontSize(vg, 18.0f + (frame % 50) * 0.1f);
+	nvgTextAlign(vg, NVG_ALIGN_LEFT|NVG_ALIGN_TOP);
+	nvgFillColor(vg, nvgRGBA(0,0,0,128));
+	for (i = 0; i < BENCH_BLUR_RADII; i++) {
+		nvgFontBlur(vg, (float)(i+1));
+		nvgText(vg, 0, i * 30.0f, data->text, data->text + BENCH_BLUR_GLYPHS);
+	}
+	nvgFontBlur(vg, 0);
+}
+
+// A string which stays the same, and every fourth frame text which overflows the atlas so that
+// glyphs are evicted after the string was drawn. The text layout cache reuses the string in
+// between. The size changes so that the atlas keeps overflowing after it has grown.
+static void renderTextChurn(NVGcontext* vg, BenchData* data, float t)
+{
+	int frame = (int)(t * 60.0f + 0.5f);
+	nvgFontFaceId(vg, data->demo.fontNormal);
+	nvgTextAlign(vg, NVG_ALIGN_LEFT|NVG_ALIGN_TOP);
+	nvgFillColor(vg, nvgRGBA(255,255,255,255));
+	nvgFontSize(vg, 24.0f);
+	nvgText(vg, 0, 0, data->text, NULL);
+	if (frame % 4 == 3) {
+		nvgFontSize(vg, 40.0f + (frame / 4 % 40) * 0.5f);
+		nvgText(vg, 0, 30, data->latinText, NULL);
+	}
+}
+
+// Stars, L shapes, crescents and pies can be triangulated, self intersecting bowties are stenciled.
+// Every other shape is translucent, so that fringes drawn twice would show.
+static void renderConcave(NVGcontext* vg, BenchData* data, float t)
+{
+	int i, j;
+	NVG_NOTUSED(data);
+	for (i = 0; i < BENCH_CONCAVE; i++) {
+		float x = 20 + (i % 30) * 32.0f, y = 20 + (i / 30) * 32.0f;
+		nvgSave(vg);
+		nvgTranslate(vg, x, y);
+		nvgRotate(vg, t + i*0.1f);
+		nvgBeginPath(vg);
+		switch (i % 5) {
+		case 0:
+			for (j = 0; j < 10; j++) {
+				float r = (j & 1) ? 6.0f : 14.0f, a = j * NVG_PI / 5;
+				if (j == 0)
+					nvgMoveTo(vg, cosf(a)*r, sinf(a)*r);
+				else
+					nvgLineTo(vg, cosf(a)*r, sinf(a)*r);
+			}
+			break;
+		case 1:
+			nvgMoveTo(vg, -12, -12);
+			nvgLineTo(vg, -4, -12);
+			nvgLineTo(vg, -4, 4);
+			nvgLineTo(vg, 12, 4);
+			nvgLineTo(vg, 12, 12);
+			nvgLineTo(vg, -12, 12);
+			break;
+		case 2:
+			nvgMoveTo(vg, 0, -13);
+			nvgBezierTo(vg, 18, -13, 18, 13, 0, 13);
+			nvgBezierTo(vg, 9, 5, 9, -5, 0, -13);
+			break;
+		case 3:
+			nvgMoveTo(vg, 0, 0);
+			nvgArc(vg, 0, 0, 13, 0.3f, 5.5f, NVG_CW);
+			break;
+		default:
+			nvgMoveTo(vg, -12, -12);
+			nvgLineTo(vg, 12, 12);
+			nvgLineTo(vg, 12, -12);
+			nvgLineTo(vg, -12, 12);
+			break;
+		}
+		nvgClosePath(vg);
+		if (i & 8)
+			nvgFillPaint(vg, nvgLinearGradient(vg, -14, -14, 14, 14, nvgRGBA(255,200,0,255), nvgRGBA(0,100,255,160)));
+		else
+			nvgFillColor(vg, nvgRGBA(220, (unsigned char)(90 + (i%3)*50), 60, (i & 4) ? 140 : 255));
+		nvgFill(vg);
+		nvgRestore(vg);
+	}
+}
+
+static void renderScissor(NVGcontext* vg, BenchData* data, float t)
+{
+	int i, j;
+	NVG_NOTUSED(data);
+	for (i = 0; i < BENCH_SCISSOR_STACKS; i++) {
+		float x = (float)(i % 8) * BENCH_WIDTH/8.0f, y = (float)(i / 8) * BENCH_HEIGHT/8.0f;
+		nvgSave(vg);
+		nvgTranslate(vg, x + 60, y + 37);
+		for (j = 0; j < BENCH_SCISSOR_DEPTH; j++) {
+			nvgSave(vg);
+			nvgRotate(vg, t*0.1f + j*0.05f);
+			nvgIntersectScissor(vg, -60 + j, -40 + j, 120 - j, 80 - j);
+			nvgBeginPath(vg);
+			nvgRect(vg, -60, -40, 120, 80);
+			nvgFillColor(vg, nvgRGBA((unsigned char)(j*10), 128, (unsigned char)(255-j*10), 40));
+			nvgFill(vg);
+		}
+		for (j = 0; j < BENCH_SCISSOR_DEPTH; j++)
+			nvgRestore(vg);
+		nvgRestore(vg);
+	}
+}
+
+static void renderGradients(NVGcontext* vg, BenchData* data, float t)
+{
+	int i;
+	NVG_NOTUSED(data);
+	for (i = 0; i < BENCH_GRADIENTS; i++) {
+		NVGcolor c0 = nvgHSLA(i/(float)BENCH_GRADIENTS, 0.8f, 0.5f, 64);
+		NVGcolor c1 = nvgHSLA(1.0f - i/(float)BENCH_GRADIENTS, 0.8f, 0.5f, 0);
+		NVGpaint paint;
+		float a = t + i*0.3f;
+		if (i % 3 == 0)
+			paint = nvgLinearGradient(vg, 0, 0, BENCH_WIDTH*cosf(a), BENCH_HEIGHT*sinf(a), c0, c1);
+		else if (i % 3 == 1)
+			paint = nvgRadialGradient(vg, BENCH_WIDTH*0.5f, BENCH_HEIGHT*0.5f, 10, BENCH_WIDTH*0.5f + i*10, c0, c1);
+		else
+			paint = nvgBoxGradient(vg, 50+i*5, 50+i*5, BENCH_WIDTH-100-i*10, BENCH_HEIGHT-100-i*10, 40, 80, c0, c1);
+		nvgBeginPath(vg);
+		nvgRect(vg, 0, 0, BENCH_WIDTH, BENCH_HEIGHT);
+		nvgFillPaint(vg, paint);
+		nvgFill(vg);
+	}
+}
+
+static void renderImages(NVGcontext* vg, BenchData* data, float t)
+{
+	int i;
+	float s = 36.0f;
+	int cols = (int)(BENCH_WIDTH / s);
+	for (i = 0; i < BENCH_IMAGES; i++) {
+		float x = (i % cols) * s + s*0.5f, y = (i / cols) * s + s*0.5f;
+		NVGpaint img;
+		nvgSave(vg);
+		nvgTranslate(vg, x, y);
+		nvgRotate(vg, t + i*0.1f);
+		img = nvgImagePattern(vg, -s*0.5f, -s*0.5f, s, s, 0, data->images[i], 1.0f);
+		nvgBeginPath(vg);
+		nvgRoundedRect(vg, -s*0.45f, -s*0.45f, s*0.9f, s*0.9f, 4);
+		nvgFillPaint(vg, img);
+		nvgFill(vg);
+		nvgRestore(vg);
+	}
+}
+
+static int loadBenchData(NVGcontext* vg, BenchData* data)
+{
+	unsigned char* pixels;
+	int i, x, y;
+
+	if (loadDemoData(vg, &data->demo) == -1)
+		return -1;
+
+	for (i = 0; i < BENCH_GLYPHS_PER_LINE; i++)
+		data->text[i] = (char)(33 + (i*7) % 94);
+	data->text[BENCH_GLYPHS_PER_LINE] = '\0';
+
+	// Printable ASCII and Latin-1 Supplement to Latin Extended-A, UTF-8 encoded.
+	x = 0;
+	for (i = 0x21; i <= 0x17f; i++) {
+		if (i == 0x7f) i = 0xa1;
+		if (i < 0x80) {
+			data->latinText[x++] = (char)i;
+		} else {
+			data->latinText[x++] = (char)(0xc0 | (i >> 6));
+			data->latinText[x++] = (char)(0x80 | (i & 0x3f));
+		}
+	}
+	data->latinText[x] = '\0';
+
+	pixels = (unsigned char*)malloc(BENCH_IMAGE_SIZE*BENCH_IMAGE_SIZE*4);
+	if (pixels == NULL)
+		return -1;
+	for (i = 0; i < BENCH_IMAGES; i++) {
+		for (y = 0; y < BENCH_IMAGE_SIZE; y++) {
+			for (x = 0; x < BENCH_IMAGE_SIZE; x++) {
+				unsigned char* p = &pixels[(x + y*BENCH_IMAGE_SIZE)*4];
+				int check = ((x >> 3) ^ (y >> 3) ^ i) & 1;
+				p[0] = (unsigned char)(check ? i : 255-i);
+				p[1] = (unsigned char)(x*4);
+				p[2] = (unsigned char)(y*4);
+				p[3] = 255;
+			}
+		}
+		data->images[i] = nvgCreateImageRGBA(vg, BENCH_IMAGE_SIZE, BENCH_IMAGE_SIZE, 0, pixels);
+		if (data->images[i] == 0) {
+			printf("Could not create image %d.\n", i);
+			free(pixels);
+			return -1;
+		}
+	}
+	free(pixels);
+
+	return 0;
+}
+
+static void freeBenchData(NVGcontext* vg, BenchData* data)
+{
+	int i;
+	for (i = 0; i < BENCH_IMAGES; i++)
+		nvgDeleteImage(vg, data->images[i]);
+	freeDemoData(vg, &data->demo);
+}
+
+static const BenchScene scenes[] = {
+	{ "demo", renderDemoScene },
+	{ "strokes", renderStrokes },
+	{ "glyphs", renderGlyphs },
+	{ "glyphsizes", renderGlyphSizes },
+	{ "glyphblur", renderGlyphBlur },
+	{ "textchurn", renderTextChurn },
+	{ "concave", renderConcave },
+	{ "scissor", renderScissor },
+	{ "gradients", renderGradients },
+	{ "images", renderImages },
+};
+
+static void runScene(NVGcontext* vg, BenchData* data, BenchCounters* counters, const BenchScene* scene,
+					 int warmup, int frames, int first)
+{
+	NVGframeStats stats, sum;
+	double frameTime = 0.0;
+	int allocs = 0, i;
+
+	memset(&sum, 0, sizeof(sum));
+
+	for (i = 0; i < warmup + frames; i++) {
+		float t = i / 60.0f;
+		int allocsBefore = counters->allocs;
+		double start = getTime();
+
+		nvgBeginFrame(vg, BENCH_WIDTH, BENCH_HEIGHT, 1.0f);
+		scene->render(vg, data, t);
+		nvgEndFrame(vg);
+
+		if (i < warmup)
+			continue;
+
+		frameTime += getTime() - start;
+		allocs += counters->allocs - allocsBefore;
+		nvgGetFrameStats(vg, &stats);
+		sum.drawCalls += stats.drawCalls;
+		sum.fillTriangles += stats.fillTriangles;
+		sum.strokeTriangles += stats.strokeTriangles;
+		sum.textTriangles += stats.textTriangles;
+		sum.points += stats.points;
+		sum.bezierSubdivisions += stats.bezierSubdivisions;
+		sum.vertexBytes += stats.vertexBytes;
+		sum.glyphCacheHits += stats.glyphCacheHits;
+		sum.glyphCacheMisses += stats.glyphCacheMisses;
+		sum.glyphCacheEvictions += stats.glyphCacheEvictions;
+		sum.textCacheHits += stats.textCacheHits;
+		sum.textCacheMisses += stats.textCacheMisses;
+		sum.atlasUploads += stats.atlasUploads;
+		sum.atlasUploadBytes += stats.atlasUploadBytes;
+		sum.flattenTime += stats.flattenTime;
+		sum.expandTime += stats.expandTime;
+		sum.textLayoutTime += stats.textLayoutTime;
+		sum.glyphRasterizeTime += stats.glyphRasterizeTime;
+		sum.flushTime += stats.flushTime;
+	}
+
+	// Averages per frame, times in nanoseconds.
+	printf("%s\t\t{\n", first ? "" : ",\n");
+	printf("\t\t\t\"name\": \"%s\",\n", scene->name);
+	printf("\t\t\t\"frameTime\": %.0f,\n", frameTime * 1e9 / frames);
+	printf("\t\t\t\"flattenTime\": %.0f,\n", (double)sum.flattenTime / frames);
+	printf("\t\t\t\"expandTime\": %.0f,\n", (double)sum.expandTime / frames);
+	printf("\t\t\t\"textLayoutTime\": %.0f,\n", (double)sum.textLayoutTime / frames);
+	printf("\t\t\t\"glyphRasterizeTime\": %.0f,\n", (double)sum.glyphRasterizeTime / frames);
+	printf("\t\t\t\"flushTime\": %.0f,\n", (double)sum.flushTime / frames);
+	printf("\t\t\t\"allocations\": %.1f,\n", (double)allocs / frames);
+	printf("\t\t\t\"vertices\": %.0f,\n", (double)sum.vertexBytes / sizeof(NVGvertex) / frames);
+	printf("\t\t\t\"drawCalls\": %.0f,\n", (double)sum.drawCalls / frames);
+	printf("\t\t\t\"triangles\": %.0f,\n", (double)(sum.fillTriangles + sum.strokeTriangles + sum.textTriangles) / frames);
+	printf("\t\t\t\"points\": %.0f,\n", (double)sum.points / frames);
+	printf("\t\t\t\"bezierSubdivisions\": %.0f,\n", (double)sum.bezierSubdivisions / frames);
+	printf("\t\t\t\"glyphCacheHits\": %.0f,\n", (double)sum.glyphCacheHits / frames);
+	printf("\t\t\t\"glyphCacheMisses\": %.1f,\n", (double)sum.glyphCacheMisses / frames);
+	printf("\t\t\t\"glyphCacheEvictions\": %.1f,\n", (double)sum.glyphCacheEvictions / frames);
+	printf("\t\t\t\"textCacheHits\": %.0f,\n", (double)sum.textCacheHits / frames);
+	printf("\t\t\t\"textCacheMisses\": %.1f,\n", (double)sum.textCacheMisses / frames);
+	printf("\t\t\t\"atlasUploads\": %.1f,\n", (double)sum.atlasUploads / frames);
+	printf("\t\t\t\"atlasUploadBytes\": %.0f\n", (double)sum.atlasUploadBytes / frames);
+	printf("\t\t}");
+}
+
+// Renders every scene with the SIMD kernels and with the scalar code, and compares the
+// vertices byte for byte. Returns the number of scenes which differ.
+static int verifySimd(int frames, const char* sceneName)
+{
+	NVGcontext* vg[2];
+	BenchData data[2];
+	int i, j, k, failed = 0;
+
+	for (k = 0; k < 2; k++) {
+		vg[k] = nvgCreateSW(NVG_ANTIALIAS | NVG_STENCIL_STROKES);
+		if (vg[k] == NULL || !nvgswSetFramebuffer(vg[k], NULL, BENCH_WIDTH, BENCH_HEIGHT, BENCH_WIDTH*4)) {
+			printf("Could not init nanovg.\n");
+			return -1;
+		}
+		if (loadBenchData(vg[k], &data[k]) == -1)
+			return -1;
+		hookCapture(vg[k], &captures[k]);
+	}
+	nvgDebugDisableSimd(vg[1], 1);
+
+	for (i = 0; i < (int)(sizeof(scenes) / sizeof(scenes[0])); i++) {
+		int bytes = 0, differ = -1;
+		if (sceneName != NULL && strcmp(sceneName, scenes[i].name) != 0)
+			continue;
+		for (j = 0; j < frames && differ == -1; j++) {
+			for (k = 0; k < 2; k++) {
+				captures[k].size = 0;
+				nvgBeginFrame(vg[k], BENCH_WIDTH, BENCH_HEIGHT, 1.0f);
+				scenes[i].render(vg[k], &data[k], j / 60.0f);
+				nvgEndFrame(vg[k]);
+			}
+			if (captures[0].size != captures[1].size || memcmp(captures[0].data, captures[1].data, captures[0].size) != 0)
+				differ = j;
+			bytes += captures[0].size;
+		}
+		if (differ != -1) {
+			printf("%s: vertices differ in frame %d\n", scenes[i].name, differ);
+			failed++;
+		} else {
+			printf("%s: %d frames, %d bytes identical\n", scenes[i].name, frames, bytes);
+		}
+	}
+
+	for (k = 0; k < 2; k++) {
+		freeBenchData(vg[k], &data[k]);
+		nvgDeleteSW(vg[k]);
+		free(captures[k].data);
+	}
+
+	return failed;
+}
+
+// Renders every scene with and without the text layout cache, and compares the pixels.
+// Returns the number of scenes which differ.
+static int verifyTextCache(int frames, const char* sceneName)
+{
+	NVGcontext* vg[2];
+	BenchData data[2];
+	unsigned char* pixels[2];
+	int size = BENCH_WIDTH*BENCH_HEIGHT*4;
+	int i, j, k, failed = 0;
+
+	for (k = 0; k < 2; k++) {
+		pixels[k] = (unsigned char*)malloc(size);
+		vg[k] = nvgCreateSW(NVG_ANTIALIAS | NVG_STENCIL_STROKES);
+		if (pixels[k] == NULL || vg[k] == NULL || !nvgswSetFramebuffer(vg[k], pixels[k], BENCH_WIDTH, BENCH_HEIGHT, BENCH_WIDTH*4)) {
+			printf("Could not init nanovg.\n");
+			return -1;
+		}
+		if (loadBenchData(vg[k], &data[k]) == -1)
+			return -1;
+	}
+	nvgTextLayoutCache(vg[1], 1024, 60);
+
+	for (i = 0; i < (int)(sizeof(scenes) / sizeof(scenes[0])); i++) {
+		int differ = -1, evictions = 0;
+		NVGframeStats stats;
+		if (sceneName != NULL && strcmp(sceneName, scenes[i].name) != 0)
+			continue;
+		for (j = 0; j < frames && differ == -1; j++) {
+			for (k = 0; k < 2; k++) {
+				memset(pixels[k], 0, size);
+				nvgBeginFrame(vg[k], BENCH_WIDTH, BENCH_HEIGHT, 1.0f);
+				scenes[i].render(vg[k], &data[k], j / 60.0f);
+				nvgEndFrame(vg[k]);
+			}
+			nvgGetFrameStats(vg[1], &stats);
+			evictions += stats.glyphCacheEvictions;
+			if (memcmp(pixels[0], pixels[1], size) != 0)
+				differ = j;
+		}
+		if (differ != -1) {
+			printf("%s: pixels differ in frame %d\n", scenes[i].name, differ);
+			failed++;
+		} else {
+			printf("%s: %d frames identical, %d glyphs evicted\n", scenes[i].name, frames, evictions);
+		}
+	}
+
+	for (k = 0; k < 2; k++) {
+		freeBenchData(vg[k], &data[k]);
+		nvgDeleteSW(vg[k]);
+		free(pixels[k]);
+	}
+
+	return failed;
+}
+
+// Renders every scene with and without the triangulation of concave fills, and compares the
+// pixels. Returns the number of scenes which differ.
+static int verifyTriangulation(int frames, const char* sceneName)
+{
+	NVGcontext* vg[2];
+	BenchData data[2];
+	unsigned char* pixels[2];
+	int size = BENCH_WIDTH*BENCH_HEIGHT*4;
+	int i, j, k, failed = 0;
+
+	for (k = 0; k < 2; k++) {
+		pixels[k] = (unsigned char*)malloc(size);
+		vg[k] = nvgCreateSW(NVG_ANTIALIAS | NVG_STENCIL_STROKES);
+		if (pixels[k] == NULL || vg[k] == NULL || !nvgswSetFramebuffer(vg[k], pixels[k], BENCH_WIDTH, BENCH_HEIGHT, BENCH_WIDTH*4)) {
+			printf("Could not init nanovg.\n");
+			return -1;
+		}
+		if (loadBenchData(vg[k], &data[k]) == -1)
+			return -1;
+	}
+	nvgFillTriangulation(vg[1], 256);
+
+	for (i = 0; i < (int)(sizeof(scenes) / sizeof(scenes[0])); i++) {
+		int differ = -1;
+		if (sceneName != NULL && strcmp(sceneName, scenes[i].name) != 0)
+			continue;
+		for (j = 0; j < frames && differ == -1; j++) {
+			for (k = 0; k < 2; k++) {
+				memset(pixels[k], 0, size);
+				nvgBeginFrame(vg[k], BENCH_WIDTH, BENCH_HEIGHT, 1.0f);
+				scenes[i].render(vg[k], &data[k], j / 60.0f);
+				nvgEndFrame(vg[k]);
+			}
+			if (memcmp(pixels[0], pixels[1], size) != 0)
+				differ = j;
+		}
+		if (differ != -1) {
+			printf("%s: pixels differ in frame %d\n", scenes[i].name, differ);
+			failed++;
+		} else {
+			printf("%s: %d frames identical\n", scenes[i].name, frames);
+		}
+	}
+
+	for (k = 0; k < 2; k++) {
+		freeBenchData(vg[k], &data[k]);
+		nvgDeleteSW(vg[k]);
+		free(pixels[k]);
+	}
+
+	return failed;
+}
+
+// Renders every scene with a counting allocator, and checks that the frames after the warmup
+// make no heap calls. Frames which rasterize missing glyphs are skipped, the glyph rasterizer
+// allocates its scratch memory. Returns the number of scenes which make heap calls.
+static int verifyAllocations(int warmup, int frames, const char* sceneName)
+{
+	NVGcontext* vg;
+	NVGallocator allocator;
+	BenchCounters counters;
+	BenchData data;
+	NVGframeStats stats;
+	unsigned char* pixels = (unsigned char*)malloc(BENCH_WIDTH*BENCH_HEIGHT*4);
+	int i, j, failed = 0;
+
+	memset(&counters, 0, sizeof(counters));
+	memset(&allocator, 0, sizeof(allocator));
+	allocator.userPtr = &counters;
+	allocator.alloc = benchAlloc;
+	allocator.resize = benchResize;
+	allocator.release = benchRelease;
+
+	vg = nvgCreateSWWithAllocator(NVG_ANTIALIAS | NVG_STENCIL_STROKES, &allocator);
+	if (pixels == NULL || vg == NULL || !nvgswSetFramebuffer(vg, pixels, BENCH_WIDTH, BENCH_HEIGHT, BENCH_WIDTH*4)) {
+		printf("Could not init nanovg.\n");
+		return -1;
+	}
+	if (loadBenchData(vg, &data) == -1)
+		return -1;
+
+	for (i = 0; i < (int)(sizeof(scenes) / sizeof(scenes[0])); i++) {
+		int calls = 0, skipped = 0;
+		if (sceneName != NULL && strcmp(sceneName, scenes[i].name) != 0)
+			continue;
+		for (j = 0; j < warmup + frames; j++) {
+			int before = counters.allocs + counters.frees;
+			nvgBeginFrame(vg, BENCH_WIDTH, BENCH_HEIGHT, 1.0f);
+			scenes[i].render(vg, &data, j / 60.0f);
+			nvgEndFrame(vg);
+			if (j < warmup)
+				continue;
+			nvgGetFrameStats(vg, &stats);
+			if (stats.glyphCacheMisses > 0)
+				skipped++;
+			else
+				calls += counters.allocs + counters.frees - before;
+		}
+		if (calls > 0) {
+			printf("%s: %d heap calls in %d frames\n", scenes[i].name, calls, frames - skipped);
+			failed++;
+		} else {
+			printf("%s: no heap calls in %d frames, %d frames with glyph misses skipped\n", scenes[i].name, frames - skipped, skipped);
+		}
+	}
+
+	freeBenchData(vg, &data);
+	nvgDeleteSW(vg);
+	free(pixels);
+
+	return failed;
+}
+
+// Blurs random images with the SIMD kernels and with the scalar code, and compares the pixels.
+// The sizes cover the tails of the 16 column and 8 row blocks, the strides are padded and unaligned.
+// Returns the number of images which differ.
+static int verifyBlur(void)
+{
+	static const int pads[] = { 0, 1, 7, 16, 33 };
+	FONSparams params;
+	FONScontext* fs[2];
+	unsigned char* images[3];
+	int size = (BENCH_BLUR_MAX_SIZE+33) * BENCH_BLUR_MAX_SIZE + 1;
+	int blur, w, h, i, j, k, n = 0, failed = 0;
+
+	memset(&params, 0, sizeof(params));
+	params.width = 64;
+	params.height = 64;
+	for (k = 0; k < 2; k++) {
+		fs[k] = fonsCreateInternal(&params);
+		if (fs[k] == NULL)
+			return -1;
+	}
+	fonsDebugDisableSimd(fs[1], 1);
+	for (k = 0; k < 3; k++) {
+		images[k] = (unsigned char*)malloc(size);
+		if (images[k] == NULL)
+			return -1;
+	}
+
+	for (blur = 1; blur <= BENCH_BLUR_RADII; blur++) {
+		for (h = 1; h <= BENCH_BLUR_MAX_SIZE; h++) {
+			for (w = 1; w <= BENCH_BLUR_MAX_SIZE; w++) {
+				for (i = 0; i < (int)(sizeof(pads) / sizeof(pads[0])); i++) {
+					int stride = w + pads[i], outside = 0;
+					// Some empty pixels like around the glyphs.
+					for (j = 0; j < size; j++)
+						images[0][j] = (unsigned char)(frand() < 0.3f ? 0 : frand() * 255.0f);
+					memcpy(images[1], images[0], size);
+					memcpy(images[2], images[0], size);
+					// The image starts at an odd offset so that the rows are not aligned.
+					fonsDebugBlur(fs[0], images[0] + 1, w, h, stride, blur);
+					fonsDebugBlur(fs[1], images[1] + 1, w, h, stride, blur);
+					for (j = 0; j < size; j++) {
+						int o = j - 1;
+						if (o < 0 || o / stride >= h || o % stride >= w)
+							outside |= images[0][j] != images[2][j];
+					}
+					if (outside || memcmp(images[0], images[1], size) != 0) {
+						if (failed < 10)
+							printf("blur: radius %d, %dx%d, stride %d %s\n", blur, w, h, stride, outside ? "writes outside" : "differ");
+						failed++;
+					}
+					n++;
+				}
+			}
+		}
+	}
+	if (failed == 0)
+		printf("blur: %d images identical\n", n);
+
+	for (k = 0; k < 2; k++)
+		fonsDeleteInternal(fs[k]);
+	for (k = 0; k < 3; k++)
+		free(images[k]);
+
+	return failed;
+}
+
+int main(int argc, char** argv)
+{
+	NVGcontext* vg = NULL;
+	NVGallocator allocator;
+	BenchCounters counters;
+	BenchData data;
+	unsigned char* pixels = NULL;
+	const char* sceneName = NULL;
+	int frames = 30, warmup = 3, nullBackend = 0, flattening = NVG_FLATTEN_RECURSIVE, textCache = 0, simdCheck = 0, textCacheCheck = 0;
+	int triangulationCheck = 0, allocationCheck = 0;
+	int i, first = 1;
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-frames") == 0 && i+1 < argc)
+			frames = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-warmup") == 0 && i+1 < argc)
+			warmup = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-scene") == 0 && i+1 < argc)
+			sceneName = argv[++i];
+		else if (strcmp(argv[i], "-null") == 0)
+			nullBackend = 1;
+		else if (strcmp(argv[i], "-analytic") == 0)
+			flattening = NVG_FLATTEN_ANALYTIC;
+		else if (strcmp(argv[i], "-textcache") == 0)
+			textCache = 1;
+		else if (strcmp(argv[i], "-verify-simd") == 0)
+			simdCheck = 1;
+		else if (strcmp(argv[i], "-verify-textcache") == 0)
+			textCacheCheck = 1;
+		else if (strcmp(argv[i], "-verify-triangulation") == 0)
+			triangulationCheck = 1;
+		else if (strcmp(argv[i], "-verify-allocations") == 0)
+			allocationCheck = 1;
+		else {
+			printf("Usage: %s [-frames n] [-warmup n] [-scene name] [-null] [-analytic] [-textcache] [-verify-simd] [-verify-textcache] [-verify-triangulation] [-verify-allocations]\n", argv[0]);
+			return -1;
+		}
+	}
+	if (frames < 1) frames = 1;
+
+	if (simdCheck) {
+		int failed = verifySimd(frames, sceneName) != 0;
+		if (sceneName == NULL || strcmp(sceneName, "blur") == 0)
+			failed |= verifyBlur() != 0;
+		return failed;
+	}
+	if (textCacheCheck)
+		return verifyTextCache(frames, sceneName) == 0 ? 0 : 1;
+	if (triangulationCheck)
+		return verifyTriangulation(frames, sceneName) == 0 ? 0 : 1;
+	if (allocationCheck)
+		return verifyAllocations(warmup, frames, sceneName) == 0 ? 0 : 1;
+
+	memset(&counters, 0, sizeof(counters));
+	memset(&allocator, 0, sizeof(allocator));
+	allocator.userPtr = &counters;
+	allocator.alloc = benchAlloc;
+	allocator.resize = benchResize;
+	allocator.release = benchRelease;
+
+	vg = nvgCreateSWWithAllocator(NVG_ANTIALIAS | NVG_STENCIL_STROKES, &allocator);
+	if (vg == NULL) {
+		printf("Could not init nanovg.\n");
+		return -1;
+	}
+	nvgCurveFlattening(vg, flattening);
+	if (textCache)
+		nvgTextLayoutCache(vg, 1024, 60);
+
+	if (!nullBackend) {
+		pixels = (unsigned char*)malloc(BENCH_WIDTH*BENCH_HEIGHT*4);
+		if (pixels == NULL)
+			return -1;
+	}
+	if (!nvgswSetFramebuffer(vg, pixels, BENCH_WIDTH, BENCH_HEIGHT, BENCH_WIDTH*4))
+		return -1;
+
+	if (loadBenchData(vg, &data) == -1)
+		return -1;
+
+	printf("{\n");
+	printf("\t\"backend\": \"%s\",\n", nullBackend ? "null" : "sw");
+	printf("\t\"flattening\": \"%s\",\n", flattening == NVG_FLATTEN_ANALYTIC ? "analytic" : "recursive");
+	printf("\t\"textCache\": %s,\n", textCache ? "true" : "false");
+	printf("\t\"width\": %d,\n", BENCH_WIDTH);
+	printf("\t\"height\": %d,\n", BENCH_HEIGHT);
+	printf("\t\"frames\": %d,\n", frames);
+	printf("\t\"scenes\": [\n");
+	for (i = 0; i < (int)(sizeof(scenes) / sizeof(scenes[0])); i++) {
+		if (sceneName != NULL && strcmp(sceneName, scenes[i].name) != 0)
+			continue;
+		runScene(vg, &data, &counters, &scenes[i], warmup, frames, first);
+		first = 0;
+	}
+	printf("\n\t]\n");
+	printf("}\n");
+
+	freeBenchData(vg, &data);
+	nvgDeleteSW(vg);
+	free(pixels);
+
+	return 0;
+}
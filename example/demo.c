@@ -2,10 +2,12 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#ifndef DEMO_HEADLESS
 #ifdef NANOVG_GLEW
 #  include <GL/glew.h>
 #endif
 #include <GLFW/glfw3.h>
+#endif
 #include "nanovg.h"
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
@@ -1125,6 +1127,7 @@ void renderDemo(NVGcontext* vg, float mx, float my, float width, float height,
 	nvgRestore(vg);
 }
 
+#ifndef DEMO_HEADLESS
 static int mini(int a, int b) { return a < b ? a : b; }
 
 static void unpremultiplyAlpha(unsigned char* image, int w, int h, int stride)
@@ -1226,3 +1229,4 @@ void saveScreenShot(int w, int h, int premult, const char* name)
  	stbi_write_png(name, w, h, 4, image, w*4);
  	free(image);
 }
+#endif
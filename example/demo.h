@@ -17,7 +17,9 @@ int loadDemoData(NVGcontext* vg, DemoData* data);
 void freeDemoData(NVGcontext* vg, DemoData* data);
 void renderDemo(NVGcontext* vg, float mx, float my, float width, float height, float t, int blowup, DemoData* data);
 
+#ifndef DEMO_HEADLESS
 void saveScreenShot(int w, int h, int premult, const char* name);
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,231 @@
+//
+// Copyright (c) 2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+// Headless GL3 check, renders to an offscreen framebuffer of a surfaceless EGL context
+// (e.g. Mesa llvmpipe) and checks that merged calls draw the same pixels as unmerged calls.
+// The uniform texture of merged calls is limited to one row, so that the calls are drawn
+// in several batches, and the number of draws of each batch is checked.
+//
+// Usage: glcheck [-frames n]
+// Exits with 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include "nanovg.h"
+
+// Count the draws of the back-end.
+static int drawCount = 0;
+#define glDrawArrays(mode, first, count) (drawCount++, glDrawArrays(mode, first, count))
+
+#define NANOVG_GL3_IMPLEMENTATION
+#define NANOVG_GL_MAX_FRAG_ROWS 1
+#include "nanovg_gl.h"
+#include "demo.h"
+
+#define CHECK_WIDTH 1000
+#define CHECK_HEIGHT 600
+#define CHECK_RECTS 1000
+#define CHECK_FRAGS_PER_BATCH 64
+
+enum CheckScene {
+	SCENE_DEMO,
+	SCENE_RECTS,
+	SCENE_MIXED,
+	SCENE_COUNT
+};
+
+static const char* sceneNames[SCENE_COUNT] = { "demo", "rects", "mixed" };
+
+static NVGcolor uniqueColor(int i)
+{
+	return nvgRGBA((unsigned char)(40 + i % 200), (unsigned char)(40 + (i / 200) * 30), 200, 255);
+}
+
+// Every rect has its own color, so that no uniforms are shared.
+static void drawRects(NVGcontext* vg)
+{
+	int i;
+	for (i = 0; i < CHECK_RECTS; i++) {
+		nvgBeginPath(vg);
+		nvgRect(vg, (i % 50) * 20.0f + 2, (i / 50) * 20.0f + 2, 16, 16);
+		nvgFillColor(vg, uniqueColor(i));
+		nvgFill(vg);
+	}
+}
+
+// Concave fills and stencil strokes use two uniform sets, text uses one.
+static void drawMixed(NVGcontext* vg, int font)
+{
+	char label[16];
+	int i;
+	nvgFontFaceId(vg, font);
+	nvgFontSize(vg, 12.0f);
+	for (i = 0; i < CHECK_RECTS/2; i++) {
+		float x = (i % 25) * 40.0f + 2, y = (i / 25) * 30.0f + 2;
+		nvgBeginPath(vg);
+		if (i % 3 == 0) {
+			nvgMoveTo(vg, x, y);
+			nvgLineTo(vg, x + 16, y + 8);
+			nvgLineTo(vg, x + 32, y);
+			nvgLineTo(vg, x + 16, y + 24);
+			nvgClosePath(vg);
+			nvgFillColor(vg, uniqueColor(i));
+			nvgFill(vg);
+		} else if (i % 3 == 1) {
+			nvgRect(vg, x + 2, y + 2, 28, 20);
+			nvgStrokeColor(vg, uniqueColor(i));
+			nvgStrokeWidth(vg, 3.0f);
+			nvgStroke(vg);
+		} else {
+			nvgRect(vg, x, y, 32, 24);
+			nvgFillColor(vg, uniqueColor(i));
+			nvgFill(vg);
+			snprintf(label, sizeof(label), "%d", i);
+			nvgFillColor(vg, nvgRGBA(255, 255, 255, (unsigned char)(128 + i % 128)));
+			nvgText(vg, x + 4, y + 16, label, NULL);
+		}
+	}
+}
+
+static int render(int flags, int scene, int frames, unsigned char* pixels, int* draws)
+{
+	NVGcontext* vg = nvgCreateGL3(flags);
+	DemoData data;
+	int i;
+
+	if (vg == NULL) {
+		printf("Could not init nanovg.\n");
+		return -1;
+	}
+	if (loadDemoData(vg, &data) == -1) {
+		nvgDeleteGL3(vg);
+		return -1;
+	}
+
+	for (i = 0; i < frames; i++) {
+		glClearColor(0.3f, 0.3f, 0.32f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+		drawCount = 0;
+		nvgBeginFrame(vg, CHECK_WIDTH, CHECK_HEIGHT, 1.0f);
+		if (scene == SCENE_DEMO)
+			renderDemo(vg, 500, 300, CHECK_WIDTH, CHECK_HEIGHT, 1.5f + i*0.37f, 0, &data);
+		else if (scene == SCENE_RECTS)
+			drawRects(vg);
+		else
+			drawMixed(vg, data.fontNormal);
+		nvgEndFrame(vg);
+	}
+	*draws = drawCount;
+	glReadPixels(0, 0, CHECK_WIDTH, CHECK_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+	freeDemoData(vg, &data);
+	nvgDeleteGL3(vg);
+	return glGetError() == GL_NO_ERROR ? 0 : -1;
+}
+
+static int createContext(void)
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay;
+	EGLint configAttribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLint contextAttribs[] = { EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+	EGLDisplay display;
+	EGLConfig config;
+	EGLContext context;
+	EGLint major, minor, nconfigs = 0;
+	GLuint fbo, rb[2];
+
+	getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay == NULL) return -1;
+	display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) return -1;
+	eglBindAPI(EGL_OPENGL_API);
+	eglChooseConfig(display, configAttribs, &config, 1, &nconfigs);
+	context = eglCreateContext(display, nconfigs > 0 ? config : NULL, EGL_NO_CONTEXT, contextAttribs);
+	if (context == EGL_NO_CONTEXT) return -1;
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) return -1;
+
+	// Offscreen framebuffer with a stencil buffer.
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glGenRenderbuffers(2, rb);
+	glBindRenderbuffer(GL_RENDERBUFFER, rb[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, CHECK_WIDTH, CHECK_HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rb[0]);
+	glBindRenderbuffer(GL_RENDERBUFFER, rb[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, CHECK_WIDTH, CHECK_HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rb[1]);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) return -1;
+	glViewport(0, 0, CHECK_WIDTH, CHECK_HEIGHT);
+
+	printf("%s, %s\n", glGetString(GL_RENDERER), glGetString(GL_VERSION));
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	int flags = NVG_ANTIALIAS | NVG_STENCIL_STROKES;
+	int frames = 3, failed = 0;
+	int i, scene, draws, mergedDraws, ndiff;
+	unsigned char* pixels = (unsigned char*)malloc(CHECK_WIDTH*CHECK_HEIGHT*4);
+	unsigned char* merged = (unsigned char*)malloc(CHECK_WIDTH*CHECK_HEIGHT*4);
+
+	for (i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-frames") == 0 && i+1 < argc)
+			frames = atoi(argv[++i]);
+	}
+	if (frames < 1) frames = 1;
+	if (pixels == NULL || merged == NULL) return 1;
+
+	if (createContext() == -1) {
+		printf("Could not create a surfaceless EGL context.\n");
+		return 1;
+	}
+
+	for (scene = 0; scene < SCENE_COUNT; scene++) {
+		if (render(flags, scene, frames, pixels, &draws) == -1 ||
+			render(flags | NVG_MERGE_CALLS, scene, frames, merged, &mergedDraws) == -1) {
+			printf("%s: render failed\n", sceneNames[scene]);
+			return 1;
+		}
+
+		ndiff = 0;
+		for (i = 0; i < CHECK_WIDTH*CHECK_HEIGHT*4; i++)
+			if (pixels[i] != merged[i]) ndiff++;
+		printf("%s: draws %d, merged %d, differing bytes %d\n", sceneNames[scene], draws, mergedDraws, ndiff);
+		if (ndiff > 0)
+			failed = 1;
+
+		// Each batch of rects is one draw.
+		if (scene == SCENE_RECTS && mergedDraws != (CHECK_RECTS + CHECK_FRAGS_PER_BATCH-1) / CHECK_FRAGS_PER_BATCH) {
+			printf("%s: expected %d merged draws\n", sceneNames[scene], (CHECK_RECTS + CHECK_FRAGS_PER_BATCH-1) / CHECK_FRAGS_PER_BATCH);
+			failed = 1;
+		}
+	}
+
+	free(pixels);
+	free(merged);
+	printf("%s\n", failed ? "FAILED" : "OK");
+	return failed ? 1 : 0;
+}
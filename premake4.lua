@@ -224,3 +224,46 @@ solution "nanovg"
 		configuration "Release"
 			defines { "NDEBUG" }
 			flags { "Optimize", "ExtraWarnings"}
+
+	project "bench"
+		kind "ConsoleApp"
+		language "C"
+		defines { "DEMO_HEADLESS" }
+		files { "example/bench.c", "example/demo.c" }
+		includedirs { "src", "example" }
+		targetdir("build")
+		links { "nanovg" }
+
+		configuration { "linux" }
+			 links { "m" }
+
+		configuration { "windows" }
+			 defines { "_CRT_SECURE_NO_WARNINGS" }
+
+		configuration "Debug"
+			defines { "DEBUG" }
+			flags { "Symbols", "ExtraWarnings"}
+
+		configuration "Release"
+			defines { "NDEBUG" }
+			flags { "Optimize", "ExtraWarnings"}
+
+	-- Needs a surfaceless EGL context, e.g. Mesa llvmpipe.
+	if os.get() == "linux" then
+	project "glcheck"
+		kind "ConsoleApp"
+		language "C"
+		defines { "DEMO_HEADLESS" }
+		files { "example/glcheck.c", "example/demo.c" }
+		includedirs { "src", "example" }
+		targetdir("build")
+		links { "nanovg", "GL", "EGL", "m" }
+
+		configuration "Debug"
+			defines { "DEBUG" }
+			flags { "Symbols", "ExtraWarnings"}
+
+		configuration "Release"
+			defines { "NDEBUG" }
+			flags { "Optimize", "ExtraWarnings"}
+	end
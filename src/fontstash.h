@@ -24,6 +24,9 @@
 enum FONSflags {
 	FONS_ZERO_TOPLEFT = 1,
 	FONS_ZERO_BOTTOMLEFT = 2,
+	// Glyphs are stored as signed distance fields, the edge is at 128. One cached glyph
+	// serves a range of sizes and the quads are scaled to the requested size.
+	FONS_SDF = 4,
 };
 
 enum FONSalign {
@@ -54,6 +57,13 @@ enum FONSerrorCode {
 	FONS_STATES_UNDERFLOW = 4,
 };
 
+enum FONSmemoryType {
+	// Fonts, font data, glyphs and the glyph scratch memory.
+	FONS_MEMORY_GLYPHS = 0,
+	// Atlas nodes and texture data.
+	FONS_MEMORY_ATLAS = 1,
+};
+
 struct FONSparams {
 	int width, height;
 	unsigned char flags;
@@ -63,13 +73,29 @@ struct FONSparams {
 	void (*renderUpdate)(void* uptr, int* rect, const unsigned char* data);
 	void (*renderDraw)(void* uptr, const float* verts, const float* tcoords, const unsigned int* colors, int nverts);
 	void (*renderDelete)(void* uptr);
+	// Optional memory allocation callbacks, malloc, realloc and free are used if NULL.
+	void* memUserPtr;
+	void* (*memAlloc)(void* uptr, int type, int size);
+	void* (*memRealloc)(void* uptr, int type, void* ptr, int size);
+	void (*memFree)(void* uptr, void* ptr);
+	// Optional clock in nanoseconds used to time glyph rasterization, called with userPtr.
+	long long (*timeNs)(void* uptr);
 };
 typedef struct FONSparams FONSparams;
 
+struct FONSstats {
+	int glyphHits;			// Glyph lookups found in the cache.
+	int glyphMisses;		// Glyphs created or rasterized.
+	int glyphEvictions;		// Glyphs evicted from a full atlas.
+	long long rasterizeTime;	// Nanoseconds, 0 if FONSparams has no clock.
+};
+typedef struct FONSstats FONSstats;
+
 struct FONSquad
 {
 	float x0,y0,s0,t0;
 	float x1,y1,s1,t1;
+	int page;				// Atlas page of the glyph.
 };
 typedef struct FONSquad FONSquad;
 
@@ -79,6 +105,7 @@ struct FONStextIter {
 	short isize, iblur;
 	struct FONSfont* font;
 	int prevGlyphIndex;
+	int glyph;				// Slot of the current glyph in the font, -1 if none, see fonsTouchGlyphs().
 	const char* str;
 	const char* next;
 	const char* end;
@@ -94,12 +121,30 @@ FONScontext* fonsCreateInternal(FONSparams* params);
 void fonsDeleteInternal(FONScontext* s);
 
 void fonsSetErrorCallback(FONScontext* s, void (*callback)(void* uptr, int error, int val), void* uptr);
-// Returns current atlas size.
+// Returns current atlas size, all atlas pages have the same size.
 void fonsGetAtlasSize(FONScontext* s, int* width, int* height);
 // Expands the atlas size.
 int fonsExpandAtlas(FONScontext* s, int width, int height);
-// Resets the whole stash.
+// Resets the whole stash, leaving one atlas page.
 int fonsResetAtlas(FONScontext* stash, int width, int height);
+// Adds an empty atlas page, new glyphs are placed to any page with room before evicting old ones.
+// Returns index of the page, or -1 if there are already FONS_MAX_PAGES pages.
+// The render callbacks and fonsDrawText() use only the first page.
+int fonsAddAtlasPage(FONScontext* s);
+int fonsGetAtlasPageCount(FONScontext* s);
+
+// Atlas snapshot, saves the atlas pages and the glyphs of all fonts so that they can be restored
+// without rasterizing them again, e.g. at the next start of the application. The fonts are identified
+// by a hash of their data, the glyphs of fonts which are not loaded or whose fallbacks differ are dropped.
+// Writes the snapshot to data if not NULL. Returns the size of the snapshot, or 0 if size is too small.
+int fonsSaveSnapshot(FONScontext* s, unsigned char* data, int size);
+// Checks the snapshot and returns its atlas size and page count. Returns 0 if the snapshot is
+// corrupt or was saved with different settings.
+int fonsGetSnapshotInfo(FONScontext* s, const unsigned char* data, int size, int* width, int* height, int* npages);
+// Resets the atlas to the snapshot. Returns number of glyphs restored, 0 if none of the fonts matched
+// or -1 if the snapshot is not valid, in both cases the stash is left unchanged. Returns -1 also if
+// out of memory, the atlas is empty then.
+int fonsLoadSnapshot(FONScontext* s, const unsigned char* data, int size);
 
 // Add fonts
 int fonsAddFont(FONScontext* s, const char* name, const char* path, int fontIndex);
@@ -134,9 +179,50 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, struct FONSquad* qu
 // Pull texture changes
 const unsigned char* fonsGetTextureData(FONScontext* stash, int* width, int* height);
 int fonsValidateTexture(FONScontext* s, int* dirty);
+const unsigned char* fonsGetPageTextureData(FONScontext* stash, int page, int* width, int* height);
+int fonsValidatePageTexture(FONScontext* s, int page, int* dirty);
 
 // Draws the stash texture for debugging
 void fonsDrawDebug(FONScontext* s, float x, float y);
+// Blurs the image the same way as the glyphs, blur is the radius in pixels (max 20).
+void fonsDebugBlur(FONScontext* s, unsigned char* data, int w, int h, int stride, int blur);
+// Blurs with the scalar code instead of the SIMD kernels, both produce identical pixels.
+void fonsDebugDisableSimd(FONScontext* s, int disable);
+
+// Glyph cache statistics, accumulated until reset.
+void fonsGetStats(FONScontext* s, FONSstats* stats);
+void fonsResetStats(FONScontext* s);
+
+// When the atlas is full, the least recently used glyphs are evicted to make room.
+// Glyphs used since the last call are kept, call once per frame to allow eviction.
+void fonsAdvanceFrame(FONScontext* s);
+
+// Returns a counter that changes when the glyph quads returned earlier may no longer be valid,
+// i.e. when glyphs are evicted, the fallback fonts change or the atlas is expanded or reset.
+int fonsGetAtlasGeneration(FONScontext* s);
+
+// Marks the glyphs as used this frame, so that they are not evicted. Call when drawing glyph quads
+// kept from an earlier frame, glyphs are the FONStextIter.glyph slots of the font the quads were created with.
+void fonsTouchGlyphs(FONScontext* s, int font, const int* glyphs, int nglyphs);
+
+// Task runner used to rasterize glyphs. It must call task(taskPtr, i) once for each i in
+// [0..count), possibly concurrently on different threads, and return when all the tasks have completed.
+typedef void (*FONStaskRunner)(void* uptr, void (*task)(void* taskPtr, int index), void* taskPtr, int count);
+
+// Rasterizes the glyphs missing from the atlas in parallel using specified number of workers,
+// each worker is one task passed to the runner and has its own scratch memory. The atlas space
+// is allocated on the calling thread. If runner is NULL, the tasks are run on the calling thread.
+// Passing nworkers <= 0 rasterizes each glyph when it is looked up (default).
+// Glyphs are batched per string in fonsTextIterInit() with FONS_GLYPH_BITMAP_REQUIRED.
+// The FreeType back-end always rasterizes on the calling thread.
+int fonsSetRasterizeWorkers(FONScontext* s, int nworkers, FONStaskRunner runner, void* uptr);
+// Creates and rasterizes the glyphs of the string missing from the atlas using the current
+// state. Returns number of glyphs rasterized by the workers.
+int fonsPrepareText(FONScontext* s, const char* str, const char* end);
+// Creates and rasterizes the glyphs of the code points in [first..last] using the current font,
+// size and blur. Code points missing from the font and its fallbacks are skipped. Returns number
+// of code points done, less than last-first+1 if the atlas is full. Code points above U+10FFFF are ignored.
+int fonsPrepareGlyphs(FONScontext* s, unsigned int first, unsigned int last);
 
 #endif // FONTSTASH_H
 
@@ -145,11 +231,17 @@ void fonsDrawDebug(FONScontext* s, float x, float y);
 
 #define FONS_NOTUSED(v)  (void)sizeof(v)
 
+#if !defined(FONS_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define FONS_SSE2 1
+#include <emmintrin.h>
+#endif
+
 #ifdef FONS_USE_FREETYPE
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_ADVANCES_H
+#include FT_MODULE_H
 #include <math.h>
 
 struct FONSttFontImpl {
@@ -177,6 +269,9 @@ typedef struct FONSttFontImpl FONSttFontImpl;
 #ifndef FONS_SCRATCH_BUF_SIZE
 #	define FONS_SCRATCH_BUF_SIZE 96000
 #endif
+// Font data loaded by fonsAddFont() is released through the stash allocator.
+#define FONS__FREE_INTERNAL 2
+// Initial size of the glyph lookup of a font, must be power of two.
 #ifndef FONS_HASH_LUT_SIZE
 #	define FONS_HASH_LUT_SIZE 256
 #endif
@@ -198,6 +293,22 @@ typedef struct FONSttFontImpl FONSttFontImpl;
 #ifndef FONS_MAX_FALLBACKS
 #	define FONS_MAX_FALLBACKS 20
 #endif
+#ifndef FONS_MAX_PAGES
+#	define FONS_MAX_PAGES 4
+#endif
+// Glyph is created in the atlas and rasterized later by fons__rasterizeQueued().
+#define FONS__GLYPH_BITMAP_QUEUED 3
+// Distance field glyphs are cached at sizes from FONS_SDF_MIN_SIZE doubling up to
+// FONS_SDF_MAX_SIZE, and the field reaches 0 at FONS_SDF_PADDING texels outside the edge.
+#ifndef FONS_SDF_MIN_SIZE
+#	define FONS_SDF_MIN_SIZE 32
+#endif
+#ifndef FONS_SDF_MAX_SIZE
+#	define FONS_SDF_MAX_SIZE 128
+#endif
+#ifndef FONS_SDF_PADDING
+#	define FONS_SDF_PADDING 4
+#endif
 
 static unsigned int fons__hashint(unsigned int a)
 {
@@ -224,10 +335,11 @@ struct FONSglyph
 {
 	unsigned int codepoint;
 	int index;
-	int next;
 	short size, blur;
 	short x0,y0,x1,y1;
 	short xadv,xoff,yoff;
+	short page;
+	int lastUsed;
 };
 typedef struct FONSglyph FONSglyph;
 
@@ -237,6 +349,7 @@ struct FONSfont
 	char name[64];
 	unsigned char* data;
 	int dataSize;
+	int faceIndex;
 	unsigned char freeData;
 	float ascender;
 	float descender;
@@ -244,7 +357,8 @@ struct FONSfont
 	FONSglyph* glyphs;
 	int cglyphs;
 	int nglyphs;
-	int lut[FONS_HASH_LUT_SIZE];
+	int* lut;				// Open addressing table of glyph indices keyed by codepoint, size and blur, -1 if empty.
+	int clut;
 	int fallbacks[FONS_MAX_FALLBACKS];
 	int nfallbacks;
 };
@@ -266,35 +380,82 @@ struct FONSatlasNode {
 };
 typedef struct FONSatlasNode FONSatlasNode;
 
+struct FONSatlasRect {
+	short x, y, width, height;
+};
+typedef struct FONSatlasRect FONSatlasRect;
+
 struct FONSatlas
 {
+	const FONSparams* params;
 	int width, height;
 	FONSatlasNode* nodes;
 	int nnodes;
 	int cnodes;
+	FONSatlasRect* rects;	// Free space below the skyline.
+	int nrects;
+	int crects;
 };
 typedef struct FONSatlas FONSatlas;
 
+struct FONSpage
+{
+	FONSatlas* atlas;
+	unsigned char* texData;
+	int dirtyRect[4];
+};
+typedef struct FONSpage FONSpage;
+
+// Scratch memory used to rasterize glyphs on one thread, passed to stb_truetype as allocator context.
+struct FONSscratch
+{
+	FONScontext* stash;		// Reports FONS_SCRATCH_FULL, NULL for the workers.
+	unsigned char* data;
+	int n;
+};
+typedef struct FONSscratch FONSscratch;
+
+// Glyph waiting to be rasterized by the workers.
+struct FONSglyphJob
+{
+	FONSfont* font;
+	FONSfont* renderFont;
+	int glyph;				// Index to font glyphs, the array may move while queuing.
+	float scale;
+	short pad, blur;
+};
+typedef struct FONSglyphJob FONSglyphJob;
+
 struct FONScontext
 {
 	FONSparams params;
 	float itw,ith;
-	unsigned char* texData;
-	int dirtyRect[4];
+	FONSpage pages[FONS_MAX_PAGES];
+	int npages;
 	FONSfont** fonts;
-	FONSatlas* atlas;
 	int cfonts;
 	int nfonts;
 	float verts[FONS_VERTEX_COUNT*2];
 	float tcoords[FONS_VERTEX_COUNT*2];
 	unsigned int colors[FONS_VERTEX_COUNT];
 	int nverts;
-	unsigned char* scratch;
-	int nscratch;
+	FONSscratch scratch;
 	FONSstate states[FONS_MAX_STATES];
 	int nstates;
 	void (*handleError)(void* uptr, int error, int val);
 	void* errorUptr;
+	FONSstats stats;
+	int frame;
+	int generation;
+	FONSglyphJob* jobs;
+	int njobs;
+	int cjobs;
+	FONSscratch* workers;
+	int nworkers;
+	int ntasks;
+	FONStaskRunner runner;
+	void* runnerUptr;
+	int simd;			// Use the SIMD kernels when compiled in, see fonsDebugDisableSimd().
 #ifdef FONS_USE_FREETYPE
 	FT_Library ftLibrary;
 #endif
@@ -305,8 +466,11 @@ struct FONScontext
 int fons__tt_init(FONScontext *context)
 {
 	FT_Error ftError;
+	FT_Int spread = FONS_SDF_PADDING;
 	FONS_NOTUSED(context);
 	ftError = FT_Init_FreeType(&context->ftLibrary);
+	if (ftError == 0)
+		FT_Property_Set(context->ftLibrary, "bsdf", "spread", &spread);
 	return ftError == 0;
 }
 
@@ -387,6 +551,34 @@ void fons__tt_renderGlyphBitmap(FONSttFontImpl *font, unsigned char *output, int
 	}
 }
 
+void fons__tt_renderGlyphSDF(FONSttFontImpl *font, unsigned char *output, int outWidth, int outHeight, int outStride,
+							 float scale, int padding, int glyph)
+{
+#if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+	FT_GlyphSlot ftGlyph = font->font->glyph;
+	unsigned int x, y;
+	FONS_NOTUSED(scale);
+	FONS_NOTUSED(padding);	// spread is set in fons__tt_init
+	FONS_NOTUSED(glyph);	// glyph has already been loaded by fons__tt_buildGlyphBitmap
+
+	// The loaded bitmap is converted to a distance field spreading FONS_SDF_PADDING pixels.
+	if (FT_Render_Glyph(ftGlyph, FT_RENDER_MODE_SDF) != 0) return;
+	for (y = 0; y < ftGlyph->bitmap.rows && (int)y < outHeight; y++) {
+		for (x = 0; x < ftGlyph->bitmap.width && (int)x < outWidth; x++)
+			output[(y * outStride) + x] = ftGlyph->bitmap.buffer[y * ftGlyph->bitmap.pitch + x];
+	}
+#else
+	// No distance fields, the coverage is a distance field one pixel wide.
+	fons__tt_renderGlyphBitmap(font, output + padding * outStride + padding, outWidth - padding*2, outHeight - padding*2, outStride, scale, scale, glyph);
+#endif
+}
+
+void fons__tt_setScratch(FONSttFontImpl *font, FONSscratch *scratch)
+{
+	FONS_NOTUSED(font);
+	FONS_NOTUSED(scratch);
+}
+
 int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 {
 	FT_Vector ftKerning;
@@ -413,7 +605,7 @@ int fons__tt_loadFont(FONScontext *context, FONSttFontImpl *font, unsigned char
 	int offset, stbError;
 	FONS_NOTUSED(dataSize);
 
-	font->font.userdata = context;
+	font->font.userdata = &context->scratch;
 	offset = stbtt_GetFontOffsetForIndex(data, fontIndex);
 	if (offset == -1) {
 		stbError = 0;
@@ -453,6 +645,24 @@ void fons__tt_renderGlyphBitmap(FONSttFontImpl *font, unsigned char *output, int
 	stbtt_MakeGlyphBitmap(&font->font, output, outWidth, outHeight, outStride, scaleX, scaleY, glyph);
 }
 
+void fons__tt_renderGlyphSDF(FONSttFontImpl *font, unsigned char *output, int outWidth, int outHeight, int outStride,
+							 float scale, int padding, int glyph)
+{
+	int x, y, w = 0, h = 0, xoff, yoff;
+	unsigned char* sdf = stbtt_GetGlyphSDF(&font->font, scale, glyph, padding, 128, 128.0f / padding, &w, &h, &xoff, &yoff);
+	if (sdf == NULL) return;
+	for (y = 0; y < h && y < outHeight; y++) {
+		for (x = 0; x < w && x < outWidth; x++)
+			output[(y * outStride) + x] = sdf[y * w + x];
+	}
+	stbtt_FreeSDF(sdf, font->font.userdata);
+}
+
+void fons__tt_setScratch(FONSttFontImpl *font, FONSscratch *scratch)
+{
+	font->font.userdata = scratch;
+}
+
 int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 {
 	return stbtt_GetGlyphKernAdvance(&font->font, glyph1, glyph2);
@@ -465,18 +675,19 @@ int fons__tt_getGlyphKernAdvance(FONSttFontImpl *font, int glyph1, int glyph2)
 static void* fons__tmpalloc(size_t size, void* up)
 {
 	unsigned char* ptr;
-	FONScontext* stash = (FONScontext*)up;
+	FONSscratch* scratch = (FONSscratch*)up;
+	FONScontext* stash = scratch->stash;
 
 	// 16-byte align the returned pointer
 	size = (size + 0xf) & ~0xf;
 
-	if (stash->nscratch+(int)size > FONS_SCRATCH_BUF_SIZE) {
-		if (stash->handleError)
-			stash->handleError(stash->errorUptr, FONS_SCRATCH_FULL, stash->nscratch+(int)size);
+	if (scratch->n+(int)size > FONS_SCRATCH_BUF_SIZE) {
+		if (stash != NULL && stash->handleError)
+			stash->handleError(stash->errorUptr, FONS_SCRATCH_FULL, scratch->n+(int)size);
 		return NULL;
 	}
-	ptr = stash->scratch + stash->nscratch;
-	stash->nscratch += (int)size;
+	ptr = scratch->data + scratch->n;
+	scratch->n += (int)size;
 	return ptr;
 }
 
@@ -528,29 +739,54 @@ static unsigned int fons__decutf8(unsigned int* state, unsigned int* codep, unsi
 	return *state;
 }
 
+static void* fons__memAlloc(const FONSparams* params, int type, int size)
+{
+	if (params->memAlloc != NULL)
+		return params->memAlloc(params->memUserPtr, type, size);
+	return malloc(size);
+}
+
+static void* fons__memRealloc(const FONSparams* params, int type, void* ptr, int size)
+{
+	if (params->memRealloc != NULL)
+		return params->memRealloc(params->memUserPtr, type, ptr, size);
+	return realloc(ptr, size);
+}
+
+static void fons__memFree(const FONSparams* params, void* ptr)
+{
+	if (params->memFree != NULL)
+		params->memFree(params->memUserPtr, ptr);
+	else
+		free(ptr);
+}
+
 // Atlas based on Skyline Bin Packer by Jukka Jylänki
+// Freed rects below the skyline are kept in a list, merged when sharing an edge.
 
 static void fons__deleteAtlas(FONSatlas* atlas)
 {
 	if (atlas == NULL) return;
-	if (atlas->nodes != NULL) free(atlas->nodes);
-	free(atlas);
+	if (atlas->nodes != NULL) fons__memFree(atlas->params, atlas->nodes);
+	if (atlas->rects != NULL) fons__memFree(atlas->params, atlas->rects);
+	fons__memFree(atlas->params, atlas);
 }
 
-static FONSatlas* fons__allocAtlas(int w, int h, int nnodes)
+static FONSatlas* fons__allocAtlas(const FONSparams* params, int w, int h, int nnodes)
 {
 	FONSatlas* atlas = NULL;
 
 	// Allocate memory for the font stash.
-	atlas = (FONSatlas*)malloc(sizeof(FONSatlas));
+	atlas = (FONSatlas*)fons__memAlloc(params, FONS_MEMORY_ATLAS, sizeof(FONSatlas));
 	if (atlas == NULL) goto error;
 	memset(atlas, 0, sizeof(FONSatlas));
 
+	atlas->params = params;
 	atlas->width = w;
 	atlas->height = h;
 
 	// Allocate space for skyline nodes
-	atlas->nodes = (FONSatlasNode*)malloc(sizeof(FONSatlasNode) * nnodes);
+	atlas->nodes = (FONSatlasNode*)fons__memAlloc(params, FONS_MEMORY_ATLAS, sizeof(FONSatlasNode) * nnodes);
 	if (atlas->nodes == NULL) goto error;
 	memset(atlas->nodes, 0, sizeof(FONSatlasNode) * nnodes);
 	atlas->nnodes = 0;
@@ -575,7 +811,7 @@ static int fons__atlasInsertNode(FONSatlas* atlas, int idx, int x, int y, int w)
 	// Insert node
 	if (atlas->nnodes+1 > atlas->cnodes) {
 		atlas->cnodes = atlas->cnodes == 0 ? 8 : atlas->cnodes * 2;
-		atlas->nodes = (FONSatlasNode*)realloc(atlas->nodes, sizeof(FONSatlasNode) * atlas->cnodes);
+		atlas->nodes = (FONSatlasNode*)fons__memRealloc(atlas->params, FONS_MEMORY_ATLAS, atlas->nodes, sizeof(FONSatlasNode) * atlas->cnodes);
 		if (atlas->nodes == NULL)
 			return 0;
 	}
@@ -612,6 +848,7 @@ static void fons__atlasReset(FONSatlas* atlas, int w, int h)
 	atlas->width = w;
 	atlas->height = h;
 	atlas->nnodes = 0;
+	atlas->nrects = 0;
 
 	// Init root node.
 	atlas->nodes[0].x = 0;
@@ -678,11 +915,165 @@ static int fons__atlasRectFits(FONSatlas* atlas, int i, int w, int h)
 	return y;
 }
 
+static int fons__atlasLowerSkyline(FONSatlas* atlas, int x, int y, int w, int h)
+{
+	// Lowers the skyline to y if the rect is right under it, returns 0 if not.
+	int i, i0 = -1, i1 = -1;
+	for (i = 0; i < atlas->nnodes; i++) {
+		FONSatlasNode* n = &atlas->nodes[i];
+		if (n->x + n->width <= x) continue;
+		if (n->x >= x + w) break;
+		if (n->y != y + h) return 0;
+		if (i0 == -1) i0 = i;
+		i1 = i;
+	}
+	if (i0 == -1) return 0;
+
+	// Split the skyline segments at the rect edges.
+	if (atlas->nodes[i1].x + atlas->nodes[i1].width > x + w) {
+		FONSatlasNode* n = &atlas->nodes[i1];
+		if (fons__atlasInsertNode(atlas, i1+1, x + w, n->y, n->x + n->width - (x + w)) == 0)
+			return 0;
+		atlas->nodes[i1].width = (short)(x + w - atlas->nodes[i1].x);
+	}
+	if (atlas->nodes[i0].x < x) {
+		FONSatlasNode* n = &atlas->nodes[i0];
+		if (fons__atlasInsertNode(atlas, i0+1, x, n->y, n->x + n->width - x) == 0)
+			return 0;
+		atlas->nodes[i0].width = (short)(x - atlas->nodes[i0].x);
+		i0++;
+		i1++;
+	}
+
+	// Replace the segments above the rect with one segment at rect top.
+	atlas->nodes[i0].x = (short)x;
+	atlas->nodes[i0].y = (short)y;
+	atlas->nodes[i0].width = (short)w;
+	for (i = i0+1; i <= i1; i++)
+		fons__atlasRemoveNode(atlas, i0+1);
+
+	// Merge same height skyline segments that are next to each other.
+	for (i = 0; i < atlas->nnodes-1; i++) {
+		if (atlas->nodes[i].y == atlas->nodes[i+1].y) {
+			atlas->nodes[i].width += atlas->nodes[i+1].width;
+			fons__atlasRemoveNode(atlas, i+1);
+			i--;
+		}
+	}
+
+	return 1;
+}
+
+static int fons__atlasInsertRect(FONSatlas* atlas, int x, int y, int w, int h)
+{
+	FONSatlasRect* r;
+	if (w <= 0 || h <= 0)
+		return 1;
+	if (atlas->nrects+1 > atlas->crects) {
+		atlas->crects = atlas->crects == 0 ? 8 : atlas->crects * 2;
+		atlas->rects = (FONSatlasRect*)fons__memRealloc(atlas->params, FONS_MEMORY_ATLAS, atlas->rects, sizeof(FONSatlasRect) * atlas->crects);
+		if (atlas->rects == NULL) {
+			atlas->nrects = atlas->crects = 0;
+			return 0;
+		}
+	}
+	r = &atlas->rects[atlas->nrects++];
+	r->x = (short)x;
+	r->y = (short)y;
+	r->width = (short)w;
+	r->height = (short)h;
+	return 1;
+}
+
+static void fons__atlasRemoveRect(FONSatlas* atlas, int idx)
+{
+	atlas->rects[idx] = atlas->rects[atlas->nrects-1];
+	atlas->nrects--;
+}
+
+static int fons__atlasFreeRect(FONSatlas* atlas, int x, int y, int w, int h, int rw, int rh)
+{
+	// Returns the freed space to the skyline or to the free rects, merging it with the free rects sharing an edge.
+	// Returns 1 if rect of size rw,rh fits in the space the rect ended up in.
+	int i, merged = 1, lowered = 0;
+
+	while (merged) {
+		merged = 0;
+		for (i = 0; i < atlas->nrects; i++) {
+			FONSatlasRect* r = &atlas->rects[i];
+			if (r->x == x && r->width == w && (r->y + r->height == y || y + h == r->y)) {
+				y = fons__mini(y, r->y);
+				h += r->height;
+			} else if (r->y == y && r->height == h && (r->x + r->width == x || x + w == r->x)) {
+				x = fons__mini(x, r->x);
+				w += r->width;
+			} else {
+				continue;
+			}
+			fons__atlasRemoveRect(atlas, i);
+			merged = 1;
+			break;
+		}
+	}
+
+	if (!fons__atlasLowerSkyline(atlas, x, y, w, h))
+		return fons__atlasInsertRect(atlas, x, y, w, h) && w >= rw && h >= rh;
+
+	// Lowering the skyline may bring more free rects right under it.
+	while (!lowered) {
+		lowered = 1;
+		for (i = 0; i < atlas->nrects; i++) {
+			FONSatlasRect* r = &atlas->rects[i];
+			if (fons__atlasLowerSkyline(atlas, r->x, r->y, r->width, r->height)) {
+				fons__atlasRemoveRect(atlas, i);
+				lowered = 0;
+				break;
+			}
+		}
+	}
+	return 1;
+}
+
+static int fons__atlasAddFreeRect(FONSatlas* atlas, int rw, int rh, int* rx, int* ry)
+{
+	// Best area fit from the free rects, the rest is split along the shorter axis.
+	FONSatlasRect r;
+	int i, besti = -1, besta = 0;
+	for (i = 0; i < atlas->nrects; i++) {
+		FONSatlasRect* f = &atlas->rects[i];
+		int a = f->width * f->height;
+		if (f->width >= rw && f->height >= rh && (besti == -1 || a < besta)) {
+			besti = i;
+			besta = a;
+		}
+	}
+	if (besti == -1)
+		return 0;
+
+	r = atlas->rects[besti];
+	fons__atlasRemoveRect(atlas, besti);
+	if (r.width - rw < r.height - rh) {
+		fons__atlasInsertRect(atlas, r.x + rw, r.y, r.width - rw, rh);
+		fons__atlasInsertRect(atlas, r.x, r.y + rh, r.width, r.height - rh);
+	} else {
+		fons__atlasInsertRect(atlas, r.x + rw, r.y, r.width - rw, r.height);
+		fons__atlasInsertRect(atlas, r.x, r.y + rh, rw, r.height - rh);
+	}
+	*rx = r.x;
+	*ry = r.y;
+
+	return 1;
+}
+
 static int fons__atlasAddRect(FONSatlas* atlas, int rw, int rh, int* rx, int* ry)
 {
 	int besth = atlas->height, bestw = atlas->width, besti = -1;
 	int bestx = -1, besty = -1, i;
 
+	// Reuse space freed by evicted glyphs first.
+	if (fons__atlasAddFreeRect(atlas, rw, rh, rx, ry))
+		return 1;
+
 	// Bottom left fit heuristic.
 	for (i = 0; i < atlas->nnodes; i++) {
 		int y = fons__atlasRectFits(atlas, i, rw, rh);
@@ -710,25 +1101,67 @@ static int fons__atlasAddRect(FONSatlas* atlas, int rw, int rh, int* rx, int* ry
 	return 1;
 }
 
+static void fons__addDirtyRect(FONScontext* stash, int page, int x0, int y0, int x1, int y1)
+{
+	int* dirty = stash->pages[page].dirtyRect;
+	dirty[0] = fons__mini(dirty[0], x0);
+	dirty[1] = fons__mini(dirty[1], y0);
+	dirty[2] = fons__maxi(dirty[2], x1);
+	dirty[3] = fons__maxi(dirty[3], y1);
+}
+
+static void fons__clearDirtyRect(FONScontext* stash, int page)
+{
+	int* dirty = stash->pages[page].dirtyRect;
+	dirty[0] = stash->params.width;
+	dirty[1] = stash->params.height;
+	dirty[2] = 0;
+	dirty[3] = 0;
+}
+
+static void fons__freePage(FONScontext* stash, FONSpage* page)
+{
+	if (page->atlas) fons__deleteAtlas(page->atlas);
+	if (page->texData) fons__memFree(&stash->params, page->texData);
+	page->atlas = NULL;
+	page->texData = NULL;
+}
+
+static int fons__allocPage(FONScontext* stash)
+{
+	FONSpage* page;
+	int size = stash->params.width * stash->params.height;
+	if (stash->npages >= FONS_MAX_PAGES) return -1;
+
+	page = &stash->pages[stash->npages];
+	page->atlas = fons__allocAtlas(&stash->params, stash->params.width, stash->params.height, FONS_INIT_ATLAS_NODES);
+	page->texData = (unsigned char*)fons__memAlloc(&stash->params, FONS_MEMORY_ATLAS, size);
+	if (page->atlas == NULL || page->texData == NULL) {
+		fons__freePage(stash, page);
+		return -1;
+	}
+	memset(page->texData, 0, size);
+	fons__clearDirtyRect(stash, stash->npages);
+
+	return stash->npages++;
+}
+
 static void fons__addWhiteRect(FONScontext* stash, int w, int h)
 {
 	int x, y, gx, gy;
 	unsigned char* dst;
-	if (fons__atlasAddRect(stash->atlas, w, h, &gx, &gy) == 0)
+	if (fons__atlasAddRect(stash->pages[0].atlas, w, h, &gx, &gy) == 0)
 		return;
 
 	// Rasterize
-	dst = &stash->texData[gx + gy * stash->params.width];
+	dst = &stash->pages[0].texData[gx + gy * stash->params.width];
 	for (y = 0; y < h; y++) {
 		for (x = 0; x < w; x++)
 			dst[x] = 0xff;
 		dst += stash->params.width;
 	}
 
-	stash->dirtyRect[0] = fons__mini(stash->dirtyRect[0], gx);
-	stash->dirtyRect[1] = fons__mini(stash->dirtyRect[1], gy);
-	stash->dirtyRect[2] = fons__maxi(stash->dirtyRect[2], gx+w);
-	stash->dirtyRect[3] = fons__maxi(stash->dirtyRect[3], gy+h);
+	fons__addDirtyRect(stash, 0, gx, gy, gx+w, gy+h);
 }
 
 FONScontext* fonsCreateInternal(FONSparams* params)
@@ -736,15 +1169,17 @@ FONScontext* fonsCreateInternal(FONSparams* params)
 	FONScontext* stash = NULL;
 
 	// Allocate memory for the font stash.
-	stash = (FONScontext*)malloc(sizeof(FONScontext));
+	stash = (FONScontext*)fons__memAlloc(params, FONS_MEMORY_GLYPHS, sizeof(FONScontext));
 	if (stash == NULL) goto error;
 	memset(stash, 0, sizeof(FONScontext));
 
 	stash->params = *params;
+	stash->simd = 1;
 
 	// Allocate scratch buffer.
-	stash->scratch = (unsigned char*)malloc(FONS_SCRATCH_BUF_SIZE);
-	if (stash->scratch == NULL) goto error;
+	stash->scratch.stash = stash;
+	stash->scratch.data = (unsigned char*)fons__memAlloc(&stash->params, FONS_MEMORY_GLYPHS, FONS_SCRATCH_BUF_SIZE);
+	if (stash->scratch.data == NULL) goto error;
 
 	// Initialize implementation library
 	if (!fons__tt_init(stash)) goto error;
@@ -754,11 +1189,8 @@ FONScontext* fonsCreateInternal(FONSparams* params)
 			goto error;
 	}
 
-	stash->atlas = fons__allocAtlas(stash->params.width, stash->params.height, FONS_INIT_ATLAS_NODES);
-	if (stash->atlas == NULL) goto error;
-
 	// Allocate space for fonts.
-	stash->fonts = (FONSfont**)malloc(sizeof(FONSfont*) * FONS_INIT_FONTS);
+	stash->fonts = (FONSfont**)fons__memAlloc(&stash->params, FONS_MEMORY_GLYPHS, sizeof(FONSfont*) * FONS_INIT_FONTS);
 	if (stash->fonts == NULL) goto error;
 	memset(stash->fonts, 0, sizeof(FONSfont*) * FONS_INIT_FONTS);
 	stash->cfonts = FONS_INIT_FONTS;
@@ -767,14 +1199,7 @@ FONScontext* fonsCreateInternal(FONSparams* params)
 	// Create texture for the cache.
 	stash->itw = 1.0f/stash->params.width;
 	stash->ith = 1.0f/stash->params.height;
-	stash->texData = (unsigned char*)malloc(stash->params.width * stash->params.height);
-	if (stash->texData == NULL) goto error;
-	memset(stash->texData, 0, stash->params.width * stash->params.height);
-
-	stash->dirtyRect[0] = stash->params.width;
-	stash->dirtyRect[1] = stash->params.height;
-	stash->dirtyRect[2] = 0;
-	stash->dirtyRect[3] = 0;
+	if (fons__allocPage(stash) == -1) goto error;
 
 	// Add white rect at 0,0 for debug drawing.
 	fons__addWhiteRect(stash, 2,2);
@@ -794,11 +1219,19 @@ static FONSstate* fons__getState(FONScontext* stash)
 	return &stash->states[stash->nstates-1];
 }
 
+static void fons__clearGlyphLut(FONSfont* font)
+{
+	int i;
+	for (i = 0; i < font->clut; i++)
+		font->lut[i] = -1;
+}
+
 int fonsAddFallbackFont(FONScontext* stash, int base, int fallback)
 {
 	FONSfont* baseFont = stash->fonts[base];
 	if (baseFont->nfallbacks < FONS_MAX_FALLBACKS) {
 		baseFont->fallbacks[baseFont->nfallbacks++] = fallback;
+		stash->generation++;
 		return 1;
 	}
 	return 0;
@@ -810,9 +1243,14 @@ void fonsResetFallbackFont(FONScontext* stash, int base)
 
 	FONSfont* baseFont = stash->fonts[base];
 	baseFont->nfallbacks = 0;
+	for (i = 0; i < baseFont->nglyphs; i++) {
+		FONSglyph* glyph = &baseFont->glyphs[i];
+		if (glyph->x0 >= 0 && glyph->y0 >= 0)
+			fons__atlasFreeRect(stash->pages[glyph->page].atlas, glyph->x0, glyph->y0, glyph->x1 - glyph->x0, glyph->y1 - glyph->y0, 0, 0);
+	}
 	baseFont->nglyphs = 0;
-	for (i = 0; i < FONS_HASH_LUT_SIZE; i++)
-		baseFont->lut[i] = -1;
+	fons__clearGlyphLut(baseFont);
+	stash->generation++;
 }
 
 void fonsSetSize(FONScontext* stash, float size)
@@ -878,12 +1316,14 @@ void fonsClearState(FONScontext* stash)
 	state->align = FONS_ALIGN_LEFT | FONS_ALIGN_BASELINE;
 }
 
-static void fons__freeFont(FONSfont* font)
+static void fons__freeFont(FONScontext* stash, FONSfont* font)
 {
 	if (font == NULL) return;
-	if (font->glyphs) free(font->glyphs);
-	if (font->freeData && font->data) free(font->data);
-	free(font);
+	if (font->glyphs) fons__memFree(&stash->params, font->glyphs);
+	if (font->lut) fons__memFree(&stash->params, font->lut);
+	if (font->freeData == FONS__FREE_INTERNAL && font->data) fons__memFree(&stash->params, font->data);
+	else if (font->freeData && font->data) free(font->data);
+	fons__memFree(&stash->params, font);
 }
 
 static int fons__allocFont(FONScontext* stash)
@@ -891,24 +1331,29 @@ static int fons__allocFont(FONScontext* stash)
 	FONSfont* font = NULL;
 	if (stash->nfonts+1 > stash->cfonts) {
 		stash->cfonts = stash->cfonts == 0 ? 8 : stash->cfonts * 2;
-		stash->fonts = (FONSfont**)realloc(stash->fonts, sizeof(FONSfont*) * stash->cfonts);
+		stash->fonts = (FONSfont**)fons__memRealloc(&stash->params, FONS_MEMORY_GLYPHS, stash->fonts, sizeof(FONSfont*) * stash->cfonts);
 		if (stash->fonts == NULL)
 			return -1;
 	}
-	font = (FONSfont*)malloc(sizeof(FONSfont));
+	font = (FONSfont*)fons__memAlloc(&stash->params, FONS_MEMORY_GLYPHS, sizeof(FONSfont));
 	if (font == NULL) goto error;
 	memset(font, 0, sizeof(FONSfont));
 
-	font->glyphs = (FONSglyph*)malloc(sizeof(FONSglyph) * FONS_INIT_GLYPHS);
+	font->glyphs = (FONSglyph*)fons__memAlloc(&stash->params, FONS_MEMORY_GLYPHS, sizeof(FONSglyph) * FONS_INIT_GLYPHS);
 	if (font->glyphs == NULL) goto error;
 	font->cglyphs = FONS_INIT_GLYPHS;
 	font->nglyphs = 0;
 
+	font->lut = (int*)fons__memAlloc(&stash->params, FONS_MEMORY_GLYPHS, sizeof(int) * FONS_HASH_LUT_SIZE);
+	if (font->lut == NULL) goto error;
+	font->clut = FONS_HASH_LUT_SIZE;
+	fons__clearGlyphLut(font);
+
 	stash->fonts[stash->nfonts++] = font;
 	return stash->nfonts-1;
 
 error:
-	fons__freeFont(font);
+	fons__freeFont(stash, font);
 
 	return FONS_INVALID;
 }
@@ -926,24 +1371,24 @@ int fonsAddFont(FONScontext* stash, const char* name, const char* path, int font
 	fseek(fp,0,SEEK_END);
 	dataSize = (int)ftell(fp);
 	fseek(fp,0,SEEK_SET);
-	data = (unsigned char*)malloc(dataSize);
+	data = (unsigned char*)fons__memAlloc(&stash->params, FONS_MEMORY_GLYPHS, dataSize);
 	if (data == NULL) goto error;
 	readed = fread(data, 1, dataSize, fp);
 	fclose(fp);
 	fp = 0;
 	if (readed != (size_t)dataSize) goto error;
 
-	return fonsAddFontMem(stash, name, data, dataSize, 1, fontIndex);
+	return fonsAddFontMem(stash, name, data, dataSize, FONS__FREE_INTERNAL, fontIndex);
 
 error:
-	if (data) free(data);
+	if (data) fons__memFree(&stash->params, data);
 	if (fp) fclose(fp);
 	return FONS_INVALID;
 }
 
 int fonsAddFontMem(FONScontext* stash, const char* name, unsigned char* data, int dataSize, int freeData, int fontIndex)
 {
-	int i, ascent, descent, fh, lineGap;
+	int ascent, descent, fh, lineGap;
 	FONSfont* font;
 
 	int idx = fons__allocFont(stash);
@@ -955,17 +1400,14 @@ int fonsAddFontMem(FONScontext* stash, const char* name, unsigned char* data, in
 	strncpy(font->name, name, sizeof(font->name));
 	font->name[sizeof(font->name)-1] = '\0';
 
-	// Init hash lookup.
-	for (i = 0; i < FONS_HASH_LUT_SIZE; ++i)
-		font->lut[i] = -1;
-
 	// Read in the font data.
 	font->dataSize = dataSize;
+	font->faceIndex = fontIndex;
 	font->data = data;
 	font->freeData = (unsigned char)freeData;
 
 	// Init font
-	stash->nscratch = 0;
+	stash->scratch.n = 0;
 	if (!fons__tt_loadFont(stash, &font->font, data, dataSize, fontIndex)) goto error;
 
 	// Store normalized line height. The real line height is got
@@ -980,7 +1422,7 @@ int fonsAddFontMem(FONScontext* stash, const char* name, unsigned char* data, in
 	return idx;
 
 error:
-	fons__freeFont(font);
+	fons__freeFont(stash, font);
 	stash->nfonts--;
 	return FONS_INVALID;
 }
@@ -996,17 +1438,55 @@ int fonsGetFontByName(FONScontext* s, const char* name)
 }
 
 
-static FONSglyph* fons__allocGlyph(FONSfont* font)
+static FONSglyph* fons__allocGlyph(FONScontext* stash, FONSfont* font)
 {
 	if (font->nglyphs+1 > font->cglyphs) {
 		font->cglyphs = font->cglyphs == 0 ? 8 : font->cglyphs * 2;
-		font->glyphs = (FONSglyph*)realloc(font->glyphs, sizeof(FONSglyph) * font->cglyphs);
+		font->glyphs = (FONSglyph*)fons__memRealloc(&stash->params, FONS_MEMORY_GLYPHS, font->glyphs, sizeof(FONSglyph) * font->cglyphs);
 		if (font->glyphs == NULL) return NULL;
 	}
 	font->nglyphs++;
 	return &font->glyphs[font->nglyphs-1];
 }
 
+static unsigned int fons__glyphHash(unsigned int codepoint, short isize, short iblur)
+{
+	return fons__hashint(codepoint ^ fons__hashint(((unsigned int)(unsigned short)isize << 8) ^ (unsigned int)iblur));
+}
+
+static void fons__lutInsert(FONSfont* font, int i)
+{
+	FONSglyph* glyph = &font->glyphs[i];
+	unsigned int mask = (unsigned int)font->clut-1;
+	unsigned int h = fons__glyphHash(glyph->codepoint, glyph->size, glyph->blur) & mask;
+	while (font->lut[h] != -1)
+		h = (h+1) & mask;
+	font->lut[h] = i;
+}
+
+// Adds the last allocated glyph to the lookup. The table is doubled when it gets more than half full.
+static int fons__addGlyphLut(FONScontext* stash, FONSfont* font)
+{
+	int i;
+	if (font->nglyphs*2 > font->clut) {
+		int* lut = (int*)fons__memAlloc(&stash->params, FONS_MEMORY_GLYPHS, sizeof(int) * font->clut * 2);
+		if (lut != NULL) {
+			fons__memFree(&stash->params, font->lut);
+			font->lut = lut;
+			font->clut *= 2;
+			fons__clearGlyphLut(font);
+			for (i = 0; i < font->nglyphs; i++)
+				fons__lutInsert(font, i);
+			return 1;
+		}
+		// Keep filling the old table, one empty slot must remain to end the probing.
+		if (font->nglyphs >= font->clut)
+			return 0;
+	}
+	fons__lutInsert(font, font->nglyphs-1);
+	return 1;
+}
+
 
 // Based on Exponential blur, Jani Huhtanen, 2006
 
@@ -1054,17 +1534,166 @@ static void fons__blurRows(unsigned char* dst, int w, int h, int dstStride, int
 }
 
 
+#ifdef FONS_SSE2
+// One filter step on 8 lanes, same arithmetic as the scalar version.
+// alpha is below 1<<16 but does not fit signed 16 bits, the high bit is added back with amask.
+static __m128i fons__blurStepSSE2(__m128i z, __m128i v, __m128i alpha, __m128i amask)
+{
+	__m128i d = _mm_sub_epi16(_mm_slli_epi16(v, ZPREC), z);
+	return _mm_add_epi16(z, _mm_add_epi16(_mm_mulhi_epi16(d, alpha), _mm_and_si128(d, amask)));
+}
+
+// Blurs 16 columns at a time, the remaining columns are done by the scalar version.
+static void fons__blurRowsSSE2(unsigned char* dst, int w, int h, int dstStride, int alpha)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i va = _mm_set1_epi16((short)alpha);
+	__m128i amask = _mm_set1_epi16(alpha >= 0x8000 ? -1 : 0);
+	int x, y;
+	for (x = 0; x+16 <= w; x += 16) {
+		__m128i z0 = zero, z1 = zero, v;
+		unsigned char* col = dst + x;
+		for (y = 1; y < h; y++) {
+			v = _mm_loadu_si128((const __m128i*)(col + y*dstStride));
+			z0 = fons__blurStepSSE2(z0, _mm_unpacklo_epi8(v, zero), va, amask);
+			z1 = fons__blurStepSSE2(z1, _mm_unpackhi_epi8(v, zero), va, amask);
+			v = _mm_packus_epi16(_mm_srli_epi16(z0, ZPREC), _mm_srli_epi16(z1, ZPREC));
+			_mm_storeu_si128((__m128i*)(col + y*dstStride), v);
+		}
+		memset(col + (h-1)*dstStride, 0, 16);
+		z0 = z1 = zero;
+		for (y = h-2; y >= 0; y--) {
+			v = _mm_loadu_si128((const __m128i*)(col + y*dstStride));
+			z0 = fons__blurStepSSE2(z0, _mm_unpacklo_epi8(v, zero), va, amask);
+			z1 = fons__blurStepSSE2(z1, _mm_unpackhi_epi8(v, zero), va, amask);
+			v = _mm_packus_epi16(_mm_srli_epi16(z0, ZPREC), _mm_srli_epi16(z1, ZPREC));
+			_mm_storeu_si128((__m128i*)(col + y*dstStride), v);
+		}
+		memset(col, 0, 16);
+	}
+	if (x < w)
+		fons__blurRows(dst + x, w - x, h, dstStride, alpha);
+}
+
+// Transposes 8x8 bytes, the rows are in the low halves of r[0..7].
+static void fons__transpose8x8SSE2(__m128i* r)
+{
+	__m128i a0 = _mm_unpacklo_epi8(r[0], r[1]);
+	__m128i a1 = _mm_unpacklo_epi8(r[2], r[3]);
+	__m128i a2 = _mm_unpacklo_epi8(r[4], r[5]);
+	__m128i a3 = _mm_unpacklo_epi8(r[6], r[7]);
+	__m128i b0 = _mm_unpacklo_epi16(a0, a1);
+	__m128i b1 = _mm_unpackhi_epi16(a0, a1);
+	__m128i b2 = _mm_unpacklo_epi16(a2, a3);
+	__m128i b3 = _mm_unpackhi_epi16(a2, a3);
+	r[0] = _mm_unpacklo_epi32(b0, b2);
+	r[2] = _mm_unpackhi_epi32(b0, b2);
+	r[4] = _mm_unpacklo_epi32(b1, b3);
+	r[6] = _mm_unpackhi_epi32(b1, b3);
+	r[1] = _mm_unpackhi_epi64(r[0], r[0]);
+	r[3] = _mm_unpackhi_epi64(r[2], r[2]);
+	r[5] = _mm_unpackhi_epi64(r[4], r[4]);
+	r[7] = _mm_unpackhi_epi64(r[6], r[6]);
+}
+
+// Loads n columns starting at x from 8 rows, one column per vector.
+static void fons__loadColsSSE2(const unsigned char* dst, int dstStride, int x, int n, __m128i* c)
+{
+	__m128i zero = _mm_setzero_si128();
+	int i;
+	if (n == 8) {
+		for (i = 0; i < 8; i++)
+			c[i] = _mm_loadl_epi64((const __m128i*)(dst + i*dstStride + x));
+		fons__transpose8x8SSE2(c);
+		for (i = 0; i < 8; i++)
+			c[i] = _mm_unpacklo_epi8(c[i], zero);
+	} else {
+		for (i = 0; i < n; i++, x++)
+			c[i] = _mm_setr_epi16(dst[x], dst[dstStride+x], dst[2*dstStride+x], dst[3*dstStride+x],
+								  dst[4*dstStride+x], dst[5*dstStride+x], dst[6*dstStride+x], dst[7*dstStride+x]);
+	}
+}
+
+static void fons__storeColsSSE2(unsigned char* dst, int dstStride, int x, int n, __m128i* c)
+{
+	__m128i zero = _mm_setzero_si128();
+	short v[8];
+	int i, j;
+	if (n == 8) {
+		for (i = 0; i < 8; i++)
+			c[i] = _mm_packus_epi16(c[i], zero);
+		fons__transpose8x8SSE2(c);
+		for (i = 0; i < 8; i++)
+			_mm_storel_epi64((__m128i*)(dst + i*dstStride + x), c[i]);
+	} else {
+		for (i = 0; i < n; i++, x++) {
+			_mm_storeu_si128((__m128i*)v, c[i]);
+			for (j = 0; j < 8; j++)
+				dst[j*dstStride + x] = (unsigned char)v[j];
+		}
+	}
+}
+
+// Blurs 8 rows at a time, the remaining rows are done by the scalar version.
+static void fons__blurColsSSE2(unsigned char* dst, int w, int h, int dstStride, int alpha)
+{
+	__m128i va = _mm_set1_epi16((short)alpha);
+	__m128i amask = _mm_set1_epi16(alpha >= 0x8000 ? -1 : 0);
+	__m128i c[8], z;
+	int x, y, i, n;
+	for (y = 0; y+8 <= h; y += 8) {
+		z = _mm_setzero_si128(); // force zero border
+		for (x = 0; x < w; x += 8) {
+			n = fons__mini(8, w - x);
+			fons__loadColsSSE2(dst, dstStride, x, n, c);
+			for (i = x == 0 ? 1 : 0; i < n; i++) {
+				z = fons__blurStepSSE2(z, c[i], va, amask);
+				c[i] = _mm_srli_epi16(z, ZPREC);
+			}
+			fons__storeColsSSE2(dst, dstStride, x, n, c);
+		}
+		for (i = 0; i < 8; i++)
+			dst[i*dstStride + w-1] = 0; // force zero border
+		z = _mm_setzero_si128();
+		for (x = (w-1) & ~7; x >= 0; x -= 8) {
+			n = fons__mini(8, w - x);
+			fons__loadColsSSE2(dst, dstStride, x, n, c);
+			for (i = fons__mini(n-1, w-2 - x); i >= 0; i--) {
+				z = fons__blurStepSSE2(z, c[i], va, amask);
+				c[i] = _mm_srli_epi16(z, ZPREC);
+			}
+			fons__storeColsSSE2(dst, dstStride, x, n, c);
+		}
+		for (i = 0; i < 8; i++)
+			dst[i*dstStride] = 0; // force zero border
+		dst += 8*dstStride;
+	}
+	if (y < h)
+		fons__blurCols(dst, w, h - y, dstStride, alpha);
+}
+#endif
+
 static void fons__blur(FONScontext* stash, unsigned char* dst, int w, int h, int dstStride, int blur)
 {
 	int alpha;
 	float sigma;
-	(void)stash;
 
 	if (blur < 1)
 		return;
 	// Calculate the alpha such that 90% of the kernel is within the radius. (Kernel extends to infinity)
 	sigma = (float)blur * 0.57735f; // 1 / sqrt(3)
 	alpha = (int)((1<<APREC) * (1.0f - expf(-2.3f / (sigma+1.0f))));
+#ifdef FONS_SSE2
+	if (stash->simd) {
+		fons__blurRowsSSE2(dst, w, h, dstStride, alpha);
+		fons__blurColsSSE2(dst, w, h, dstStride, alpha);
+		fons__blurRowsSSE2(dst, w, h, dstStride, alpha);
+		fons__blurColsSSE2(dst, w, h, dstStride, alpha);
+		return;
+	}
+#else
+	(void)stash;
+#endif
 	fons__blurRows(dst, w, h, dstStride, alpha);
 	fons__blurCols(dst, w, h, dstStride, alpha);
 	fons__blurRows(dst, w, h, dstStride, alpha);
@@ -1073,91 +1702,308 @@ static void fons__blur(FONScontext* stash, unsigned char* dst, int w, int h, int
 //	fons__blurcols(dst, w, h, dstStride, alpha);
 }
 
-static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
-								 short isize, short iblur, int bitmapOption)
+static int fons__compareGlyphAge(const void* a, const void* b)
 {
-	int i, g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy, x, y;
-	float scale;
-	FONSglyph* glyph = NULL;
-	unsigned int h;
-	float size = isize/10.0f;
-	int pad, added;
-	unsigned char* bdst;
-	unsigned char* dst;
-	FONSfont* renderFont = font;
-
-	if (isize < 2) return NULL;
-	if (iblur > 20) iblur = 20;
-	pad = iblur+2;
+	const FONSglyph* ga = *(const FONSglyph**)a;
+	const FONSglyph* gb = *(const FONSglyph**)b;
+	if (ga->lastUsed < gb->lastUsed) return -1;
+	if (ga->lastUsed > gb->lastUsed) return 1;
+	return 0;
+}
 
-	// Reset allocator.
-	stash->nscratch = 0;
+static int fons__evictGlyphs(FONScontext* stash, int w, int h, int* gx, int* gy, int* page)
+{
+	// Evicts least recently used glyphs, which are not used this frame, until the rect fits.
+	FONSglyph** lru = NULL;
+	int i, j, n = 0, added = 0;
 
-	// Find code point and size.
-	h = fons__hashint(codepoint) & (FONS_HASH_LUT_SIZE-1);
-	i = font->lut[h];
-	while (i != -1) {
-		if (font->glyphs[i].codepoint == codepoint && font->glyphs[i].size == isize && font->glyphs[i].blur == iblur) {
-			glyph = &font->glyphs[i];
-			if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL || (glyph->x0 >= 0 && glyph->y0 >= 0)) {
-			  return glyph;
-			}
-			// At this point, glyph exists but the bitmap data is not yet created.
-			break;
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* font = stash->fonts[i];
+		for (j = 0; j < font->nglyphs; j++) {
+			FONSglyph* glyph = &font->glyphs[j];
+			if (glyph->x0 >= 0 && glyph->y0 >= 0 && glyph->lastUsed != stash->frame)
+				n++;
 		}
-		i = font->glyphs[i].next;
 	}
+	if (n == 0) return 0;
 
-	// Create a new glyph or rasterize bitmap data for a cached glyph.
-	g = fons__tt_getGlyphIndex(&font->font, codepoint);
-	// Try to find the glyph in fallback fonts.
-	if (g == 0) {
-		for (i = 0; i < font->nfallbacks; ++i) {
-			FONSfont* fallbackFont = stash->fonts[font->fallbacks[i]];
-			int fallbackIndex = fons__tt_getGlyphIndex(&fallbackFont->font, codepoint);
-			if (fallbackIndex != 0) {
-				g = fallbackIndex;
-				renderFont = fallbackFont;
-				break;
-			}
+	lru = (FONSglyph**)fons__memAlloc(&stash->params, FONS_MEMORY_GLYPHS, sizeof(FONSglyph*) * n);
+	if (lru == NULL) return 0;
+	n = 0;
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* font = stash->fonts[i];
+		for (j = 0; j < font->nglyphs; j++) {
+			FONSglyph* glyph = &font->glyphs[j];
+			if (glyph->x0 >= 0 && glyph->y0 >= 0 && glyph->lastUsed != stash->frame)
+				lru[n++] = glyph;
 		}
-		// It is possible that we did not find a fallback glyph.
-		// In that case the glyph index 'g' is 0, and we'll proceed below and cache empty glyph.
 	}
-	scale = fons__tt_getPixelHeightScale(&renderFont->font, size);
-	fons__tt_buildGlyphBitmap(&renderFont->font, g, size, scale, &advance, &lsb, &x0, &y0, &x1, &y1);
-	gw = x1-x0 + pad*2;
-	gh = y1-y0 + pad*2;
-
-	// Determines the spot to draw glyph in the atlas.
-	if (bitmapOption == FONS_GLYPH_BITMAP_REQUIRED) {
-		// Find free spot for the rect in the atlas
-		added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
-		if (added == 0 && stash->handleError != NULL) {
-			// Atlas is full, let the user to resize the atlas (or not), and try again.
-			stash->handleError(stash->errorUptr, FONS_ATLAS_FULL, 0);
-			added = fons__atlasAddRect(stash->atlas, gw, gh, &gx, &gy);
+	qsort(lru, n, sizeof(FONSglyph*), fons__compareGlyphAge);
+
+	for (i = 0; i < n && added == 0; i++) {
+		FONSglyph* glyph = lru[i];
+		FONSatlas* atlas = stash->pages[glyph->page].atlas;
+		int fits = fons__atlasFreeRect(atlas, glyph->x0, glyph->y0, glyph->x1 - glyph->x0, glyph->y1 - glyph->y0, w, h);
+		// Keep the metrics, the bitmap is rasterized again when needed.
+		glyph->x1 = (short)(glyph->x1 - glyph->x0 - 1);
+		glyph->y1 = (short)(glyph->y1 - glyph->y0 - 1);
+		glyph->x0 = -1;
+		glyph->y0 = -1;
+		stash->stats.glyphEvictions++;
+		if (fits) {
+			added = fons__atlasAddRect(atlas, w, h, gx, gy);
+			*page = glyph->page;
 		}
-		if (added == 0) return NULL;
-	} else {
-		// Negative coordinate indicates there is no bitmap data created.
-		gx = -1;
-		gy = -1;
 	}
+	stash->generation++;
 
-	// Init glyph.
-	if (glyph == NULL) {
-		glyph = fons__allocGlyph(font);
-		glyph->codepoint = codepoint;
-		glyph->size = isize;
-		glyph->blur = iblur;
-		glyph->next = 0;
+	fons__memFree(&stash->params, lru);
+	return added;
+}
+
+// Rasterizes the glyph bitmap into the atlas area of the glyph.
+static void fons__rasterizeGlyph(FONScontext* stash, FONSttFontImpl* ttFont, FONSglyph* glyph, float scale, int pad, int iblur)
+{
+	int y, gw = glyph->x1 - glyph->x0, gh = glyph->y1 - glyph->y0;
+	int stride = stash->params.width;
+	unsigned char* texData = stash->pages[glyph->page].texData;
+	unsigned char* gdst = &texData[glyph->x0 + glyph->y0 * stride];
+	unsigned char* dst;
+
+	// Clear the area first, it may have been used by an evicted glyph.
+	// This also makes sure there is one pixel empty border.
+	for (y = 0; y < gh; y++)
+		memset(&gdst[y*stride], 0, gw);
+	if (stash->params.flags & FONS_SDF) {
+		dst = &texData[(glyph->x0+1) + (glyph->y0+1) * stride];
+		fons__tt_renderGlyphSDF(ttFont, dst, gw-2, gh-2, stride, scale, pad-1, glyph->index);
+	} else {
+		dst = &texData[(glyph->x0+pad) + (glyph->y0+pad) * stride];
+		fons__tt_renderGlyphBitmap(ttFont, dst, gw-pad*2,gh-pad*2, stride, scale, scale, glyph->index);
+	}
+
+	// Debug code to color the glyph background
+/*	unsigned char* fdst = &texData[glyph->x0 + glyph->y0 * stash->params.width];
+	for (y = 0; y < gh; y++) {
+		for (x = 0; x < gw; x++) {
+			int a = (int)fdst[x+y*stash->params.width] + 20;
+			if (a > 255) a = 255;
+			fdst[x+y*stash->params.width] = a;
+		}
+	}*/
+
+	// Blur
+	if (iblur > 0)
+		fons__blur(stash, gdst, gw, gh, stride, iblur);
+}
+
+static void fons__markDirty(FONScontext* stash, FONSglyph* glyph)
+{
+	fons__addDirtyRect(stash, glyph->page, glyph->x0, glyph->y0, glyph->x1, glyph->y1);
+}
+
+// Finds room for the glyph, the latest page is tried first since the older ones are likely full.
+static int fons__addGlyphRect(FONScontext* stash, int w, int h, int* gx, int* gy, int* page)
+{
+	int i;
+	for (i = stash->npages-1; i >= 0; i--) {
+		if (fons__atlasAddRect(stash->pages[i].atlas, w, h, gx, gy)) {
+			*page = i;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// Queues the glyph for the workers, returns 0 if it must be rasterized right away.
+static int fons__queueGlyph(FONScontext* stash, FONSfont* font, FONSfont* renderFont, FONSglyph* glyph, float scale, int pad, int iblur)
+{
+#ifdef FONS_USE_FREETYPE
+	// The glyph is rendered from the face glyph slot loaded by fons__tt_buildGlyphBitmap.
+	FONS_NOTUSED(stash); FONS_NOTUSED(font); FONS_NOTUSED(renderFont); FONS_NOTUSED(glyph);
+	FONS_NOTUSED(scale); FONS_NOTUSED(pad); FONS_NOTUSED(iblur);
+	return 0;
+#else
+	FONSglyphJob* job;
+	if (stash->nworkers <= 0)
+		return 0;
+	if (stash->njobs+1 > stash->cjobs) {
+		int cjobs = stash->cjobs == 0 ? 64 : stash->cjobs * 2;
+		FONSglyphJob* jobs = (FONSglyphJob*)fons__memRealloc(&stash->params, FONS_MEMORY_GLYPHS, stash->jobs, sizeof(FONSglyphJob) * cjobs);
+		if (jobs == NULL) return 0;
+		stash->jobs = jobs;
+		stash->cjobs = cjobs;
+	}
+	job = &stash->jobs[stash->njobs++];
+	job->font = font;
+	job->renderFont = renderFont;
+	job->glyph = (int)(glyph - font->glyphs);
+	job->scale = scale;
+	job->pad = (short)pad;
+	job->blur = (short)iblur;
+	return 1;
+#endif
+}
+
+static void fons__rasterizeTask(void* taskPtr, int index)
+{
+	FONScontext* stash = (FONScontext*)taskPtr;
+	FONSscratch* scratch = &stash->workers[index];
+	int i;
+	for (i = index; i < stash->njobs; i += stash->ntasks) {
+		FONSglyphJob* job = &stash->jobs[i];
+		// Each worker allocates from its own scratch memory.
+		FONSttFontImpl ttFont = job->renderFont->font;
+		fons__tt_setScratch(&ttFont, scratch);
+		scratch->n = 0;
+		fons__rasterizeGlyph(stash, &ttFont, &job->font->glyphs[job->glyph], job->scale, job->pad, job->blur);
+	}
+}
+
+static void fons__rasterizeQueued(FONScontext* stash)
+{
+	long long startTime = 0;
+	int i;
+
+	if (stash->njobs == 0)
+		return;
+
+	if (stash->params.timeNs != NULL)
+		startTime = stash->params.timeNs(stash->params.userPtr);
+	stash->ntasks = fons__mini(stash->nworkers, stash->njobs);
+	if (stash->runner != NULL && stash->ntasks > 1) {
+		stash->runner(stash->runnerUptr, fons__rasterizeTask, stash, stash->ntasks);
+	} else {
+		for (i = 0; i < stash->ntasks; i++)
+			fons__rasterizeTask(stash, i);
+	}
+	if (stash->params.timeNs != NULL)
+		stash->stats.rasterizeTime += stash->params.timeNs(stash->params.userPtr) - startTime;
+
+	for (i = 0; i < stash->njobs; i++)
+		fons__markDirty(stash, &stash->jobs[i].font->glyphs[stash->jobs[i].glyph]);
+	stash->njobs = 0;
+}
+
+// Returns the size a distance field glyph is cached at, scaled up at most 2x when rendered.
+static short fons__sdfSize(short isize)
+{
+	short sdfSize = FONS_SDF_MIN_SIZE*10;
+	while (sdfSize*2 < isize && sdfSize < FONS_SDF_MAX_SIZE*10)
+		sdfSize *= 2;
+	return sdfSize;
+}
+
+static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned int codepoint,
+								 short isize, short iblur, int bitmapOption)
+{
+	int i, g, advance, lsb, x0, y0, x1, y1, gw, gh, gx, gy, page = 0;
+	float scale;
+	FONSglyph* glyph = NULL;
+	unsigned int h, mask;
+	float size = isize/10.0f;
+	int pad, added;
+	FONSfont* renderFont = font;
+	long long startTime = 0;
+	int sdf = (stash->params.flags & FONS_SDF) != 0;
+
+	if (isize < 2) return NULL;
+	if (sdf) {
+		// Blur is applied when rendering the distance field.
+		isize = fons__sdfSize(isize);
+		size = isize/10.0f;
+		iblur = 0;
+		pad = FONS_SDF_PADDING+1;
+	} else {
+		if (iblur > 20) iblur = 20;
+		pad = iblur+2;
+	}
+
+	// Reset allocator.
+	stash->scratch.n = 0;
+
+	// Find code point and size.
+	mask = (unsigned int)font->clut-1;
+	h = fons__glyphHash(codepoint, isize, iblur) & mask;
+	while ((i = font->lut[h]) != -1) {
+		if (font->glyphs[i].codepoint == codepoint && font->glyphs[i].size == isize && font->glyphs[i].blur == iblur) {
+			glyph = &font->glyphs[i];
+			if (bitmapOption == FONS_GLYPH_BITMAP_OPTIONAL) {
+			  stash->stats.glyphHits++;
+			  return glyph;
+			}
+			if (glyph->x0 >= 0 && glyph->y0 >= 0) {
+			  // Prepared strings are looked up again when iterated.
+			  if (bitmapOption != FONS__GLYPH_BITMAP_QUEUED)
+			    stash->stats.glyphHits++;
+			  glyph->lastUsed = stash->frame;
+			  return glyph;
+			}
+			// At this point, glyph exists but the bitmap data is not yet created.
+			break;
+		}
+		h = (h+1) & mask;
+	}
+
+	// Create a new glyph or rasterize bitmap data for a cached glyph.
+	stash->stats.glyphMisses++;
+	g = fons__tt_getGlyphIndex(&font->font, codepoint);
+	// Try to find the glyph in fallback fonts.
+	if (g == 0) {
+		for (i = 0; i < font->nfallbacks; ++i) {
+			FONSfont* fallbackFont = stash->fonts[font->fallbacks[i]];
+			int fallbackIndex = fons__tt_getGlyphIndex(&fallbackFont->font, codepoint);
+			if (fallbackIndex != 0) {
+				g = fallbackIndex;
+				renderFont = fallbackFont;
+				break;
+			}
+		}
+		// It is possible that we did not find a fallback glyph.
+		// In that case the glyph index 'g' is 0, and we'll proceed below and cache empty glyph.
+	}
+	scale = fons__tt_getPixelHeightScale(&renderFont->font, size);
+	fons__tt_buildGlyphBitmap(&renderFont->font, g, size, scale, &advance, &lsb, &x0, &y0, &x1, &y1);
+	gw = x1-x0 + pad*2;
+	gh = y1-y0 + pad*2;
+
+	// Determines the spot to draw glyph in the atlas.
+	if (bitmapOption != FONS_GLYPH_BITMAP_OPTIONAL) {
+		// Find free spot for the rect in the atlas
+		added = fons__addGlyphRect(stash, gw, gh, &gx, &gy, &page);
+		if (added == 0 && stash->handleError != NULL) {
+			// Atlas is full, let the user to resize the atlas or add a page (or not), and try again.
+			stash->handleError(stash->errorUptr, FONS_ATLAS_FULL, 0);
+			added = fons__addGlyphRect(stash, gw, gh, &gx, &gy, &page);
+		}
+		if (added == 0)
+			added = fons__evictGlyphs(stash, gw, gh, &gx, &gy, &page);
+		if (added == 0) return NULL;
+	} else {
+		// Negative coordinate indicates there is no bitmap data created.
+		gx = -1;
+		gy = -1;
+	}
+
+	// Init glyph.
+	if (glyph == NULL) {
+		glyph = fons__allocGlyph(stash, font);
+		if (glyph == NULL) return NULL;
+		glyph->codepoint = codepoint;
+		glyph->size = isize;
+		glyph->blur = iblur;
+		glyph->lastUsed = stash->frame;
 
 		// Insert char to hash lookup.
-		glyph->next = font->lut[h];
-		font->lut[h] = font->nglyphs-1;
+		if (!fons__addGlyphLut(stash, font)) {
+			font->nglyphs--;
+			return NULL;
+		}
 	}
+	if (bitmapOption != FONS_GLYPH_BITMAP_OPTIONAL)
+		glyph->lastUsed = stash->frame;
 	glyph->index = g;
+	glyph->page = (short)page;
 	glyph->x0 = (short)gx;
 	glyph->y0 = (short)gy;
 	glyph->x1 = (short)(glyph->x0+gw);
@@ -1170,51 +2016,29 @@ static FONSglyph* fons__getGlyph(FONScontext* stash, FONSfont* font, unsigned in
 		return glyph;
 	}
 
-	// Rasterize
-	dst = &stash->texData[(glyph->x0+pad) + (glyph->y0+pad) * stash->params.width];
-	fons__tt_renderGlyphBitmap(&renderFont->font, dst, gw-pad*2,gh-pad*2, stash->params.width, scale, scale, g);
-
-	// Make sure there is one pixel empty border.
-	dst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-	for (y = 0; y < gh; y++) {
-		dst[y*stash->params.width] = 0;
-		dst[gw-1 + y*stash->params.width] = 0;
-	}
-	for (x = 0; x < gw; x++) {
-		dst[x] = 0;
-		dst[x + (gh-1)*stash->params.width] = 0;
-	}
-
-	// Debug code to color the glyph background
-/*	unsigned char* fdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-	for (y = 0; y < gh; y++) {
-		for (x = 0; x < gw; x++) {
-			int a = (int)fdst[x+y*stash->params.width] + 20;
-			if (a > 255) a = 255;
-			fdst[x+y*stash->params.width] = a;
-		}
-	}*/
+	// Glyphs of a prepared string are rasterized by the workers.
+	if (bitmapOption == FONS__GLYPH_BITMAP_QUEUED && fons__queueGlyph(stash, font, renderFont, glyph, scale, pad, iblur))
+		return glyph;
 
-	// Blur
-	if (iblur > 0) {
-		stash->nscratch = 0;
-		bdst = &stash->texData[glyph->x0 + glyph->y0 * stash->params.width];
-		fons__blur(stash, bdst, gw, gh, stash->params.width, iblur);
-	}
+	// Rasterize
+	if (stash->params.timeNs != NULL)
+		startTime = stash->params.timeNs(stash->params.userPtr);
+	fons__rasterizeGlyph(stash, &renderFont->font, glyph, scale, pad, iblur);
+	if (stash->params.timeNs != NULL)
+		stash->stats.rasterizeTime += stash->params.timeNs(stash->params.userPtr) - startTime;
 
-	stash->dirtyRect[0] = fons__mini(stash->dirtyRect[0], glyph->x0);
-	stash->dirtyRect[1] = fons__mini(stash->dirtyRect[1], glyph->y0);
-	stash->dirtyRect[2] = fons__maxi(stash->dirtyRect[2], glyph->x1);
-	stash->dirtyRect[3] = fons__maxi(stash->dirtyRect[3], glyph->y1);
+	fons__markDirty(stash, glyph);
 
 	return glyph;
 }
 
 static void fons__getQuad(FONScontext* stash, FONSfont* font,
-						   int prevGlyphIndex, FONSglyph* glyph,
+						   int prevGlyphIndex, FONSglyph* glyph, short isize,
 						   float scale, float spacing, float* x, float* y, FONSquad* q)
 {
 	float rx,ry,xoff,yoff,x0,y0,x1,y1;
+	// Distance field glyphs are scaled from the size they were cached at.
+	float gs = (float)isize / glyph->size;
 
 	if (prevGlyphIndex != -1) {
 		float adv = fons__tt_getGlyphKernAdvance(&font->font, prevGlyphIndex, glyph->index) * scale;
@@ -1224,8 +2048,8 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 	// Each glyph has 2px border to allow good interpolation,
 	// one pixel to prevent leaking, and one to allow good interpolation for rendering.
 	// Inset the texture region by one pixel for correct interpolation.
-	xoff = (short)(glyph->xoff+1);
-	yoff = (short)(glyph->yoff+1);
+	xoff = (glyph->xoff+1) * gs;
+	yoff = (glyph->yoff+1) * gs;
 	x0 = (float)(glyph->x0+1);
 	y0 = (float)(glyph->y0+1);
 	x1 = (float)(glyph->x1-1);
@@ -1237,8 +2061,8 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 
 		q->x0 = rx;
 		q->y0 = ry;
-		q->x1 = rx + x1 - x0;
-		q->y1 = ry + y1 - y0;
+		q->x1 = rx + (x1 - x0) * gs;
+		q->y1 = ry + (y1 - y0) * gs;
 
 		q->s0 = x0 * stash->itw;
 		q->t0 = y0 * stash->ith;
@@ -1250,8 +2074,8 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 
 		q->x0 = rx;
 		q->y0 = ry;
-		q->x1 = rx + x1 - x0;
-		q->y1 = ry - y1 + y0;
+		q->x1 = rx + (x1 - x0) * gs;
+		q->y1 = ry - (y1 - y0) * gs;
 
 		q->s0 = x0 * stash->itw;
 		q->t0 = y0 * stash->ith;
@@ -1259,20 +2083,20 @@ static void fons__getQuad(FONScontext* stash, FONSfont* font,
 		q->t1 = y1 * stash->ith;
 	}
 
-	*x += (int)(glyph->xadv / 10.0f + 0.5f);
+	q->page = glyph->page;
+
+	*x += (int)(glyph->xadv * gs / 10.0f + 0.5f);
 }
 
 static void fons__flush(FONScontext* stash)
 {
 	// Flush texture
-	if (stash->dirtyRect[0] < stash->dirtyRect[2] && stash->dirtyRect[1] < stash->dirtyRect[3]) {
+	int* dirty = stash->pages[0].dirtyRect;
+	if (dirty[0] < dirty[2] && dirty[1] < dirty[3]) {
 		if (stash->params.renderUpdate != NULL)
-			stash->params.renderUpdate(stash->params.userPtr, stash->dirtyRect, stash->texData);
+			stash->params.renderUpdate(stash->params.userPtr, dirty, stash->pages[0].texData);
 		// Reset dirty rect
-		stash->dirtyRect[0] = stash->params.width;
-		stash->dirtyRect[1] = stash->params.height;
-		stash->dirtyRect[2] = 0;
-		stash->dirtyRect[3] = 0;
+		fons__clearDirtyRect(stash, 0);
 	}
 
 	// Flush triangles
@@ -1363,7 +2187,7 @@ float fonsDrawText(FONScontext* stash,
 			continue;
 		glyph = fons__getGlyph(stash, font, codepoint, isize, iblur, FONS_GLYPH_BITMAP_REQUIRED);
 		if (glyph != NULL) {
-			fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q);
+			fons__getQuad(stash, font, prevGlyphIndex, glyph, isize, scale, state->spacing, &x, &y, &q);
 
 			if (stash->nverts+6 > FONS_VERTEX_COUNT)
 				fons__flush(stash);
@@ -1424,8 +2248,13 @@ int fonsTextIterInit(FONScontext* stash, FONStextIter* iter,
 	iter->end = end;
 	iter->codepoint = 0;
 	iter->prevGlyphIndex = -1;
+	iter->glyph = -1;
 	iter->bitmapOption = bitmapOption;
 
+	// Rasterize the missing glyphs in parallel before iterating.
+	if (bitmapOption == FONS_GLYPH_BITMAP_REQUIRED && stash->nworkers > 0)
+		fonsPrepareText(stash, str, end);
+
 	return 1;
 }
 
@@ -1448,8 +2277,9 @@ int fonsTextIterNext(FONScontext* stash, FONStextIter* iter, FONSquad* quad)
 		glyph = fons__getGlyph(stash, iter->font, iter->codepoint, iter->isize, iter->iblur, iter->bitmapOption);
 		// If the iterator was initialized with FONS_GLYPH_BITMAP_OPTIONAL, then the UV coordinates of the quad will be invalid.
 		if (glyph != NULL)
-			fons__getQuad(stash, iter->font, iter->prevGlyphIndex, glyph, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad);
+			fons__getQuad(stash, iter->font, iter->prevGlyphIndex, glyph, iter->isize, iter->scale, iter->spacing, &iter->nextx, &iter->nexty, quad);
 		iter->prevGlyphIndex = glyph != NULL ? glyph->index : -1;
+		iter->glyph = glyph != NULL ? (int)(glyph - iter->font->glyphs) : -1;
 		break;
 	}
 	iter->next = str;
@@ -1487,8 +2317,8 @@ void fonsDrawDebug(FONScontext* stash, float x, float y)
 	fons__vertex(stash, x+w, y+h, 1, 1, 0xffffffff);
 
 	// Drawbug draw atlas
-	for (i = 0; i < stash->atlas->nnodes; i++) {
-		FONSatlasNode* n = &stash->atlas->nodes[i];
+	for (i = 0; i < stash->pages[0].atlas->nnodes; i++) {
+		FONSatlasNode* n = &stash->pages[0].atlas->nodes[i];
 
 		if (stash->nverts+6 > FONS_VERTEX_COUNT)
 			fons__flush(stash);
@@ -1505,6 +2335,18 @@ void fonsDrawDebug(FONScontext* stash, float x, float y)
 	fons__flush(stash);
 }
 
+void fonsDebugBlur(FONScontext* stash, unsigned char* data, int w, int h, int stride, int blur)
+{
+	if (stash == NULL || w < 1 || h < 1) return;
+	fons__blur(stash, data, w, h, stride, fons__mini(blur, 20));
+}
+
+void fonsDebugDisableSimd(FONScontext* stash, int disable)
+{
+	if (stash == NULL) return;
+	stash->simd = disable ? 0 : 1;
+}
+
 float fonsTextBounds(FONScontext* stash,
 					 float x, float y,
 					 const char* str, const char* end,
@@ -1545,7 +2387,7 @@ float fonsTextBounds(FONScontext* stash,
 			continue;
 		glyph = fons__getGlyph(stash, font, codepoint, isize, iblur, FONS_GLYPH_BITMAP_OPTIONAL);
 		if (glyph != NULL) {
-			fons__getQuad(stash, font, prevGlyphIndex, glyph, scale, state->spacing, &x, &y, &q);
+			fons__getQuad(stash, font, prevGlyphIndex, glyph, isize, scale, state->spacing, &x, &y, &q);
 			if (q.x0 < minx) minx = q.x0;
 			if (q.x1 > maxx) maxx = q.x1;
 			if (stash->params.flags & FONS_ZERO_TOPLEFT) {
@@ -1627,26 +2469,37 @@ void fonsLineBounds(FONScontext* stash, float y, float* miny, float* maxy)
 }
 
 const unsigned char* fonsGetTextureData(FONScontext* stash, int* width, int* height)
+{
+	return fonsGetPageTextureData(stash, 0, width, height);
+}
+
+int fonsValidateTexture(FONScontext* stash, int* dirty)
+{
+	return fonsValidatePageTexture(stash, 0, dirty);
+}
+
+const unsigned char* fonsGetPageTextureData(FONScontext* stash, int page, int* width, int* height)
 {
 	if (width != NULL)
 		*width = stash->params.width;
 	if (height != NULL)
 		*height = stash->params.height;
-	return stash->texData;
+	if (page < 0 || page >= stash->npages) return NULL;
+	return stash->pages[page].texData;
 }
 
-int fonsValidateTexture(FONScontext* stash, int* dirty)
+int fonsValidatePageTexture(FONScontext* stash, int page, int* dirty)
 {
-	if (stash->dirtyRect[0] < stash->dirtyRect[2] && stash->dirtyRect[1] < stash->dirtyRect[3]) {
-		dirty[0] = stash->dirtyRect[0];
-		dirty[1] = stash->dirtyRect[1];
-		dirty[2] = stash->dirtyRect[2];
-		dirty[3] = stash->dirtyRect[3];
+	int* rect;
+	if (page < 0 || page >= stash->npages) return 0;
+	rect = stash->pages[page].dirtyRect;
+	if (rect[0] < rect[2] && rect[1] < rect[3]) {
+		dirty[0] = rect[0];
+		dirty[1] = rect[1];
+		dirty[2] = rect[2];
+		dirty[3] = rect[3];
 		// Reset dirty rect
-		stash->dirtyRect[0] = stash->params.width;
-		stash->dirtyRect[1] = stash->params.height;
-		stash->dirtyRect[2] = 0;
-		stash->dirtyRect[3] = 0;
+		fons__clearDirtyRect(stash, page);
 		return 1;
 	}
 	return 0;
@@ -1661,14 +2514,143 @@ void fonsDeleteInternal(FONScontext* stash)
 		stash->params.renderDelete(stash->params.userPtr);
 
 	for (i = 0; i < stash->nfonts; ++i)
-		fons__freeFont(stash->fonts[i]);
-
-	if (stash->atlas) fons__deleteAtlas(stash->atlas);
-	if (stash->fonts) free(stash->fonts);
-	if (stash->texData) free(stash->texData);
-	if (stash->scratch) free(stash->scratch);
+		fons__freeFont(stash, stash->fonts[i]);
+
+	for (i = 0; i < stash->npages; i++)
+		fons__freePage(stash, &stash->pages[i]);
+	if (stash->fonts) fons__memFree(&stash->params, stash->fonts);
+	if (stash->scratch.data) fons__memFree(&stash->params, stash->scratch.data);
+	if (stash->jobs) fons__memFree(&stash->params, stash->jobs);
+	if (stash->workers) fons__memFree(&stash->params, stash->workers);
 	fons__tt_done(stash);
-	free(stash);
+	fons__memFree(&stash->params, stash);
+}
+
+void fonsGetStats(FONScontext* stash, FONSstats* stats)
+{
+	if (stash == NULL)
+		memset(stats, 0, sizeof(*stats));
+	else
+		*stats = stash->stats;
+}
+
+void fonsResetStats(FONScontext* stash)
+{
+	if (stash == NULL) return;
+	memset(&stash->stats, 0, sizeof(stash->stats));
+}
+
+void fonsAdvanceFrame(FONScontext* stash)
+{
+	if (stash == NULL) return;
+	stash->frame++;
+}
+
+int fonsGetAtlasGeneration(FONScontext* stash)
+{
+	if (stash == NULL) return 0;
+	return stash->generation;
+}
+
+void fonsTouchGlyphs(FONScontext* stash, int font, const int* glyphs, int nglyphs)
+{
+	FONSfont* f;
+	int i;
+	if (stash == NULL || font < 0 || font >= stash->nfonts) return;
+	f = stash->fonts[font];
+	for (i = 0; i < nglyphs; i++) {
+		if (glyphs[i] >= 0 && glyphs[i] < f->nglyphs)
+			f->glyphs[glyphs[i]].lastUsed = stash->frame;
+	}
+}
+
+int fonsSetRasterizeWorkers(FONScontext* stash, int nworkers, FONStaskRunner runner, void* uptr)
+{
+	int i, size;
+	unsigned char* data;
+	if (stash == NULL) return 0;
+
+	if (stash->workers != NULL)
+		fons__memFree(&stash->params, stash->workers);
+	stash->workers = NULL;
+	stash->nworkers = 0;
+	stash->runner = runner;
+	stash->runnerUptr = uptr;
+	if (nworkers <= 0)
+		return 1;
+
+	// The scratch buffers are stored after the worker array, 16-byte aligned.
+	size = ((int)sizeof(FONSscratch) * nworkers + 0xf) & ~0xf;
+	stash->workers = (FONSscratch*)fons__memAlloc(&stash->params, FONS_MEMORY_GLYPHS, size + FONS_SCRATCH_BUF_SIZE * nworkers);
+	if (stash->workers == NULL) return 0;
+	data = (unsigned char*)stash->workers + size;
+	for (i = 0; i < nworkers; i++) {
+		stash->workers[i].stash = NULL;
+		stash->workers[i].data = data + FONS_SCRATCH_BUF_SIZE * i;
+		stash->workers[i].n = 0;
+	}
+	stash->nworkers = nworkers;
+	return 1;
+}
+
+int fonsPrepareText(FONScontext* stash, const char* str, const char* end)
+{
+	FONSstate* state = fons__getState(stash);
+	unsigned int codepoint;
+	unsigned int utf8state = 0;
+	FONSfont* font;
+	short isize, iblur;
+	int n;
+
+	if (stash == NULL) return 0;
+	if (state->font < 0 || state->font >= stash->nfonts) return 0;
+	font = stash->fonts[state->font];
+	if (font->data == NULL) return 0;
+
+	isize = (short)(state->size*10.0f);
+	iblur = (short)state->blur;
+
+	if (end == NULL)
+		end = str + strlen(str);
+
+	for (; str != end; ++str) {
+		if (fons__decutf8(&utf8state, &codepoint, *(const unsigned char*)str))
+			continue;
+		fons__getGlyph(stash, font, codepoint, isize, iblur, FONS__GLYPH_BITMAP_QUEUED);
+	}
+	n = stash->njobs;
+	fons__rasterizeQueued(stash);
+	return n;
+}
+
+int fonsPrepareGlyphs(FONScontext* stash, unsigned int first, unsigned int last)
+{
+	FONSstate* state = fons__getState(stash);
+	unsigned int codepoint;
+	FONSfont* font;
+	short isize, iblur;
+	int i, found;
+
+	if (stash == NULL) return 0;
+	if (state->font < 0 || state->font >= stash->nfonts) return 0;
+	font = stash->fonts[state->font];
+	if (font->data == NULL) return 0;
+
+	isize = (short)(state->size*10.0f);
+	iblur = (short)state->blur;
+	if (last > 0x10ffff) last = 0x10ffff;
+
+	for (codepoint = first; codepoint <= last; codepoint++) {
+		found = fons__tt_getGlyphIndex(&font->font, codepoint) != 0;
+		for (i = 0; i < font->nfallbacks && !found; i++)
+			found = fons__tt_getGlyphIndex(&stash->fonts[font->fallbacks[i]]->font, codepoint) != 0;
+		if (!found)
+			continue;
+		if (fons__getGlyph(stash, font, codepoint, isize, iblur, FONS__GLYPH_BITMAP_QUEUED) == NULL)
+			break;
+	}
+	fons__rasterizeQueued(stash);
+	return (int)(codepoint - first);
 }
 
 void fonsSetErrorCallback(FONScontext* stash, void (*callback)(void* uptr, int error, int val), void* uptr)
@@ -1685,10 +2667,22 @@ void fonsGetAtlasSize(FONScontext* stash, int* width, int* height)
 	*height = stash->params.height;
 }
 
+int fonsAddAtlasPage(FONScontext* stash)
+{
+	if (stash == NULL) return -1;
+	return fons__allocPage(stash);
+}
+
+int fonsGetAtlasPageCount(FONScontext* stash)
+{
+	if (stash == NULL) return 0;
+	return stash->npages;
+}
+
 int fonsExpandAtlas(FONScontext* stash, int width, int height)
 {
-	int i, maxy = 0;
-	unsigned char* data = NULL;
+	int i, j, maxy;
+	unsigned char* data[FONS_MAX_PAGES];
 	if (stash == NULL) return 0;
 
 	width = fons__maxi(width, stash->params.width);
@@ -1705,45 +2699,58 @@ int fonsExpandAtlas(FONScontext* stash, int width, int height)
 		if (stash->params.renderResize(stash->params.userPtr, width, height) == 0)
 			return 0;
 	}
-	// Copy old texture data over.
-	data = (unsigned char*)malloc(width * height);
-	if (data == NULL)
-		return 0;
-	for (i = 0; i < stash->params.height; i++) {
-		unsigned char* dst = &data[i*width];
-		unsigned char* src = &stash->texData[i*stash->params.width];
-		memcpy(dst, src, stash->params.width);
-		if (width > stash->params.width)
-			memset(dst+stash->params.width, 0, width - stash->params.width);
-	}
-	if (height > stash->params.height)
-		memset(&data[stash->params.height * width], 0, (height - stash->params.height) * width);
-
-	free(stash->texData);
-	stash->texData = data;
-
-	// Increase atlas size
-	fons__atlasExpand(stash->atlas, width, height);
-
-	// Add existing data as dirty.
-	for (i = 0; i < stash->atlas->nnodes; i++)
-		maxy = fons__maxi(maxy, stash->atlas->nodes[i].y);
-	stash->dirtyRect[0] = 0;
-	stash->dirtyRect[1] = 0;
-	stash->dirtyRect[2] = stash->params.width;
-	stash->dirtyRect[3] = maxy;
+	for (j = 0; j < stash->npages; j++) {
+		data[j] = (unsigned char*)fons__memAlloc(&stash->params, FONS_MEMORY_ATLAS, width * height);
+		if (data[j] == NULL) {
+			while (j-- > 0)
+				fons__memFree(&stash->params, data[j]);
+			return 0;
+		}
+	}
+
+	for (j = 0; j < stash->npages; j++) {
+		FONSpage* page = &stash->pages[j];
+
+		// Copy old texture data over.
+		for (i = 0; i < stash->params.height; i++) {
+			unsigned char* dst = &data[j][i*width];
+			unsigned char* src = &page->texData[i*stash->params.width];
+			memcpy(dst, src, stash->params.width);
+			if (width > stash->params.width)
+				memset(dst+stash->params.width, 0, width - stash->params.width);
+		}
+		if (height > stash->params.height)
+			memset(&data[j][stash->params.height * width], 0, (height - stash->params.height) * width);
+
+		fons__memFree(&stash->params, page->texData);
+		page->texData = data[j];
+
+		// Increase atlas size
+		fons__atlasExpand(page->atlas, width, height);
+
+		// Add existing data as dirty.
+		maxy = 0;
+		for (i = 0; i < page->atlas->nnodes; i++)
+			maxy = fons__maxi(maxy, page->atlas->nodes[i].y);
+		page->dirtyRect[0] = 0;
+		page->dirtyRect[1] = 0;
+		page->dirtyRect[2] = stash->params.width;
+		page->dirtyRect[3] = maxy;
+	}
 
 	stash->params.width = width;
 	stash->params.height = height;
 	stash->itw = 1.0f/stash->params.width;
 	stash->ith = 1.0f/stash->params.height;
+	stash->generation++;
 
 	return 1;
 }
 
 int fonsResetAtlas(FONScontext* stash, int width, int height)
 {
-	int i, j;
+	int i;
+	unsigned char* data;
 	if (stash == NULL) return 0;
 
 	// Flush pending glyphs.
@@ -1755,32 +2762,36 @@ int fonsResetAtlas(FONScontext* stash, int width, int height)
 			return 0;
 	}
 
+	// Keep only the first page.
+	for (i = 1; i < stash->npages; i++)
+		fons__freePage(stash, &stash->pages[i]);
+	stash->npages = 1;
+
 	// Reset atlas
-	fons__atlasReset(stash->atlas, width, height);
+	fons__atlasReset(stash->pages[0].atlas, width, height);
 
 	// Clear texture data.
-	stash->texData = (unsigned char*)realloc(stash->texData, width * height);
-	if (stash->texData == NULL) return 0;
-	memset(stash->texData, 0, width * height);
-
-	// Reset dirty rect
-	stash->dirtyRect[0] = width;
-	stash->dirtyRect[1] = height;
-	stash->dirtyRect[2] = 0;
-	stash->dirtyRect[3] = 0;
+	data = (unsigned char*)fons__memRealloc(&stash->params, FONS_MEMORY_ATLAS, stash->pages[0].texData, width * height);
+	if (data == NULL) return 0;
+	stash->pages[0].texData = data;
+	memset(data, 0, width * height);
 
-	// Reset cached glyphs
+	// Reset cached glyphs, including the ones waiting for the workers.
+	stash->njobs = 0;
 	for (i = 0; i < stash->nfonts; i++) {
 		FONSfont* font = stash->fonts[i];
 		font->nglyphs = 0;
-		for (j = 0; j < FONS_HASH_LUT_SIZE; j++)
-			font->lut[j] = -1;
+		fons__clearGlyphLut(font);
 	}
 
 	stash->params.width = width;
 	stash->params.height = height;
 	stash->itw = 1.0f/stash->params.width;
 	stash->ith = 1.0f/stash->params.height;
+	stash->generation++;
+
+	// Reset dirty rect
+	fons__clearDirtyRect(stash, 0);
 
 	// Add white rect at 0,0 for debug drawing.
 	fons__addWhiteRect(stash, 2,2);
@@ -1789,4 +2800,478 @@ int fonsResetAtlas(FONScontext* stash, int width, int height)
 }
 
 
+
+// Atlas snapshot. All values are stored little-endian, the blob ends with a hash of the preceding bytes.
+
+#define FONS__SNAPSHOT_MAGIC 0x534e4f46 // "FONS"
+#define FONS__SNAPSHOT_VERSION 1
+#define FONS__SNAPSHOT_HEADER_SIZE (11*4)
+#define FONS__SNAPSHOT_NODE_SIZE 6
+#define FONS__SNAPSHOT_RECT_SIZE 8
+#define FONS__SNAPSHOT_FALLBACK_SIZE 8
+#define FONS__SNAPSHOT_GLYPH_SIZE 28
+#ifdef FONS_USE_FREETYPE
+#define FONS__SNAPSHOT_RASTERIZER 1
+#else
+#define FONS__SNAPSHOT_RASTERIZER 0
+#endif
+
+struct FONSsnapshotIO
+{
+	unsigned char* dst;		// NULL when counting the size.
+	const unsigned char* src;
+	int size;
+	int pos;
+	int ok;
+};
+typedef struct FONSsnapshotIO FONSsnapshotIO;
+
+static unsigned int fons__hashBytes(unsigned int h, const unsigned char* data, int size)
+{
+	// FNV-1a
+	int i;
+	for (i = 0; i < size; i++) {
+		h ^= data[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static unsigned int fons__fontHash(FONSfont* font)
+{
+	return fons__hashBytes(2166136261u, font->data, font->dataSize);
+}
+
+static void fons__writeBytes(FONSsnapshotIO* io, const unsigned char* data, int n)
+{
+	if (io->dst != NULL && io->pos + n <= io->size)
+		memcpy(io->dst + io->pos, data, n);
+	else if (io->dst != NULL)
+		io->ok = 0;
+	io->pos += n;
+}
+
+static void fons__writeU32(FONSsnapshotIO* io, unsigned int v)
+{
+	unsigned char b[4];
+	b[0] = (unsigned char)v; b[1] = (unsigned char)(v >> 8);
+	b[2] = (unsigned char)(v >> 16); b[3] = (unsigned char)(v >> 24);
+	fons__writeBytes(io, b, 4);
+}
+
+static void fons__writeI16(FONSsnapshotIO* io, int v)
+{
+	unsigned char b[2];
+	b[0] = (unsigned char)v; b[1] = (unsigned char)(v >> 8);
+	fons__writeBytes(io, b, 2);
+}
+
+static const unsigned char* fons__readBytes(FONSsnapshotIO* io, int n)
+{
+	const unsigned char* p = io->src + io->pos;
+	if (n < 0 || n > io->size - io->pos) {
+		io->ok = 0;
+		io->pos = io->size;
+		return NULL;
+	}
+	io->pos += n;
+	return p;
+}
+
+static unsigned int fons__readU32(FONSsnapshotIO* io)
+{
+	const unsigned char* b = fons__readBytes(io, 4);
+	if (b == NULL) return 0;
+	return (unsigned int)b[0] | ((unsigned int)b[1] << 8) | ((unsigned int)b[2] << 16) | ((unsigned int)b[3] << 24);
+}
+
+static short fons__readI16(FONSsnapshotIO* io)
+{
+	const unsigned char* b = fons__readBytes(io, 2);
+	if (b == NULL) return 0;
+	return (short)(b[0] | (b[1] << 8));
+}
+
+// Settings which change how the glyphs are rasterized.
+static void fons__writeSnapshotConfig(FONScontext* stash, FONSsnapshotIO* io)
+{
+	fons__writeU32(io, FONS__SNAPSHOT_MAGIC);
+	fons__writeU32(io, FONS__SNAPSHOT_VERSION);
+	fons__writeU32(io, FONS__SNAPSHOT_RASTERIZER);
+	fons__writeU32(io, stash->params.flags & FONS_SDF);
+	fons__writeU32(io, FONS_SDF_PADDING);
+	fons__writeU32(io, FONS_SDF_MIN_SIZE);
+	fons__writeU32(io, FONS_SDF_MAX_SIZE);
+}
+
+static void fons__writeGlyph(FONSsnapshotIO* io, FONSglyph* glyph)
+{
+	fons__writeU32(io, glyph->codepoint);
+	fons__writeU32(io, (unsigned int)glyph->index);
+	fons__writeI16(io, glyph->size);
+	fons__writeI16(io, glyph->blur);
+	fons__writeI16(io, glyph->x0);
+	fons__writeI16(io, glyph->y0);
+	fons__writeI16(io, glyph->x1);
+	fons__writeI16(io, glyph->y1);
+	fons__writeI16(io, glyph->xadv);
+	fons__writeI16(io, glyph->xoff);
+	fons__writeI16(io, glyph->yoff);
+	fons__writeI16(io, glyph->page);
+}
+
+static void fons__readGlyph(FONSsnapshotIO* io, FONSglyph* glyph)
+{
+	glyph->codepoint = fons__readU32(io);
+	glyph->index = (int)fons__readU32(io);
+	glyph->size = fons__readI16(io);
+	glyph->blur = fons__readI16(io);
+	glyph->x0 = fons__readI16(io);
+	glyph->y0 = fons__readI16(io);
+	glyph->x1 = fons__readI16(io);
+	glyph->y1 = fons__readI16(io);
+	glyph->xadv = fons__readI16(io);
+	glyph->xoff = fons__readI16(io);
+	glyph->yoff = fons__readI16(io);
+	glyph->page = fons__readI16(io);
+}
+
+static int fons__snapshotRows(FONSatlas* atlas)
+{
+	// Everything above the skyline is empty.
+	int i, rows = 0;
+	for (i = 0; i < atlas->nnodes; i++)
+		rows = fons__maxi(rows, atlas->nodes[i].y);
+	return rows;
+}
+
+int fonsSaveSnapshot(FONScontext* stash, unsigned char* data, int size)
+{
+	FONSsnapshotIO io;
+	int i, j, rows;
+
+	if (stash == NULL) return 0;
+	memset(&io, 0, sizeof(io));
+	io.dst = data;
+	io.size = size;
+	io.ok = 1;
+
+	fons__writeSnapshotConfig(stash, &io);
+	fons__writeU32(&io, (unsigned int)stash->params.width);
+	fons__writeU32(&io, (unsigned int)stash->params.height);
+	fons__writeU32(&io, (unsigned int)stash->npages);
+	fons__writeU32(&io, (unsigned int)stash->nfonts);
+
+	for (i = 0; i < stash->npages; i++) {
+		FONSatlas* atlas = stash->pages[i].atlas;
+		rows = fons__snapshotRows(atlas);
+		fons__writeU32(&io, (unsigned int)atlas->nnodes);
+		fons__writeU32(&io, (unsigned int)atlas->nrects);
+		fons__writeU32(&io, (unsigned int)rows);
+		for (j = 0; j < atlas->nnodes; j++) {
+			fons__writeI16(&io, atlas->nodes[j].x);
+			fons__writeI16(&io, atlas->nodes[j].y);
+			fons__writeI16(&io, atlas->nodes[j].width);
+		}
+		for (j = 0; j < atlas->nrects; j++) {
+			fons__writeI16(&io, atlas->rects[j].x);
+			fons__writeI16(&io, atlas->rects[j].y);
+			fons__writeI16(&io, atlas->rects[j].width);
+			fons__writeI16(&io, atlas->rects[j].height);
+		}
+		fons__writeBytes(&io, stash->pages[i].texData, rows * stash->params.width);
+	}
+
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* font = stash->fonts[i];
+		// Hashing only when writing, the size does not depend on it.
+		fons__writeU32(&io, data != NULL ? fons__fontHash(font) : 0);
+		fons__writeU32(&io, (unsigned int)font->dataSize);
+		fons__writeU32(&io, (unsigned int)font->faceIndex);
+		fons__writeU32(&io, (unsigned int)font->nfallbacks);
+		for (j = 0; j < font->nfallbacks; j++) {
+			FONSfont* fallback = stash->fonts[font->fallbacks[j]];
+			fons__writeU32(&io, data != NULL ? fons__fontHash(fallback) : 0);
+			fons__writeU32(&io, (unsigned int)fallback->faceIndex);
+		}
+		fons__writeU32(&io, (unsigned int)font->nglyphs);
+		for (j = 0; j < font->nglyphs; j++)
+			fons__writeGlyph(&io, &font->glyphs[j]);
+	}
+
+	if (data != NULL && io.ok)
+		fons__writeU32(&io, fons__hashBytes(2166136261u, data, io.pos));
+	else
+		fons__writeU32(&io, 0);
+
+	return io.ok ? io.pos : 0;
+}
+
+static int fons__validNode(int x, int y, int w, int h, int width, int height)
+{
+	return x >= 0 && y >= 0 && w >= 0 && h >= 0 && x + w <= width && y + h <= height;
+}
+
+// Reads through the whole snapshot checking that it can be restored safely. The header is returned in
+// info: width, height, npages and nfonts.
+static int fons__checkSnapshot(FONScontext* stash, const unsigned char* data, int size, int* info)
+{
+	FONSsnapshotIO io, config;
+	unsigned char header[7*4];	// Config part of the header.
+	int i, j, width, height, npages, nfonts, nnodes, nrects, rows, x;
+	FONSglyph glyph;
+
+	if (data == NULL || size < FONS__SNAPSHOT_HEADER_SIZE + 4)
+		return 0;
+	if (fons__hashBytes(2166136261u, data, size - 4) != (data[size-4] | (data[size-3] << 8) | (data[size-2] << 16) | ((unsigned int)data[size-1] << 24)))
+		return 0;
+
+	memset(&config, 0, sizeof(config));
+	config.dst = header;
+	config.size = sizeof(header);
+	config.ok = 1;
+	fons__writeSnapshotConfig(stash, &config);
+	if (memcmp(data, header, sizeof(header)) != 0)
+		return 0;
+
+	memset(&io, 0, sizeof(io));
+	io.src = data;
+	io.size = size - 4;
+	io.pos = sizeof(header);
+	io.ok = 1;
+
+	width = (int)fons__readU32(&io);
+	height = (int)fons__readU32(&io);
+	npages = (int)fons__readU32(&io);
+	nfonts = (int)fons__readU32(&io);
+	if (width <= 0 || height <= 0 || width > 0x7fff || height > 0x7fff)
+		return 0;
+	if (npages < 1 || npages > FONS_MAX_PAGES || nfonts < 0)
+		return 0;
+
+	for (i = 0; i < npages && io.ok; i++) {
+		nnodes = (int)fons__readU32(&io);
+		nrects = (int)fons__readU32(&io);
+		rows = (int)fons__readU32(&io);
+		if (nnodes < 1 || nnodes > width || nrects < 0 || rows < 0 || rows > height)
+			return 0;
+		// The skyline must cover the width of the atlas from left to right.
+		for (j = 0, x = 0; j < nnodes && io.ok; j++) {
+			int nx = fons__readI16(&io), ny = fons__readI16(&io), nw = fons__readI16(&io);
+			if (nx != x || !fons__validNode(nx, ny, nw, 0, width, height))
+				return 0;
+			x += nw;
+		}
+		if (x != width)
+			return 0;
+		for (j = 0; j < nrects && io.ok; j++) {
+			int rx = fons__readI16(&io), ry = fons__readI16(&io), rw = fons__readI16(&io), rh = fons__readI16(&io);
+			if (!fons__validNode(rx, ry, rw, rh, width, height))
+				return 0;
+		}
+		fons__readBytes(&io, rows * width);
+	}
+
+	for (i = 0; i < nfonts && io.ok; i++) {
+		int nfallbacks, nglyphs;
+		fons__readU32(&io);
+		fons__readU32(&io);
+		fons__readU32(&io);
+		nfallbacks = (int)fons__readU32(&io);
+		if (nfallbacks < 0 || nfallbacks > FONS_MAX_FALLBACKS)
+			return 0;
+		fons__readBytes(&io, nfallbacks * FONS__SNAPSHOT_FALLBACK_SIZE);
+		nglyphs = (int)fons__readU32(&io);
+		if (nglyphs < 0)
+			return 0;
+		for (j = 0; j < nglyphs && io.ok; j++) {
+			fons__readGlyph(&io, &glyph);
+			if (glyph.page < 0 || glyph.page >= npages)
+				return 0;
+			// Evicted glyphs have no bitmap.
+			if (glyph.x0 == -1 && glyph.y0 == -1)
+				continue;
+			if (!fons__validNode(glyph.x0, glyph.y0, glyph.x1 - glyph.x0, glyph.y1 - glyph.y0, width, height))
+				return 0;
+		}
+	}
+	if (!io.ok || io.pos != io.size)
+		return 0;
+
+	info[0] = width;
+	info[1] = height;
+	info[2] = npages;
+	info[3] = nfonts;
+	return 1;
+}
+
+int fonsGetSnapshotInfo(FONScontext* stash, const unsigned char* data, int size, int* width, int* height, int* npages)
+{
+	int info[4];
+	if (stash == NULL || !fons__checkSnapshot(stash, data, size, info))
+		return 0;
+	if (width != NULL) *width = info[0];
+	if (height != NULL) *height = info[1];
+	if (npages != NULL) *npages = info[2];
+	return 1;
+}
+
+// Returns the loaded font matching the snapshot font, or -1.
+static int fons__matchSnapshotFont(FONScontext* stash, FONSsnapshotIO* io, const unsigned int* hashes, const int* matches, int nmatches)
+{
+	unsigned int hash = fons__readU32(io), dataSize = fons__readU32(io), faceIndex = fons__readU32(io);
+	int nfallbacks = (int)fons__readU32(io);
+	unsigned int fallbacks[FONS_MAX_FALLBACKS*2];
+	int i, j;
+
+	for (i = 0; i < nfallbacks*2; i++)
+		fallbacks[i] = fons__readU32(io);
+
+	for (i = 0; i < stash->nfonts; i++) {
+		FONSfont* font = stash->fonts[i];
+		if (hashes[i] != hash || (unsigned int)font->dataSize != dataSize || (unsigned int)font->faceIndex != faceIndex)
+			continue;
+		// The fallback fonts must match too, a glyph may come from any of them.
+		if (font->nfallbacks != nfallbacks)
+			continue;
+		for (j = 0; j < nfallbacks; j++) {
+			FONSfont* fallback = stash->fonts[font->fallbacks[j]];
+			if (hashes[font->fallbacks[j]] != fallbacks[j*2] || (unsigned int)fallback->faceIndex != fallbacks[j*2+1])
+				break;
+		}
+		if (j < nfallbacks)
+			continue;
+		// Each loaded font is restored once.
+		for (j = 0; j < nmatches; j++) {
+			if (matches[j] == i)
+				break;
+		}
+		if (j == nmatches)
+			return i;
+	}
+	return -1;
+}
+
+int fonsLoadSnapshot(FONScontext* stash, const unsigned char* data, int size)
+{
+	FONSsnapshotIO io;
+	FONSglyph glyph;
+	unsigned int* hashes = NULL;
+	int* matches = NULL;
+	int info[4], i, j, nglyphs, nmatched = 0, nrestored = 0, pos;
+
+	if (stash == NULL || !fons__checkSnapshot(stash, data, size, info))
+		return -1;
+
+	memset(&io, 0, sizeof(io));
+	io.src = data;
+	io.size = size - 4;
+	io.pos = FONS__SNAPSHOT_HEADER_SIZE;
+	io.ok = 1;
+
+	// Skip the pages to find out which fonts can be restored.
+	for (i = 0; i < info[2]; i++) {
+		int nnodes = (int)fons__readU32(&io), nrects = (int)fons__readU32(&io), rows = (int)fons__readU32(&io);
+		fons__readBytes(&io, nnodes*FONS__SNAPSHOT_NODE_SIZE + nrects*FONS__SNAPSHOT_RECT_SIZE + rows*info[0]);
+	}
+	pos = io.pos;
+
+	hashes = (unsigned int*)fons__memAlloc(&stash->params, FONS_MEMORY_GLYPHS, sizeof(unsigned int) * (stash->nfonts + 1));
+	matches = (int*)fons__memAlloc(&stash->params, FONS_MEMORY_GLYPHS, sizeof(int) * (info[3] + 1));
+	if (hashes == NULL || matches == NULL) goto error;
+	for (i = 0; i < stash->nfonts; i++)
+		hashes[i] = fons__fontHash(stash->fonts[i]);
+	for (i = 0; i < info[3]; i++) {
+		matches[i] = fons__matchSnapshotFont(stash, &io, hashes, matches, i);
+		if (matches[i] != -1)
+			nmatched++;
+		nglyphs = (int)fons__readU32(&io);
+		fons__readBytes(&io, nglyphs * FONS__SNAPSHOT_GLYPH_SIZE);
+	}
+	if (nmatched == 0) {
+		fons__memFree(&stash->params, hashes);
+		fons__memFree(&stash->params, matches);
+		return 0;
+	}
+
+	// Replace the atlas pages.
+	if (!fonsResetAtlas(stash, info[0], info[1])) goto error;
+	io.pos = FONS__SNAPSHOT_HEADER_SIZE;
+	for (i = 0; i < info[2]; i++) {
+		FONSpage* page;
+		FONSatlas* atlas;
+		int nnodes = (int)fons__readU32(&io), nrects = (int)fons__readU32(&io), rows = (int)fons__readU32(&io);
+		if (i > 0 && fons__allocPage(stash) != i) goto error;
+		page = &stash->pages[i];
+		atlas = page->atlas;
+		if (nnodes > atlas->cnodes) {
+			FONSatlasNode* nodes = (FONSatlasNode*)fons__memRealloc(&stash->params, FONS_MEMORY_ATLAS, atlas->nodes, sizeof(FONSatlasNode) * nnodes);
+			if (nodes == NULL) goto error;
+			atlas->nodes = nodes;
+			atlas->cnodes = nnodes;
+		}
+		if (nrects > atlas->crects) {
+			FONSatlasRect* rects = (FONSatlasRect*)fons__memRealloc(&stash->params, FONS_MEMORY_ATLAS, atlas->rects, sizeof(FONSatlasRect) * nrects);
+			if (rects == NULL) goto error;
+			atlas->rects = rects;
+			atlas->crects = nrects;
+		}
+		for (j = 0; j < nnodes; j++) {
+			atlas->nodes[j].x = fons__readI16(&io);
+			atlas->nodes[j].y = fons__readI16(&io);
+			atlas->nodes[j].width = fons__readI16(&io);
+		}
+		atlas->nnodes = nnodes;
+		for (j = 0; j < nrects; j++) {
+			atlas->rects[j].x = fons__readI16(&io);
+			atlas->rects[j].y = fons__readI16(&io);
+			atlas->rects[j].width = fons__readI16(&io);
+			atlas->rects[j].height = fons__readI16(&io);
+		}
+		atlas->nrects = nrects;
+		memcpy(page->texData, fons__readBytes(&io, rows * info[0]), rows * info[0]);
+		fons__clearDirtyRect(stash, i);
+		fons__addDirtyRect(stash, i, 0, 0, info[0], info[1]);
+	}
+
+	// Restore the glyphs of the matching fonts, the space of the rest is freed.
+	io.pos = pos;
+	for (i = 0; i < info[3]; i++) {
+		FONSfont* font = matches[i] != -1 ? stash->fonts[matches[i]] : NULL;
+		int nfallbacks;
+		fons__readBytes(&io, 3*4);
+		nfallbacks = (int)fons__readU32(&io);
+		fons__readBytes(&io, nfallbacks * FONS__SNAPSHOT_FALLBACK_SIZE);
+		nglyphs = (int)fons__readU32(&io);
+		for (j = 0; j < nglyphs; j++) {
+			FONSglyph* dst = NULL;
+			fons__readGlyph(&io, &glyph);
+			if (font != NULL) {
+				dst = fons__allocGlyph(stash, font);
+				if (dst != NULL) {
+					*dst = glyph;
+					dst->lastUsed = stash->frame;
+					if (fons__addGlyphLut(stash, font)) {
+						nrestored++;
+						continue;
+					}
+					font->nglyphs--;
+				}
+			}
+			if (glyph.x0 == -1 && glyph.y0 == -1)
+				continue;
+			fons__atlasFreeRect(stash->pages[glyph.page].atlas, glyph.x0, glyph.y0, glyph.x1 - glyph.x0, glyph.y1 - glyph.y0, 0, 0);
+		}
+	}
+
+	fons__memFree(&stash->params, hashes);
+	fons__memFree(&stash->params, matches);
+	return nrestored;
+
+error:
+	if (hashes != NULL) fons__memFree(&stash->params, hashes);
+	if (matches != NULL) fons__memFree(&stash->params, matches);
+	return -1;
+}
+
 #endif
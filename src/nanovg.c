@@ -22,15 +22,53 @@
 #include <memory.h>
 
 #include "nanovg.h"
+#if defined(NVG_NO_SIMD) && !defined(FONS_NO_SIMD)
+#define FONS_NO_SIMD
+#endif
 #define FONTSTASH_IMPLEMENTATION
 #include "fontstash.h"
 
 #ifndef NVG_NO_STB
+#if defined(_MSC_VER)
+#define NVG_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__) || defined(__clang__)
+#define NVG_THREAD_LOCAL __thread
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+#define NVG_THREAD_LOCAL _Thread_local
+#else
+#define NVG_THREAD_LOCAL	// Images must not be loaded concurrently.
+#endif
+// Allocator of the context loading an image, stb_image does not pass user pointer to the allocation functions.
+// Set only for the duration of the load, per thread so that contexts on different threads do not race.
+static NVG_THREAD_LOCAL NVGallocator* nvg__imageAllocator = NULL;
+#define STBI_MALLOC(sz)			nvgInternalAlloc(nvg__imageAllocator, NVG_MEMORY_TEXTURES, (int)(sz))
+#define STBI_REALLOC(p,newsz)	nvgInternalRealloc(nvg__imageAllocator, NVG_MEMORY_TEXTURES, p, (int)(newsz))
+#define STBI_FREE(p)			nvgInternalFree(p)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #endif
 
+#ifndef NVG_NO_FRAME_TIMING
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#endif
+
+#if !defined(NVG_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define NVG_SSE2 1
+#include <emmintrin.h>
+#endif
+
 #ifdef _MSC_VER
+#include <intrin.h>
 #pragma warning(disable: 4100)  // unreferenced formal parameter
 #pragma warning(disable: 4127)  // conditional expression is constant
 #pragma warning(disable: 4204)  // nonstandard extension used : non-constant aggregate initializer
@@ -39,18 +77,36 @@
 
 #define NVG_INIT_FONTIMAGE_SIZE  512
 #define NVG_MAX_FONTIMAGE_SIZE   2048
+// Maximum number of font atlas pages, glyphs are evicted when all pages are full.
+#ifndef NVG_MAX_FONTIMAGES
 #define NVG_MAX_FONTIMAGES       4
+#endif
 
 #define NVG_INIT_COMMANDS_SIZE 256
 #define NVG_INIT_POINTS_SIZE 128
 #define NVG_INIT_PATHS_SIZE 16
 #define NVG_INIT_VERTS_SIZE 256
+#define NVG_INIT_ARENA_SIZE (64*1024)
+#define NVG_ARENA_ALIGN 16
+#define NVG_MEM_ALIGN 16
 
 #ifndef NVG_MAX_STATES
 #define NVG_MAX_STATES 32
 #endif
 
-#define NVG_KAPPA90 0.5522847493f	// Length proportional to radius of a cubic bezier handle for 90deg arcs.
+// Relative scale change allowed before cached path object geometry is tessellated again.
+#ifndef NVG_PATHOBJECT_SCALE_TOL
+#define NVG_PATHOBJECT_SCALE_TOL 0.1f
+#endif
+
+// Maximum number of fill vertices triangulated on the CPU, the ear clipping state is kept on the stack.
+#ifndef NVG_MAX_TRIANGULATION
+#define NVG_MAX_TRIANGULATION 256
+#endif
+
+// Maximum number of segments a bezier curve is flattened into, same as the recursion depth limit.
+#define NVG_MAX_BEZIER_SEGMENTS 1024
+
 
 #define NVG_COUNTOF(arr) (sizeof(arr) / sizeof(0[arr]))
 
@@ -61,6 +117,8 @@ enum NVGcommands {
 	NVG_BEZIERTO = 2,
 	NVG_CLOSE = 3,
 	NVG_WINDING = 4,
+	NVG_QUADTO = 5,		// cx,cy, x,y
+	NVG_ARCTO = 6,		// cx,cy, ux,uy, vx,vy, a0, da, x,y: point at angle a is c + u*cos(a) + v*sin(a).
 };
 
 enum NVGpointFlags
@@ -92,6 +150,7 @@ struct NVGstate {
 };
 typedef struct NVGstate NVGstate;
 
+// Note: the SIMD code loads x,y,dx,dy and len,dmx,dmy,flags as two 4-float vectors.
 struct NVGpoint {
 	float x,y;
 	float dx, dy;
@@ -115,26 +174,190 @@ struct NVGpathCache {
 };
 typedef struct NVGpathCache NVGpathCache;
 
+struct NVGpathStyle {
+	float strokeWidth;
+	float fringeWidth;
+	float miterLimit;
+	int lineCap;
+	int lineJoin;
+	int antiAlias;
+};
+typedef struct NVGpathStyle NVGpathStyle;
+
+struct NVGpathMesh {
+	NVGpathStyle style;		// Style the geometry was expanded with.
+	float xform[6];			// Transform the geometry was tessellated with.
+	float bounds[4];
+	NVGpath* paths;			// 2*npaths, the second half is used when replaying transformed.
+	int npaths;
+	NVGvertex* verts;
+	int nverts;
+	int valid;
+};
+typedef struct NVGpathMesh NVGpathMesh;
+
+struct NVGpathObject {
+	float* commands;		// Commands relative to the transform at creation.
+	float* tcommands;		// Scratch for transformed commands.
+	int ncommands;
+	NVGpathMesh fill;
+	NVGpathMesh stroke;
+};
+
+enum NVGdeferredType {
+	NVG_DEFER_FILL = 0,
+	NVG_DEFER_STROKE = 1,
+	NVG_DEFER_TRIANGLES = 2,
+};
+
+struct NVGdeferredCall {
+	int type;
+	NVGpaint paint;
+	NVGcompositeOperationState compositeOperation;
+	NVGscissor scissor;
+	float fringeWidth;
+	float fringe;			// Fringe used for expansion, 0 when not antialiased.
+	float strokeWidth;
+	float miterLimit;
+	int lineJoin;
+	int lineCap;
+	int commandOffset;
+	int ncommands;
+	int worker;				// Worker holding the tessellated geometry.
+	int pathOffset;
+	int npaths;
+	int vertOffset;			// Into worker verts, or deferred verts for triangles.
+	int nverts;
+	float bounds[4];
+};
+typedef struct NVGdeferredCall NVGdeferredCall;
+
+struct NVGworker {
+	NVGcontext* ctx;		// Context used for flattening and expanding, only the path cache is allocated.
+	NVGpath* paths;
+	int npaths;
+	int cpaths;
+	NVGvertex* verts;
+	int nverts;
+	int cverts;
+};
+typedef struct NVGworker NVGworker;
+
+struct NVGdeferred {
+	NVGtaskRunner runner;
+	void* userPtr;
+	NVGworker* workers;
+	int nworkers;
+	int ntasks;
+	NVGdeferredCall* calls;
+	int ncalls;
+	int ccalls;
+	float* commands;
+	int ncommands;
+	int ccommands;
+	NVGvertex* verts;
+	int nverts;
+	int cverts;
+};
+typedef struct NVGdeferred NVGdeferred;
+
+enum NVGtextLayoutKind {
+	NVG_LAYOUT_QUADS,		// nvgText()
+	NVG_LAYOUT_BOUNDS,		// nvgTextBounds()
+};
+
+// Laid out string. The coordinates are in font atlas scale relative to the whole pixel part
+// of the start position, text drawn at the same sub-pixel offset can reuse them.
+struct NVGtextLayout {
+	unsigned int hash;
+	int next;				// Next entry in the same bucket, -1 at the end.
+	int kind;
+	int font, align;
+	float size, spacing, blur;
+	float fx, fy;			// Sub-pixel part of the start position.
+	int generation;			// Font atlas generation the quads were created with.
+	int lastUsed;
+	char* str;				// Allocated with the quads.
+	int len;
+	FONSquad* quads;
+	int* glyphs;			// Font glyph slot of each quad, the glyphs are kept in the atlas while drawn.
+	int nquads;
+	float advance;
+	float bounds[4];
+};
+typedef struct NVGtextLayout NVGtextLayout;
+
+struct NVGtextCache {
+	NVGtextLayout* layouts;
+	int nlayouts;
+	int clayouts;
+	int* buckets;			// Power of two, at least twice the number of layouts.
+	int nbuckets;
+	int maxFrames;
+	int frame;
+};
+typedef struct NVGtextCache NVGtextCache;
+
+struct NVGarenaBlock {
+	struct NVGarenaBlock* next;
+	int size;
+};
+typedef struct NVGarenaBlock NVGarenaBlock;
+
+// Size of the block header, keeps the data aligned.
+#define NVG_ARENA_HEADER_SIZE ((int)((sizeof(NVGarenaBlock) + NVG_ARENA_ALIGN-1) & ~(NVG_ARENA_ALIGN-1)))
+
+struct NVGmemHeader {
+	NVGallocator* allocator;	// NULL if allocated with malloc.
+	int size;
+	int category;
+};
+typedef struct NVGmemHeader NVGmemHeader;
+
+// Size of the allocation header, keeps the data aligned.
+#define NVG_MEM_HEADER_SIZE ((int)((sizeof(NVGmemHeader) + NVG_MEM_ALIGN-1) & ~(NVG_MEM_ALIGN-1)))
+
+struct NVGarena {
+	NVGallocator* allocator;
+	NVGarenaBlock* blocks;	// Current block first.
+	int used;				// Bytes used from the current block.
+	int frameUsed;			// Bytes allocated since the last reset.
+	int highWater;
+	int reserved;
+};
+typedef struct NVGarena NVGarena;
+
 struct NVGcontext {
 	NVGparams params;
 	float* commands;
 	int ccommands;
 	int ncommands;
+	float* keptCommands;	// Holds the current path over the frame memory reset, keeps its capacity.
+	int ckeptCommands;
 	float commandx, commandy;
 	NVGstate states[NVG_MAX_STATES];
 	int nstates;
 	NVGpathCache* cache;
 	float tessTol;
 	float distTol;
+	int flattening;
+	int simd;			// Use the SIMD kernels when compiled in, see nvgDebugDisableSimd().
+	int triangulation;	// Max points of a concave fill triangulated on the CPU, 0 disables.
 	float fringeWidth;
 	float devicePxRatio;
 	struct FONScontext* fs;
-	int fontImages[NVG_MAX_FONTIMAGES];
-	int fontImageIdx;
+	int fontImages[NVG_MAX_FONTIMAGES];		// Texture of each font atlas page.
+	int retiredFontImages[NVG_MAX_FONTIMAGES];	// Replaced by a larger texture, deleted at the end of frame.
+	int nretiredFontImages;
 	int drawCallCount;
 	int fillTriCount;
 	int strokeTriCount;
 	int textTriCount;
+	NVGdeferred* deferred;
+	NVGtextCache* textCache;
+	NVGarena* arena;
+	NVGallocator defaultAllocator;
+	NVGframeStats stats;	// Draw and triangle counts are kept in the fields above.
 };
 
 static float nvg__sqrtf(float a) { return sqrtf(a); }
@@ -155,6 +378,31 @@ static float nvg__signf(float a) { return a >= 0.0f ? 1.0f : -1.0f; }
 static float nvg__clampf(float a, float mn, float mx) { return a < mn ? mn : (a > mx ? mx : a); }
 static float nvg__cross(float dx0, float dy0, float dx1, float dy1) { return dx1*dy0 - dx0*dy1; }
 
+// Monotonic clock in nanoseconds for the frame statistics.
+static long long nvg__timeNs(void)
+{
+#if defined(NVG_NO_FRAME_TIMING)
+	return 0;
+#elif defined(_WIN32)
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER t;
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t);
+	return (t.QuadPart / freq.QuadPart) * 1000000000LL + (t.QuadPart % freq.QuadPart) * 1000000000LL / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+static long long nvg__fonsTimeNs(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+	return nvg__timeNs();
+}
+
 static float nvg__normalize(float *x, float* y)
 {
 	float d = nvg__sqrtf((*x)*(*x) + (*y)*(*y));
@@ -167,42 +415,347 @@ static float nvg__normalize(float *x, float* y)
 }
 
 
-static void nvg__deletePathCache(NVGpathCache* c)
+static void nvg__countMemory(NVGallocator* allocator, int category, int size)
+{
+	int* usage = &allocator->usage[category];
+	// The counters are updated from the tessellation workers too.
+#if defined(__GNUC__) || defined(__clang__)
+	__sync_fetch_and_add(usage, size);
+#elif defined(_MSC_VER)
+	_InterlockedExchangeAdd((volatile long*)usage, size);
+#else
+	*usage += size;
+#endif
+}
+
+void* nvgInternalAlloc(NVGallocator* allocator, int category, int size)
+{
+	NVGmemHeader* header;
+
+	if (allocator != NULL && allocator->alloc != NULL)
+		header = (NVGmemHeader*)allocator->alloc(allocator->userPtr, NVG_MEM_HEADER_SIZE + size);
+	else
+		header = (NVGmemHeader*)malloc(NVG_MEM_HEADER_SIZE + size);
+	if (header == NULL) return NULL;
+
+	header->allocator = allocator;
+	header->size = size;
+	header->category = category;
+	if (allocator != NULL)
+		nvg__countMemory(allocator, category, size);
+
+	return (unsigned char*)header + NVG_MEM_HEADER_SIZE;
+}
+
+void* nvgInternalRealloc(NVGallocator* allocator, int category, void* ptr, int size)
+{
+	NVGmemHeader* header;
+	int oldSize, oldCategory;
+
+	if (ptr == NULL)
+		return nvgInternalAlloc(allocator, category, size);
+
+	// The memory stays with the allocator it was allocated from.
+	header = (NVGmemHeader*)((unsigned char*)ptr - NVG_MEM_HEADER_SIZE);
+	allocator = header->allocator;
+	oldSize = header->size;
+	oldCategory = header->category;
+
+	if (allocator != NULL && allocator->resize != NULL)
+		header = (NVGmemHeader*)allocator->resize(allocator->userPtr, header, NVG_MEM_HEADER_SIZE + size);
+	else
+		header = (NVGmemHeader*)realloc(header, NVG_MEM_HEADER_SIZE + size);
+	if (header == NULL) return NULL;
+
+	header->size = size;
+	header->category = category;
+	if (allocator != NULL) {
+		nvg__countMemory(allocator, oldCategory, -oldSize);
+		nvg__countMemory(allocator, category, size);
+	}
+
+	return (unsigned char*)header + NVG_MEM_HEADER_SIZE;
+}
+
+void nvgInternalFree(void* ptr)
+{
+	NVGmemHeader* header;
+	NVGallocator* allocator;
+
+	if (ptr == NULL) return;
+	header = (NVGmemHeader*)((unsigned char*)ptr - NVG_MEM_HEADER_SIZE);
+	allocator = header->allocator;
+
+	if (allocator != NULL) {
+		nvg__countMemory(allocator, header->category, -header->size);
+		if (allocator->release != NULL) {
+			allocator->release(allocator->userPtr, header);
+			return;
+		}
+	}
+	free(header);
+}
+
+static void* nvg__fonsAlloc(void* uptr, int type, int size)
+{
+	int category = type == FONS_MEMORY_ATLAS ? NVG_MEMORY_ATLAS : NVG_MEMORY_GLYPHS;
+	return nvgInternalAlloc((NVGallocator*)uptr, category, size);
+}
+
+static void* nvg__fonsRealloc(void* uptr, int type, void* ptr, int size)
+{
+	int category = type == FONS_MEMORY_ATLAS ? NVG_MEMORY_ATLAS : NVG_MEMORY_GLYPHS;
+	return nvgInternalRealloc((NVGallocator*)uptr, category, ptr, size);
+}
+
+static void nvg__fonsFree(void* uptr, void* ptr)
+{
+	NVG_NOTUSED(uptr);
+	nvgInternalFree(ptr);
+}
+
+static NVGarenaBlock* nvg__allocArenaBlock(NVGarena* arena, int size)
+{
+	NVGarenaBlock* block = (NVGarenaBlock*)nvgInternalAlloc(arena->allocator, NVG_MEMORY_FRAME, NVG_ARENA_HEADER_SIZE + size);
+	if (block == NULL) return NULL;
+	block->next = NULL;
+	block->size = size;
+	return block;
+}
+
+static void nvg__freeArenaBlocks(NVGarena* arena)
+{
+	while (arena->blocks != NULL) {
+		NVGarenaBlock* next = arena->blocks->next;
+		nvgInternalFree(arena->blocks);
+		arena->blocks = next;
+	}
+}
+
+static void* nvg__arenaAlloc(void* uptr, int size)
+{
+	NVGarena* arena = (NVGarena*)uptr;
+	NVGarenaBlock* block = arena->blocks;
+	unsigned char* ptr;
+
+	size = (size + NVG_ARENA_ALIGN-1) & ~(NVG_ARENA_ALIGN-1);
+	if (block == NULL || arena->used + size > block->size) {
+		int bsize = nvg__maxi(size, block != NULL ? block->size*2 : NVG_INIT_ARENA_SIZE);
+		block = nvg__allocArenaBlock(arena, bsize);
+		if (block == NULL) return NULL;
+		block->next = arena->blocks;
+		arena->blocks = block;
+		arena->used = 0;
+	}
+
+	ptr = (unsigned char*)block + NVG_ARENA_HEADER_SIZE + arena->used;
+	arena->used += size;
+	arena->frameUsed += size;
+	arena->highWater = nvg__maxi(arena->highWater, arena->frameUsed);
+
+	return ptr;
+}
+
+static void nvg__arenaReset(void* uptr)
+{
+	NVGarena* arena = (NVGarena*)uptr;
+	int size = nvg__maxi(arena->highWater, arena->reserved);
+
+	// Coalesce the blocks into one which can hold the largest frame so far.
+	if (size > 0 && (arena->blocks == NULL || arena->blocks->next != NULL || arena->blocks->size < size)) {
+		nvg__freeArenaBlocks(arena);
+		arena->blocks = nvg__allocArenaBlock(arena, size);
+	}
+
+	arena->used = 0;
+	arena->frameUsed = 0;
+}
+
+static void nvg__deleteArena(NVGarena* arena)
+{
+	if (arena == NULL) return;
+	nvg__freeArenaBlocks(arena);
+	nvgInternalFree(arena);
+}
+
+// Makes room for n more items to a per frame array and returns the new array, or NULL on failure.
+// With a frame allocator the old items are copied and the old memory is left to the allocator.
+// An array dropped at the start of a frame is allocated with the capacity it had before.
+static void* nvg__allocTransient(NVGcontext* ctx, int category, void* items, int* citems, int nitems, int n, int minItems, int itemSize)
+{
+	NVGframeAllocator* fa = &ctx->params.frameAllocator;
+	void* ret;
+	int c;
+
+	if (items != NULL && nitems+n <= *citems)
+		return items;
+
+	if (items == NULL)
+		c = nvg__maxi(nvg__maxi(nitems+n, minItems), *citems);
+	else
+		c = nvg__maxi(nitems+n, minItems) + *citems/2; // 1.5x Overallocate
+
+	if (fa->alloc != NULL) {
+		ret = fa->alloc(fa->userPtr, itemSize * c);
+		if (ret != NULL && nitems > 0)
+			memcpy(ret, items, itemSize * nitems);
+	} else {
+		ret = nvgInternalRealloc(ctx->params.allocator, category, items, itemSize * c);
+	}
+	if (ret == NULL) return NULL;
+
+	*citems = c;
+	return ret;
+}
+
+static void nvg__freeTransient(NVGcontext* ctx, void* items)
+{
+	if (ctx->params.frameAllocator.alloc == NULL)
+		nvgInternalFree(items);
+}
+
+static void nvg__deletePathCache(NVGcontext* ctx, NVGpathCache* c)
 {
 	if (c == NULL) return;
-	if (c->points != NULL) free(c->points);
-	if (c->paths != NULL) free(c->paths);
-	if (c->verts != NULL) free(c->verts);
-	free(c);
+	nvg__freeTransient(ctx, c->points);
+	nvg__freeTransient(ctx, c->paths);
+	nvg__freeTransient(ctx, c->verts);
+	nvgInternalFree(c);
 }
 
-static NVGpathCache* nvg__allocPathCache(void)
+static NVGpathCache* nvg__allocPathCache(NVGallocator* allocator)
 {
-	NVGpathCache* c = (NVGpathCache*)malloc(sizeof(NVGpathCache));
-	if (c == NULL) goto error;
+	NVGpathCache* c = (NVGpathCache*)nvgInternalAlloc(allocator, NVG_MEMORY_PATHCACHE, sizeof(NVGpathCache));
+	if (c == NULL) return NULL;
 	memset(c, 0, sizeof(NVGpathCache));
 
-	c->points = (NVGpoint*)malloc(sizeof(NVGpoint)*NVG_INIT_POINTS_SIZE);
-	if (!c->points) goto error;
-	c->npoints = 0;
+	// The arrays are allocated on first use.
 	c->cpoints = NVG_INIT_POINTS_SIZE;
-
-	c->paths = (NVGpath*)malloc(sizeof(NVGpath)*NVG_INIT_PATHS_SIZE);
-	if (!c->paths) goto error;
-	c->npaths = 0;
 	c->cpaths = NVG_INIT_PATHS_SIZE;
-
-	c->verts = (NVGvertex*)malloc(sizeof(NVGvertex)*NVG_INIT_VERTS_SIZE);
-	if (!c->verts) goto error;
-	c->nverts = 0;
 	c->cverts = NVG_INIT_VERTS_SIZE;
 
 	return c;
+}
+
+static void nvg__deleteDeferred(NVGcontext* ctx, NVGdeferred* d)
+{
+	int i;
+	if (d == NULL) return;
+	if (d->workers != NULL) {
+		for (i = 0; i < d->nworkers; i++) {
+			NVGworker* w = &d->workers[i];
+			if (w->ctx != NULL) {
+				nvg__deletePathCache(w->ctx, w->ctx->cache);
+				nvgInternalFree(w->ctx);
+			}
+			nvgInternalFree(w->paths);
+			nvgInternalFree(w->verts);
+		}
+		nvgInternalFree(d->workers);
+	}
+	nvg__freeTransient(ctx, d->calls);
+	nvg__freeTransient(ctx, d->commands);
+	nvg__freeTransient(ctx, d->verts);
+	nvgInternalFree(d);
+}
+
+static NVGdeferred* nvg__allocDeferred(NVGcontext* ctx, int nworkers)
+{
+	NVGallocator* allocator = ctx->params.allocator;
+	NVGdeferred* d = (NVGdeferred*)nvgInternalAlloc(allocator, NVG_MEMORY_OTHER, sizeof(NVGdeferred));
+	int i;
+	if (d == NULL) goto error;
+	memset(d, 0, sizeof(NVGdeferred));
+
+	// The queue is allocated on first use, the worker contexts use the heap since they run in parallel.
+	d->ccommands = NVG_INIT_COMMANDS_SIZE;
+	d->cverts = NVG_INIT_VERTS_SIZE;
+
+	d->workers = (NVGworker*)nvgInternalAlloc(allocator, NVG_MEMORY_OTHER, sizeof(NVGworker)*nworkers);
+	if (!d->workers) goto error;
+	memset(d->workers, 0, sizeof(NVGworker)*nworkers);
+	d->nworkers = nworkers;
+
+	for (i = 0; i < nworkers; i++) {
+		NVGworker* w = &d->workers[i];
+		w->ctx = (NVGcontext*)nvgInternalAlloc(allocator, NVG_MEMORY_OTHER, sizeof(NVGcontext));
+		if (!w->ctx) goto error;
+		memset(w->ctx, 0, sizeof(NVGcontext));
+		w->ctx->params.allocator = allocator;
+		w->ctx->cache = nvg__allocPathCache(allocator);
+		if (!w->ctx->cache) goto error;
+
+		w->paths = (NVGpath*)nvgInternalAlloc(allocator, NVG_MEMORY_PATHCACHE, sizeof(NVGpath)*NVG_INIT_PATHS_SIZE);
+		if (!w->paths) goto error;
+		w->cpaths = NVG_INIT_PATHS_SIZE;
+
+		w->verts = (NVGvertex*)nvgInternalAlloc(allocator, NVG_MEMORY_PATHCACHE, sizeof(NVGvertex)*NVG_INIT_VERTS_SIZE);
+		if (!w->verts) goto error;
+		w->cverts = NVG_INIT_VERTS_SIZE;
+	}
+
+	return d;
+
 error:
-	nvg__deletePathCache(c);
+	nvg__deleteDeferred(ctx, d);
 	return NULL;
 }
 
+static void nvg__clearDeferred(NVGdeferred* d)
+{
+	d->ncalls = 0;
+	d->ncommands = 0;
+	d->nverts = 0;
+}
+
+// Releases all per frame memory. The arrays keep their capacity so that they are allocated
+// in one go from the frame allocator when they are needed again.
+static void nvg__resetFrameMemory(NVGcontext* ctx)
+{
+	NVGframeAllocator* fa = &ctx->params.frameAllocator;
+	float* commands;
+
+	ctx->cache->npoints = 0;
+	ctx->cache->npaths = 0;
+	if (ctx->deferred != NULL)
+		nvg__clearDeferred(ctx->deferred);
+
+	if (fa->alloc == NULL || fa->reset == NULL)
+		return;
+
+	// The current path survives the reset, it is kept in a buffer which only grows for longer paths.
+	if (ctx->ncommands > ctx->ckeptCommands) {
+		commands = (float*)nvgInternalRealloc(ctx->params.allocator, NVG_MEMORY_COMMANDS, ctx->keptCommands, sizeof(float)*ctx->ncommands);
+		if (commands != NULL) {
+			ctx->keptCommands = commands;
+			ctx->ckeptCommands = ctx->ncommands;
+		} else {
+			ctx->ncommands = 0;
+		}
+	}
+	if (ctx->ncommands > 0)
+		memcpy(ctx->keptCommands, ctx->commands, sizeof(float)*ctx->ncommands);
+
+	fa->reset(fa->userPtr);
+	ctx->commands = NULL;
+	ctx->cache->points = NULL;
+	ctx->cache->paths = NULL;
+	ctx->cache->verts = NULL;
+	if (ctx->deferred != NULL) {
+		ctx->deferred->calls = NULL;
+		ctx->deferred->commands = NULL;
+		ctx->deferred->verts = NULL;
+	}
+
+	if (ctx->ncommands > 0) {
+		ctx->commands = (float*)nvg__allocTransient(ctx, NVG_MEMORY_COMMANDS, NULL, &ctx->ccommands, 0, ctx->ncommands, 0, sizeof(float));
+		if (ctx->commands != NULL)
+			memcpy(ctx->commands, ctx->keptCommands, sizeof(float)*ctx->ncommands);
+		else
+			ctx->ncommands = 0;
+	}
+}
+
 static void nvg__setDevicePixelRatio(NVGcontext* ctx, float ratio)
 {
 	ctx->tessTol = 0.25f / ratio;
@@ -289,10 +842,23 @@ static NVGstate* nvg__getState(NVGcontext* ctx)
 	return &ctx->states[ctx->nstates-1];
 }
 
+static void nvg__flushDeferred(NVGcontext* ctx);
+static int nvg__allocTextAtlas(NVGcontext* ctx);
+static void nvg__flushTextTexture(NVGcontext* ctx);
+static void nvg__deleteRetiredFontImages(NVGcontext* ctx);
+static void nvg__deleteTextCache(NVGtextCache* cache);
+static void nvg__evictTextLayouts(NVGcontext* ctx);
+static float nvg__getFontScale(NVGstate* state);
+
+static int nvg__fontImageFlags(NVGcontext* ctx)
+{
+	return ctx->params.sdfText ? NVG_IMAGE_SDF : 0;
+}
+
 NVGcontext* nvgCreateInternal(NVGparams* params)
 {
 	FONSparams fontParams;
-	NVGcontext* ctx = (NVGcontext*)malloc(sizeof(NVGcontext));
+	NVGcontext* ctx = (NVGcontext*)nvgInternalAlloc(params->allocator, NVG_MEMORY_OTHER, sizeof(NVGcontext));
 	int i;
 	if (ctx == NULL) goto error;
 	memset(ctx, 0, sizeof(NVGcontext));
@@ -300,13 +866,28 @@ NVGcontext* nvgCreateInternal(NVGparams* params)
 	ctx->params = *params;
 	for (i = 0; i < NVG_MAX_FONTIMAGES; i++)
 		ctx->fontImages[i] = 0;
+	ctx->simd = 1;
+
+	// The default allocator uses malloc and just keeps track of the usage.
+	if (ctx->params.allocator == NULL)
+		ctx->params.allocator = &ctx->defaultAllocator;
+
+	if (ctx->params.frameAllocator.alloc == NULL) {
+		ctx->arena = (NVGarena*)nvgInternalAlloc(ctx->params.allocator, NVG_MEMORY_FRAME, sizeof(NVGarena));
+		if (ctx->arena == NULL) goto error;
+		memset(ctx->arena, 0, sizeof(NVGarena));
+		ctx->arena->allocator = ctx->params.allocator;
+		ctx->params.frameAllocator.userPtr = ctx->arena;
+		ctx->params.frameAllocator.alloc = nvg__arenaAlloc;
+		ctx->params.frameAllocator.reset = nvg__arenaReset;
+	}
 
-	ctx->commands = (float*)malloc(sizeof(float)*NVG_INIT_COMMANDS_SIZE);
-	if (!ctx->commands) goto error;
+	// Commands are allocated on first use.
+	ctx->commands = NULL;
 	ctx->ncommands = 0;
 	ctx->ccommands = NVG_INIT_COMMANDS_SIZE;
 
-	ctx->cache = nvg__allocPathCache();
+	ctx->cache = nvg__allocPathCache(ctx->params.allocator);
 	if (ctx->cache == NULL) goto error;
 
 	nvgSave(ctx);
@@ -321,18 +902,24 @@ NVGcontext* nvgCreateInternal(NVGparams* params)
 	fontParams.width = NVG_INIT_FONTIMAGE_SIZE;
 	fontParams.height = NVG_INIT_FONTIMAGE_SIZE;
 	fontParams.flags = FONS_ZERO_TOPLEFT;
+	if (ctx->params.sdfText)
+		fontParams.flags |= FONS_SDF;
 	fontParams.renderCreate = NULL;
 	fontParams.renderUpdate = NULL;
 	fontParams.renderDraw = NULL;
 	fontParams.renderDelete = NULL;
 	fontParams.userPtr = NULL;
+	fontParams.memUserPtr = ctx->params.allocator;
+	fontParams.memAlloc = nvg__fonsAlloc;
+	fontParams.memRealloc = nvg__fonsRealloc;
+	fontParams.memFree = nvg__fonsFree;
+	fontParams.timeNs = nvg__fonsTimeNs;
 	ctx->fs = fonsCreateInternal(&fontParams);
 	if (ctx->fs == NULL) goto error;
 
 	// Create font texture
-	ctx->fontImages[0] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, fontParams.width, fontParams.height, 0, NULL);
+	ctx->fontImages[0] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, fontParams.width, fontParams.height, nvg__fontImageFlags(ctx), NULL);
 	if (ctx->fontImages[0] == 0) goto error;
-	ctx->fontImageIdx = 0;
 
 	return ctx;
 
@@ -350,8 +937,11 @@ void nvgDeleteInternal(NVGcontext* ctx)
 {
 	int i;
 	if (ctx == NULL) return;
-	if (ctx->commands != NULL) free(ctx->commands);
-	if (ctx->cache != NULL) nvg__deletePathCache(ctx->cache);
+	nvg__freeTransient(ctx, ctx->commands);
+	nvgInternalFree(ctx->keptCommands);
+	if (ctx->cache != NULL) nvg__deletePathCache(ctx, ctx->cache);
+	if (ctx->deferred != NULL) nvg__deleteDeferred(ctx, ctx->deferred);
+	if (ctx->textCache != NULL) nvg__deleteTextCache(ctx->textCache);
 
 	if (ctx->fs)
 		fonsDeleteInternal(ctx->fs);
@@ -362,19 +952,27 @@ void nvgDeleteInternal(NVGcontext* ctx)
 			ctx->fontImages[i] = 0;
 		}
 	}
+	nvg__deleteRetiredFontImages(ctx);
 
 	if (ctx->params.renderDelete != NULL)
 		ctx->params.renderDelete(ctx->params.userPtr);
 
-	free(ctx);
+	nvg__deleteArena(ctx->arena);
+
+	// The context is allocated from the user allocator, the default allocator lives in the context.
+	nvgInternalFree(ctx);
 }
 
 void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float devicePixelRatio)
 {
+	FONSstats fstats;
+
 /*	printf("Tris: draws:%d  fill:%d  stroke:%d  text:%d  TOT:%d\n",
 		ctx->drawCallCount, ctx->fillTriCount, ctx->strokeTriCount, ctx->textTriCount,
 		ctx->fillTriCount+ctx->strokeTriCount+ctx->textTriCount);*/
 
+	nvg__resetFrameMemory(ctx);
+
 	ctx->nstates = 0;
 	nvgSave(ctx);
 	nvgReset(ctx);
@@ -387,41 +985,68 @@ void nvgBeginFrame(NVGcontext* ctx, float windowWidth, float windowHeight, float
 	ctx->fillTriCount = 0;
 	ctx->strokeTriCount = 0;
 	ctx->textTriCount = 0;
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
+
+	// Grow the font atlas rather than keep evicting glyphs every frame.
+	fonsGetStats(ctx->fs, &fstats);
+	if (fstats.glyphEvictions > 0)
+		nvg__allocTextAtlas(ctx);
+	fonsAdvanceFrame(ctx->fs);
+	fonsResetStats(ctx->fs);
+	nvg__evictTextLayouts(ctx);
+}
+
+void nvgReserveFrameMemory(NVGcontext* ctx, int size)
+{
+	if (ctx->arena != NULL)
+		ctx->arena->reserved = size;
+}
+
+int nvgFrameMemoryHighWater(NVGcontext* ctx)
+{
+	return ctx->arena != NULL ? ctx->arena->highWater : 0;
+}
+
+int nvgMemoryUsage(NVGcontext* ctx, int category)
+{
+	if (category < 0 || category >= NVG_MEMORY_COUNT) return 0;
+	return ctx->params.allocator->usage[category];
+}
+
+void nvgGetFrameStats(NVGcontext* ctx, NVGframeStats* stats)
+{
+	FONSstats fstats;
+
+	*stats = ctx->stats;
+	stats->drawCalls = ctx->drawCallCount;
+	stats->fillTriangles = ctx->fillTriCount;
+	stats->strokeTriangles = ctx->strokeTriCount;
+	stats->textTriangles = ctx->textTriCount;
+
+	fonsGetStats(ctx->fs, &fstats);
+	stats->glyphCacheHits = fstats.glyphHits;
+	stats->glyphCacheMisses = fstats.glyphMisses;
+	stats->glyphCacheEvictions = fstats.glyphEvictions;
+	stats->glyphRasterizeTime = fstats.rasterizeTime;
 }
 
 void nvgCancelFrame(NVGcontext* ctx)
 {
+	if (ctx->deferred != NULL)
+		nvg__clearDeferred(ctx->deferred);
 	ctx->params.renderCancel(ctx->params.userPtr);
 }
 
 void nvgEndFrame(NVGcontext* ctx)
 {
+	long long startTime;
+	nvg__flushDeferred(ctx);
+	// The back-ends draw the text on flush, the glyphs added during the frame are uploaded once.
+	nvg__flushTextTexture(ctx);
+	startTime = nvg__timeNs();
 	ctx->params.renderFlush(ctx->params.userPtr);
-	if (ctx->fontImageIdx != 0) {
-		int fontImage = ctx->fontImages[ctx->fontImageIdx];
-		ctx->fontImages[ctx->fontImageIdx] = 0;
-		int i, j, iw, ih;
-		// delete images that smaller than current one
-		if (fontImage == 0)
-			return;
-		nvgImageSize(ctx, fontImage, &iw, &ih);
-		for (i = j = 0; i < ctx->fontImageIdx; i++) {
-			if (ctx->fontImages[i] != 0) {
-				int nw, nh;
-				int image = ctx->fontImages[i];
-				ctx->fontImages[i] = 0;
-				nvgImageSize(ctx, image, &nw, &nh);
-				if (nw < iw || nh < ih)
-					nvgDeleteImage(ctx, image);
-				else
-					ctx->fontImages[j++] = image;
-			}
-		}
-		// make current font image to first
-		ctx->fontImages[j] = ctx->fontImages[0];
-		ctx->fontImages[0] = fontImage;
-		ctx->fontImageIdx = 0;
-	}
+	ctx->stats.flushTime += nvg__timeNs() - startTime;
+	nvg__deleteRetiredFontImages(ctx);
 }
 
 NVGcolor nvgRGB(unsigned char r, unsigned char g, unsigned char b)
@@ -801,7 +1426,9 @@ int nvgCreateImage(NVGcontext* ctx, const char* filename, int imageFlags)
 	unsigned char* img;
 	stbi_set_unpremultiply_on_load(1);
 	stbi_convert_iphone_png_to_rgb(1);
+	nvg__imageAllocator = ctx->params.allocator;
 	img = stbi_load(filename, &w, &h, &n, 4);
+	nvg__imageAllocator = NULL;
 	if (img == NULL) {
 //		printf("Failed to load %s - %s\n", filename, stbi_failure_reason());
 		return 0;
@@ -814,7 +1441,10 @@ int nvgCreateImage(NVGcontext* ctx, const char* filename, int imageFlags)
 int nvgCreateImageMem(NVGcontext* ctx, int imageFlags, unsigned char* data, int ndata)
 {
 	int w, h, n, image;
-	unsigned char* img = stbi_load_from_memory(data, ndata, &w, &h, &n, 4);
+	unsigned char* img;
+	nvg__imageAllocator = ctx->params.allocator;
+	img = stbi_load_from_memory(data, ndata, &w, &h, &n, 4);
+	nvg__imageAllocator = NULL;
 	if (img == NULL) {
 //		printf("Failed to load %s - %s\n", filename, stbi_failure_reason());
 		return 0;
@@ -1077,44 +1707,44 @@ static float nvg__distPtSeg(float x, float y, float px, float py, float qx, floa
 	return dx*dx + dy*dy;
 }
 
-static void nvg__appendCommands(NVGcontext* ctx, float* vals, int nvals)
+static void nvg__transformVector(float* dx, float* dy, const float* t, float sx, float sy)
 {
-	NVGstate* state = nvg__getState(ctx);
-	int i;
-
-	if (ctx->ncommands+nvals > ctx->ccommands) {
-		float* commands;
-		int ccommands = ctx->ncommands+nvals + ctx->ccommands/2;
-		commands = (float*)realloc(ctx->commands, sizeof(float)*ccommands);
-		if (commands == NULL) return;
-		ctx->commands = commands;
-		ctx->ccommands = ccommands;
-	}
-
-	if ((int)vals[0] != NVG_CLOSE && (int)vals[0] != NVG_WINDING) {
-		ctx->commandx = vals[nvals-2];
-		ctx->commandy = vals[nvals-1];
-	}
+	*dx = sx*t[0] + sy*t[2];
+	*dy = sx*t[1] + sy*t[3];
+}
 
-	// transform commands
-	i = 0;
+static void nvg__transformCommands(float* vals, int nvals, const float* xform)
+{
+	int i = 0;
 	while (i < nvals) {
 		int cmd = (int)vals[i];
 		switch (cmd) {
 		case NVG_MOVETO:
-			nvgTransformPoint(&vals[i+1],&vals[i+2], state->xform, vals[i+1],vals[i+2]);
+			nvgTransformPoint(&vals[i+1],&vals[i+2], xform, vals[i+1],vals[i+2]);
 			i += 3;
 			break;
 		case NVG_LINETO:
-			nvgTransformPoint(&vals[i+1],&vals[i+2], state->xform, vals[i+1],vals[i+2]);
+			nvgTransformPoint(&vals[i+1],&vals[i+2], xform, vals[i+1],vals[i+2]);
 			i += 3;
 			break;
 		case NVG_BEZIERTO:
-			nvgTransformPoint(&vals[i+1],&vals[i+2], state->xform, vals[i+1],vals[i+2]);
-			nvgTransformPoint(&vals[i+3],&vals[i+4], state->xform, vals[i+3],vals[i+4]);
-			nvgTransformPoint(&vals[i+5],&vals[i+6], state->xform, vals[i+5],vals[i+6]);
+			nvgTransformPoint(&vals[i+1],&vals[i+2], xform, vals[i+1],vals[i+2]);
+			nvgTransformPoint(&vals[i+3],&vals[i+4], xform, vals[i+3],vals[i+4]);
+			nvgTransformPoint(&vals[i+5],&vals[i+6], xform, vals[i+5],vals[i+6]);
 			i += 7;
 			break;
+		case NVG_QUADTO:
+			nvgTransformPoint(&vals[i+1],&vals[i+2], xform, vals[i+1],vals[i+2]);
+			nvgTransformPoint(&vals[i+3],&vals[i+4], xform, vals[i+3],vals[i+4]);
+			i += 5;
+			break;
+		case NVG_ARCTO:
+			nvgTransformPoint(&vals[i+1],&vals[i+2], xform, vals[i+1],vals[i+2]);
+			nvg__transformVector(&vals[i+3],&vals[i+4], xform, vals[i+3],vals[i+4]);
+			nvg__transformVector(&vals[i+5],&vals[i+6], xform, vals[i+5],vals[i+6]);
+			nvgTransformPoint(&vals[i+9],&vals[i+10], xform, vals[i+9],vals[i+10]);
+			i += 11;
+			break;
 		case NVG_CLOSE:
 			i++;
 			break;
@@ -1125,6 +1755,24 @@ static void nvg__appendCommands(NVGcontext* ctx, float* vals, int nvals)
 			i++;
 		}
 	}
+}
+
+static void nvg__appendCommands(NVGcontext* ctx, float* vals, int nvals)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float* commands;
+
+	commands = (float*)nvg__allocTransient(ctx, NVG_MEMORY_COMMANDS, ctx->commands, &ctx->ccommands, ctx->ncommands, nvals, 0, sizeof(float));
+	if (commands == NULL) return;
+	ctx->commands = commands;
+
+	if ((int)vals[0] != NVG_CLOSE && (int)vals[0] != NVG_WINDING) {
+		ctx->commandx = vals[nvals-2];
+		ctx->commandy = vals[nvals-1];
+	}
+
+	// transform commands
+	nvg__transformCommands(vals, nvals, state->xform);
 
 	memcpy(&ctx->commands[ctx->ncommands], vals, nvals*sizeof(float));
 
@@ -1148,14 +1796,12 @@ static NVGpath* nvg__lastPath(NVGcontext* ctx)
 static void nvg__addPath(NVGcontext* ctx)
 {
 	NVGpath* path;
-	if (ctx->cache->npaths+1 > ctx->cache->cpaths) {
-		NVGpath* paths;
-		int cpaths = ctx->cache->npaths+1 + ctx->cache->cpaths/2;
-		paths = (NVGpath*)realloc(ctx->cache->paths, sizeof(NVGpath)*cpaths);
-		if (paths == NULL) return;
-		ctx->cache->paths = paths;
-		ctx->cache->cpaths = cpaths;
-	}
+	NVGpath* paths;
+
+	paths = (NVGpath*)nvg__allocTransient(ctx, NVG_MEMORY_PATHCACHE, ctx->cache->paths, &ctx->cache->cpaths, ctx->cache->npaths, 1, 0, sizeof(NVGpath));
+	if (paths == NULL) return;
+	ctx->cache->paths = paths;
+
 	path = &ctx->cache->paths[ctx->cache->npaths];
 	memset(path, 0, sizeof(*path));
 	path->first = ctx->cache->npoints;
@@ -1174,6 +1820,7 @@ static NVGpoint* nvg__lastPoint(NVGcontext* ctx)
 static void nvg__addPoint(NVGcontext* ctx, float x, float y, int flags)
 {
 	NVGpath* path = nvg__lastPath(ctx);
+	NVGpoint* points;
 	NVGpoint* pt;
 	if (path == NULL) return;
 
@@ -1185,14 +1832,9 @@ static void nvg__addPoint(NVGcontext* ctx, float x, float y, int flags)
 		}
 	}
 
-	if (ctx->cache->npoints+1 > ctx->cache->cpoints) {
-		NVGpoint* points;
-		int cpoints = ctx->cache->npoints+1 + ctx->cache->cpoints/2;
-		points = (NVGpoint*)realloc(ctx->cache->points, sizeof(NVGpoint)*cpoints);
-		if (points == NULL) return;
-		ctx->cache->points = points;
-		ctx->cache->cpoints = cpoints;
-	}
+	points = (NVGpoint*)nvg__allocTransient(ctx, NVG_MEMORY_PATHCACHE, ctx->cache->points, &ctx->cache->cpoints, ctx->cache->npoints, 1, 0, sizeof(NVGpoint));
+	if (points == NULL) return;
+	ctx->cache->points = points;
 
 	pt = &ctx->cache->points[ctx->cache->npoints];
 	memset(pt, 0, sizeof(*pt));
@@ -1227,16 +1869,13 @@ static float nvg__getAverageScale(float *t)
 
 static NVGvertex* nvg__allocTempVerts(NVGcontext* ctx, int nverts)
 {
-	if (nverts > ctx->cache->cverts) {
-		NVGvertex* verts;
-		int cverts = (nverts + 0xff) & ~0xff; // Round up to prevent allocations when things change just slightly.
-		verts = (NVGvertex*)realloc(ctx->cache->verts, sizeof(NVGvertex)*cverts);
-		if (verts == NULL) return NULL;
-		ctx->cache->verts = verts;
-		ctx->cache->cverts = cverts;
-	}
-
-	return ctx->cache->verts;
+	NVGvertex* verts;
+	ctx->stats.vertexBytes += nverts * (int)sizeof(NVGvertex);
+	nverts = (nverts + 0xff) & ~0xff; // Round up to prevent allocations when things change just slightly.
+	verts = (NVGvertex*)nvg__allocTransient(ctx, NVG_MEMORY_PATHCACHE, ctx->cache->verts, &ctx->cache->cverts, 0, nverts, 0, sizeof(NVGvertex));
+	if (verts == NULL) return NULL;
+	ctx->cache->verts = verts;
+	return verts;
 }
 
 static float nvg__triarea2(float ax, float ay, float bx, float by, float cx, float cy)
@@ -1322,10 +1961,149 @@ static void nvg__tesselateBezier(NVGcontext* ctx,
 	x1234 = (x123+x234)*0.5f;
 	y1234 = (y123+y234)*0.5f;
 
+	ctx->stats.bezierSubdivisions++;
+
 	nvg__tesselateBezier(ctx, x1,y1, x12,y12, x123,y123, x1234,y1234, level+1, 0);
 	nvg__tesselateBezier(ctx, x1234,y1234, x234,y234, x34,y34, x4,y4, level+1, type);
 }
 
+// Flattens the curve into the number of segments given by Wang's formula, which bounds the distance
+// of the segments from the curve by tessTol. The points are evaluated using forward differencing.
+static void nvg__flattenBezier(NVGcontext* ctx,
+							   float x1, float y1, float x2, float y2,
+							   float x3, float y3, float x4, float y4,
+							   int type)
+{
+	NVGpath* path = nvg__lastPath(ctx);
+	NVGpathCache* cache = ctx->cache;
+	NVGpoint* points;
+	NVGpoint* last;
+	float ddx0 = x1 - 2*x2 + x3, ddy0 = y1 - 2*y2 + y3;
+	float ddx1 = x2 - 2*x3 + x4, ddy1 = y2 - 2*y3 + y4;
+	float dd = nvg__maxf(ddx0*ddx0 + ddy0*ddy0, ddx1*ddx1 + ddy1*ddy1);
+	float ax, ay, bx, by, cx, cy, h, h2, h3;
+	float px, py, dx, dy, d2x, d2y, d3x, d3y;
+	int i, n;
+	if (path == NULL) return;
+
+	// Wang's formula for cubic: n = sqrt(3/4 * max|p[i] - 2p[i+1] + p[i+2]| / tol)
+	n = (int)ceilf(nvg__sqrtf(0.75f * nvg__sqrtf(dd) / ctx->tessTol));
+	n = nvg__clampi(n, 1, NVG_MAX_BEZIER_SEGMENTS);
+	ctx->stats.bezierSubdivisions += n-1;
+
+	// Reserve the points at once, the last point is added with the flags below.
+	points = (NVGpoint*)nvg__allocTransient(ctx, NVG_MEMORY_PATHCACHE, cache->points, &cache->cpoints, cache->npoints, n, 0, sizeof(NVGpoint));
+	if (points == NULL) return;
+	cache->points = points;
+
+	// Polynomial coefficients and forward differences for step h.
+	ax = -x1 + 3*x2 - 3*x3 + x4;
+	ay = -y1 + 3*y2 - 3*y3 + y4;
+	bx = 3*x1 - 6*x2 + 3*x3;
+	by = 3*y1 - 6*y2 + 3*y3;
+	cx = 3*(x2 - x1);
+	cy = 3*(y2 - y1);
+	h = 1.0f / n;
+	h2 = h*h;
+	h3 = h2*h;
+	dx = ax*h3 + bx*h2 + cx*h;
+	dy = ay*h3 + by*h2 + cy*h;
+	d3x = 6*ax*h3;
+	d3y = 6*ay*h3;
+	d2x = d3x + 2*bx*h2;
+	d2y = d3y + 2*by*h2;
+	px = x1;
+	py = y1;
+
+	last = cache->npoints > 0 && path->count > 0 ? &points[cache->npoints-1] : NULL;
+	for (i = 1; i < n; i++) {
+		NVGpoint* pt;
+		px += dx;
+		py += dy;
+		dx += d2x;
+		dy += d2y;
+		d2x += d3x;
+		d2y += d3y;
+		if (last != NULL && nvg__ptEquals(last->x,last->y, px,py, ctx->distTol))
+			continue;
+		// The rest of the point is calculated by nvg__flattenPaths() and nvg__calculateJoins().
+		pt = &points[cache->npoints++];
+		pt->x = px;
+		pt->y = py;
+		pt->flags = 0;
+		path->count++;
+		last = pt;
+	}
+
+	nvg__addPoint(ctx, x4, y4, type);
+}
+
+static int nvg__curveDivs(float r, float arc, float tol)
+{
+	float da = acosf(r / (r + tol)) * 2.0f;
+	return nvg__maxi(2, (int)ceilf(arc / da));
+}
+
+// Flattens quadratic bezier using the segment count from Wang's formula and forward differencing.
+static void nvg__flattenQuad(NVGcontext* ctx, float x1, float y1, float x2, float y2, float x3, float y3, int type)
+{
+	float ax = x1 - 2*x2 + x3, ay = y1 - 2*y2 + y3;
+	float bx = 2*(x2 - x1), by = 2*(y2 - y1);
+	float h, dx, dy, d2x, d2y, px = x1, py = y1;
+	int i, n;
+
+	n = (int)ceilf(nvg__sqrtf(0.25f * nvg__sqrtf(ax*ax + ay*ay) / ctx->tessTol));
+	n = nvg__clampi(n, 1, NVG_MAX_BEZIER_SEGMENTS);
+	ctx->stats.bezierSubdivisions += n-1;
+
+	h = 1.0f / n;
+	dx = ax*h*h + bx*h;
+	dy = ay*h*h + by*h;
+	d2x = 2*ax*h*h;
+	d2y = 2*ay*h*h;
+	for (i = 1; i < n; i++) {
+		px += dx;
+		py += dy;
+		dx += d2x;
+		dy += d2y;
+		nvg__addPoint(ctx, px, py, 0);
+	}
+	nvg__addPoint(ctx, x3, y3, type);
+}
+
+// Flattens elliptic arc, the number of segments is calculated from the larger radius like for round joins.
+static void nvg__flattenArc(NVGcontext* ctx, const float* arc, int type)
+{
+	float cx = arc[0], cy = arc[1];
+	float ux = arc[2], uy = arc[3];
+	float vx = arc[4], vy = arc[5];
+	float a0 = arc[6], da = arc[7];
+	float r = nvg__sqrtf(nvg__maxf(ux*ux + uy*uy, vx*vx + vy*vy));
+	float cs, sn, dcs, dsn, tmp;
+	NVGpoint* points;
+	int i, n;
+
+	n = nvg__curveDivs(r, nvg__absf(da), ctx->tessTol);
+	n = nvg__mini(n, NVG_MAX_BEZIER_SEGMENTS);
+
+	points = (NVGpoint*)nvg__allocTransient(ctx, NVG_MEMORY_PATHCACHE, ctx->cache->points, &ctx->cache->cpoints, ctx->cache->npoints, n, 0, sizeof(NVGpoint));
+	if (points == NULL) return;
+	ctx->cache->points = points;
+
+	// Rotate the angle incrementally.
+	cs = nvg__cosf(a0);
+	sn = nvg__sinf(a0);
+	dcs = nvg__cosf(da / n);
+	dsn = nvg__sinf(da / n);
+	for (i = 1; i < n; i++) {
+		tmp = cs*dcs - sn*dsn;
+		sn = sn*dcs + cs*dsn;
+		cs = tmp;
+		nvg__addPoint(ctx, cx + ux*cs + vx*sn, cy + uy*cs + vy*sn, 0);
+	}
+	nvg__addPoint(ctx, arc[8], arc[9], type);
+}
+
 static void nvg__flattenPaths(NVGcontext* ctx)
 {
 	NVGpathCache* cache = ctx->cache;
@@ -1340,10 +2118,13 @@ static void nvg__flattenPaths(NVGcontext* ctx)
 	float* cp2;
 	float* p;
 	float area;
+	long long startTime;
 
 	if (cache->npaths > 0)
 		return;
 
+	startTime = nvg__timeNs();
+
 	// Flatten
 	i = 0;
 	while (i < ctx->ncommands) {
@@ -1366,10 +2147,26 @@ static void nvg__flattenPaths(NVGcontext* ctx)
 				cp1 = &ctx->commands[i+1];
 				cp2 = &ctx->commands[i+3];
 				p = &ctx->commands[i+5];
-				nvg__tesselateBezier(ctx, last->x,last->y, cp1[0],cp1[1], cp2[0],cp2[1], p[0],p[1], 0, NVG_PT_CORNER);
+				if (ctx->flattening == NVG_FLATTEN_ANALYTIC)
+					nvg__flattenBezier(ctx, last->x,last->y, cp1[0],cp1[1], cp2[0],cp2[1], p[0],p[1], NVG_PT_CORNER);
+				else
+					nvg__tesselateBezier(ctx, last->x,last->y, cp1[0],cp1[1], cp2[0],cp2[1], p[0],p[1], 0, NVG_PT_CORNER);
 			}
 			i += 7;
 			break;
+		case NVG_QUADTO:
+			last = nvg__lastPoint(ctx);
+			if (last != NULL) {
+				cp1 = &ctx->commands[i+1];
+				p = &ctx->commands[i+3];
+				nvg__flattenQuad(ctx, last->x,last->y, cp1[0],cp1[1], p[0],p[1], NVG_PT_CORNER);
+			}
+			i += 5;
+			break;
+		case NVG_ARCTO:
+			nvg__flattenArc(ctx, &ctx->commands[i+1], NVG_PT_CORNER);
+			i += 11;
+			break;
 		case NVG_CLOSE:
 			nvg__closePath(ctx);
 			i++;
@@ -1423,12 +2220,9 @@ static void nvg__flattenPaths(NVGcontext* ctx)
 			p0 = p1++;
 		}
 	}
-}
 
-static int nvg__curveDivs(float r, float arc, float tol)
-{
-	float da = acosf(r / (r + tol)) * 2.0f;
-	return nvg__maxi(2, (int)ceilf(arc / da));
+	ctx->stats.points += cache->npoints;
+	ctx->stats.flattenTime += nvg__timeNs() - startTime;
 }
 
 static void nvg__chooseBevel(int bevel, NVGpoint* p0, NVGpoint* p1, float w,
@@ -1655,6 +2449,156 @@ static NVGvertex* nvg__roundCapEnd(NVGvertex* dst, NVGpoint* p,
 }
 
 
+static void nvg__calculateJoin(NVGpoint* p0, NVGpoint* p1, float iw, int lineJoin, float miterLimit)
+{
+	float dlx0, dly0, dlx1, dly1, dmr2, cross, limit;
+	dlx0 = p0->dy;
+	dly0 = -p0->dx;
+	dlx1 = p1->dy;
+	dly1 = -p1->dx;
+	// Calculate extrusions
+	p1->dmx = (dlx0 + dlx1) * 0.5f;
+	p1->dmy = (dly0 + dly1) * 0.5f;
+	dmr2 = p1->dmx*p1->dmx + p1->dmy*p1->dmy;
+	if (dmr2 > 0.000001f) {
+		float scale = 1.0f / dmr2;
+		if (scale > 600.0f) {
+			scale = 600.0f;
+		}
+		p1->dmx *= scale;
+		p1->dmy *= scale;
+	}
+
+	// Clear flags, but keep the corner.
+	p1->flags = (p1->flags & NVG_PT_CORNER) ? NVG_PT_CORNER : 0;
+
+	// Keep track of left turns.
+	cross = p1->dx * p0->dy - p0->dx * p1->dy;
+	if (cross > 0.0f)
+		p1->flags |= NVG_PT_LEFT;
+
+	// Calculate if we should use bevel or miter for inner join.
+	limit = nvg__maxf(1.01f, nvg__minf(p0->len, p1->len) * iw);
+	if ((dmr2 * limit*limit) < 1.0f)
+		p1->flags |= NVG_PR_INNERBEVEL;
+
+	// Check to see if the corner needs to be beveled.
+	if (p1->flags & NVG_PT_CORNER) {
+		if ((dmr2 * miterLimit*miterLimit) < 1.0f || lineJoin == NVG_BEVEL || lineJoin == NVG_ROUND) {
+			p1->flags |= NVG_PT_BEVEL;
+		}
+	}
+}
+
+#ifdef NVG_SSE2
+// Loads direction and length of 4 consecutive points, transposed into separate vectors.
+static void nvg__loadPointsSSE2(const NVGpoint* p, __m128* dx, __m128* dy, __m128* len)
+{
+	__m128 a0 = _mm_loadu_ps(&p[0].x);
+	__m128 a1 = _mm_loadu_ps(&p[1].x);
+	__m128 a2 = _mm_loadu_ps(&p[2].x);
+	__m128 a3 = _mm_loadu_ps(&p[3].x);
+	__m128 b0 = _mm_loadu_ps(&p[0].len);
+	__m128 b1 = _mm_loadu_ps(&p[1].len);
+	__m128 b2 = _mm_loadu_ps(&p[2].len);
+	__m128 b3 = _mm_loadu_ps(&p[3].len);
+	_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+	*dx = a2;
+	*dy = a3;
+	*len = _mm_movelh_ps(_mm_unpacklo_ps(b0, b1), _mm_unpacklo_ps(b2, b3));
+}
+
+// Calculates joins 4 points at a time, the results are identical to nvg__calculateJoin().
+static void nvg__calculateJoinsSSE2(NVGpoint* pts, int npts, float iw, int lineJoin, float miterLimit)
+{
+	const __m128 sign = _mm_set1_ps(-0.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minDmr2 = _mm_set1_ps(0.000001f);
+	const __m128 maxScale = _mm_set1_ps(600.0f);
+	const __m128 minLimit = _mm_set1_ps(1.01f);
+	const __m128 iw4 = _mm_set1_ps(iw);
+	const __m128 miter4 = _mm_set1_ps(miterLimit);
+	float dmx[4], dmy[4];
+	int j, k;
+
+	if (npts == 0) return;
+
+	// The first point joins with the last one.
+	nvg__calculateJoin(&pts[npts-1], &pts[0], iw, lineJoin, miterLimit);
+
+	for (j = 1; j+4 <= npts; j += 4) {
+		NVGpoint* p1 = &pts[j];
+		__m128 dx0, dy0, len0, dx1, dy1, len1;
+		__m128 mx, my, dmr2, scale, mask, cross, limit;
+		int left, inner, bevel;
+
+		nvg__loadPointsSSE2(&pts[j-1], &dx0, &dy0, &len0);
+		nvg__loadPointsSSE2(p1, &dx1, &dy1, &len1);
+
+		// Calculate extrusions
+		mx = _mm_mul_ps(_mm_add_ps(dy0, dy1), half);
+		my = _mm_mul_ps(_mm_add_ps(_mm_xor_ps(dx0, sign), _mm_xor_ps(dx1, sign)), half);
+		dmr2 = _mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(my, my));
+		mask = _mm_cmpgt_ps(dmr2, minDmr2);
+		scale = _mm_min_ps(_mm_div_ps(one, dmr2), maxScale);
+		mx = _mm_or_ps(_mm_and_ps(mask, _mm_mul_ps(mx, scale)), _mm_andnot_ps(mask, mx));
+		my = _mm_or_ps(_mm_and_ps(mask, _mm_mul_ps(my, scale)), _mm_andnot_ps(mask, my));
+
+		// Left turns, inner bevels and bevels.
+		cross = _mm_sub_ps(_mm_mul_ps(dx1, dy0), _mm_mul_ps(dx0, dy1));
+		left = _mm_movemask_ps(_mm_cmpgt_ps(cross, zero));
+		limit = _mm_max_ps(minLimit, _mm_mul_ps(_mm_min_ps(len0, len1), iw4));
+		inner = _mm_movemask_ps(_mm_cmplt_ps(_mm_mul_ps(_mm_mul_ps(dmr2, limit), limit), one));
+		if (lineJoin == NVG_BEVEL || lineJoin == NVG_ROUND)
+			bevel = 0xf;
+		else
+			bevel = _mm_movemask_ps(_mm_cmplt_ps(_mm_mul_ps(_mm_mul_ps(dmr2, miter4), miter4), one));
+
+		_mm_storeu_ps(dmx, mx);
+		_mm_storeu_ps(dmy, my);
+		for (k = 0; k < 4; k++) {
+			NVGpoint* p = &p1[k];
+			unsigned char flags = (p->flags & NVG_PT_CORNER) ? NVG_PT_CORNER : 0;
+			p->dmx = dmx[k];
+			p->dmy = dmy[k];
+			if (left & (1 << k))
+				flags |= NVG_PT_LEFT;
+			if (inner & (1 << k))
+				flags |= NVG_PR_INNERBEVEL;
+			if ((flags & NVG_PT_CORNER) && (bevel & (1 << k)))
+				flags |= NVG_PT_BEVEL;
+			p->flags = flags;
+		}
+	}
+
+	for (; j < npts; j++)
+		nvg__calculateJoin(&pts[j-1], &pts[j], iw, lineJoin, miterLimit);
+}
+
+// Writes the left and right vertex of a mitered point, both vertices with one vector store.
+static NVGvertex* nvg__miterVertsSSE2(NVGvertex* dst, const NVGpoint* p, float lw, float rw, float lu, float ru)
+{
+	const __m128 xy = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, 0, 0));
+	__m128 pos = _mm_loadu_ps(&p->x);
+	__m128 b = _mm_loadu_ps(&p->len);
+	__m128 dm = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2,1,2,1));
+	__m128 l = _mm_add_ps(pos, _mm_mul_ps(dm, _mm_set1_ps(lw)));
+	__m128 r = _mm_sub_ps(pos, _mm_mul_ps(dm, _mm_set1_ps(rw)));
+	_mm_storeu_ps(&dst[0].x, _mm_or_ps(_mm_and_ps(l, xy), _mm_setr_ps(0.0f, 0.0f, lu, 1.0f)));
+	_mm_storeu_ps(&dst[1].x, _mm_or_ps(_mm_and_ps(r, xy), _mm_setr_ps(0.0f, 0.0f, ru, 1.0f)));
+	return dst + 2;
+}
+#endif
+
+static NVGvertex* nvg__miterVerts(NVGvertex* dst, const NVGpoint* p, float lw, float rw, float lu, float ru)
+{
+	nvg__vset(dst, p->x + (p->dmx * lw), p->y + (p->dmy * lw), lu,1); dst++;
+	nvg__vset(dst, p->x - (p->dmx * rw), p->y - (p->dmy * rw), ru,1); dst++;
+	return dst;
+}
+
 static void nvg__calculateJoins(NVGcontext* ctx, float w, int lineJoin, float miterLimit)
 {
 	NVGpathCache* cache = ctx->cache;
@@ -1667,57 +2611,30 @@ static void nvg__calculateJoins(NVGcontext* ctx, float w, int lineJoin, float mi
 	for (i = 0; i < cache->npaths; i++) {
 		NVGpath* path = &cache->paths[i];
 		NVGpoint* pts = &cache->points[path->first];
-		NVGpoint* p0 = &pts[path->count-1];
-		NVGpoint* p1 = &pts[0];
 		int nleft = 0;
 
 		path->nbevel = 0;
 
-		for (j = 0; j < path->count; j++) {
-			float dlx0, dly0, dlx1, dly1, dmr2, cross, limit;
-			dlx0 = p0->dy;
-			dly0 = -p0->dx;
-			dlx1 = p1->dy;
-			dly1 = -p1->dx;
-			// Calculate extrusions
-			p1->dmx = (dlx0 + dlx1) * 0.5f;
-			p1->dmy = (dly0 + dly1) * 0.5f;
-			dmr2 = p1->dmx*p1->dmx + p1->dmy*p1->dmy;
-			if (dmr2 > 0.000001f) {
-				float scale = 1.0f / dmr2;
-				if (scale > 600.0f) {
-					scale = 600.0f;
-				}
-				p1->dmx *= scale;
-				p1->dmy *= scale;
+#ifdef NVG_SSE2
+		if (ctx->simd) {
+			nvg__calculateJoinsSSE2(pts, path->count, iw, lineJoin, miterLimit);
+		} else
+#endif
+		{
+			NVGpoint* p0 = &pts[path->count-1];
+			NVGpoint* p1 = &pts[0];
+			for (j = 0; j < path->count; j++) {
+				nvg__calculateJoin(p0, p1, iw, lineJoin, miterLimit);
+				p0 = p1++;
 			}
+		}
 
-			// Clear flags, but keep the corner.
-			p1->flags = (p1->flags & NVG_PT_CORNER) ? NVG_PT_CORNER : 0;
-
+		for (j = 0; j < path->count; j++) {
 			// Keep track of left turns.
-			cross = p1->dx * p0->dy - p0->dx * p1->dy;
-			if (cross > 0.0f) {
+			if (pts[j].flags & NVG_PT_LEFT)
 				nleft++;
-				p1->flags |= NVG_PT_LEFT;
-			}
-
-			// Calculate if we should use bevel or miter for inner join.
-			limit = nvg__maxf(1.01f, nvg__minf(p0->len, p1->len) * iw);
-			if ((dmr2 * limit*limit) < 1.0f)
-				p1->flags |= NVG_PR_INNERBEVEL;
-
-			// Check to see if the corner needs to be beveled.
-			if (p1->flags & NVG_PT_CORNER) {
-				if ((dmr2 * miterLimit*miterLimit) < 1.0f || lineJoin == NVG_BEVEL || lineJoin == NVG_ROUND) {
-					p1->flags |= NVG_PT_BEVEL;
-				}
-			}
-
-			if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0)
+			if ((pts[j].flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0)
 				path->nbevel++;
-
-			p0 = p1++;
 		}
 
 		path->convex = (nleft == path->count) ? 1 : 0;
@@ -1734,6 +2651,7 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 	float aa = fringe;//ctx->fringeWidth;
 	float u0 = 0.0f, u1 = 1.0f;
 	int ncap = nvg__curveDivs(w, NVG_PI, ctx->tessTol);	// Calculate divisions per half circle.
+	long long startTime = nvg__timeNs();
 
 	w += aa * 0.5f;
 
@@ -1777,6 +2695,7 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 
 		path->fill = 0;
 		path->nfill = 0;
+		path->triangulated = 0;
 
 		// Calculate fringe or stroke
 		loop = (path->closed == 0) ? 0 : 1;
@@ -1818,8 +2737,12 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 					dst = nvg__bevelJoin(dst, p0, p1, w, w, u0, u1, aa);
 				}
 			} else {
-				nvg__vset(dst, p1->x + (p1->dmx * w), p1->y + (p1->dmy * w), u0,1); dst++;
-				nvg__vset(dst, p1->x - (p1->dmx * w), p1->y - (p1->dmy * w), u1,1); dst++;
+#ifdef NVG_SSE2
+				if (ctx->simd)
+					dst = nvg__miterVertsSSE2(dst, p1, w, w, u0, u1);
+				else
+#endif
+				dst = nvg__miterVerts(dst, p1, w, w, u0, u1);
 			}
 			p0 = p1++;
 		}
@@ -1846,20 +2769,146 @@ static int nvg__expandStroke(NVGcontext* ctx, float w, float fringe, int lineCap
 		verts = dst;
 	}
 
+	ctx->stats.expandTime += nvg__timeNs() - startTime;
+	return 1;
+}
+
+// Returns 1 if segments ab and cd intersect or touch.
+static int nvg__segmentsIntersect(const NVGvertex* a, const NVGvertex* b, const NVGvertex* c, const NVGvertex* d)
+{
+	float d0 = nvg__triarea2(a->x,a->y, b->x,b->y, c->x,c->y);
+	float d1 = nvg__triarea2(a->x,a->y, b->x,b->y, d->x,d->y);
+	float d2 = nvg__triarea2(c->x,c->y, d->x,d->y, a->x,a->y);
+	float d3 = nvg__triarea2(c->x,c->y, d->x,d->y, b->x,b->y);
+
+	if ((d0 > 0.0f && d1 > 0.0f) || (d0 < 0.0f && d1 < 0.0f))
+		return 0;
+	if ((d2 > 0.0f && d3 > 0.0f) || (d2 < 0.0f && d3 < 0.0f))
+		return 0;
+	if (d0 == 0.0f && d1 == 0.0f) {
+		// Collinear, check if the extents overlap.
+		return nvg__minf(a->x, b->x) <= nvg__maxf(c->x, d->x) && nvg__minf(c->x, d->x) <= nvg__maxf(a->x, b->x) &&
+			nvg__minf(a->y, b->y) <= nvg__maxf(c->y, d->y) && nvg__minf(c->y, d->y) <= nvg__maxf(a->y, b->y);
+	}
+	return 1;
+}
+
+// Returns 1 if the polygon does not intersect or touch itself.
+static int nvg__polySimple(const NVGvertex* pts, int npts)
+{
+	int i, j;
+	for (i = 0; i < npts; i++) {
+		const NVGvertex* p0 = &pts[(i+npts-1) % npts];
+		const NVGvertex* p1 = &pts[i];
+		const NVGvertex* p2 = &pts[(i+1) % npts];
+		// Adjacent segments may only share the common point, reject spikes.
+		if (nvg__triarea2(p0->x,p0->y, p1->x,p1->y, p2->x,p2->y) == 0.0f &&
+			(p1->x - p0->x)*(p2->x - p1->x) + (p1->y - p0->y)*(p2->y - p1->y) <= 0.0f)
+			return 0;
+		for (j = i+2; j < npts; j++) {
+			if (i == 0 && j == npts-1)
+				continue;
+			if (nvg__segmentsIntersect(p1, p2, &pts[j], &pts[(j+1) % npts]))
+				return 0;
+		}
+	}
+	return 1;
+}
+
+// Returns 1 if the triangle abc of the remaining polygon contains no other polygon point.
+static int nvg__isEar(const NVGvertex* pts, const unsigned short* idx, int n, int ia, int ib, int ic)
+{
+	const NVGvertex* a = &pts[idx[ia]];
+	const NVGvertex* b = &pts[idx[ib]];
+	const NVGvertex* c = &pts[idx[ic]];
+	int i;
+	for (i = 0; i < n; i++) {
+		const NVGvertex* p = &pts[idx[i]];
+		if (i == ia || i == ib || i == ic)
+			continue;
+		if (nvg__triarea2(a->x,a->y, b->x,b->y, p->x,p->y) >= 0.0f &&
+			nvg__triarea2(b->x,b->y, c->x,c->y, p->x,p->y) >= 0.0f &&
+			nvg__triarea2(c->x,c->y, a->x,a->y, p->x,p->y) >= 0.0f)
+			return 0;
+	}
 	return 1;
 }
 
+// Triangulates a simple polygon with positive area using ear clipping. The triangles keep
+// the winding of the polygon so that they survive culling. Returns the number of vertices
+// written to dst, or 0 if the polygon cannot be triangulated.
+static int nvg__triangulatePoly(NVGvertex* dst, const NVGvertex* pts, int npts)
+{
+	unsigned short idx[NVG_MAX_TRIANGULATION];
+	float area = 0.0f;
+	int i, n = npts, nverts = 0, tries;
+
+	if (npts < 3 || npts > NVG_MAX_TRIANGULATION)
+		return 0;
+	for (i = 2; i < npts; i++)
+		area += nvg__triarea2(pts[0].x,pts[0].y, pts[i-1].x,pts[i-1].y, pts[i].x,pts[i].y);
+	if (area <= 0.0f || !nvg__polySimple(pts, npts))
+		return 0;
+
+	for (i = 0; i < npts; i++)
+		idx[i] = (unsigned short)i;
+
+	i = 0;
+	while (n > 3) {
+		for (tries = 0; tries < n; tries++) {
+			int ia = (i+n-1) % n, ic = (i+1) % n;
+			const NVGvertex* a = &pts[idx[ia]];
+			const NVGvertex* b = &pts[idx[i]];
+			const NVGvertex* c = &pts[idx[ic]];
+			float ear = nvg__triarea2(a->x,a->y, b->x,b->y, c->x,c->y);
+			if (ear > 0.0f && nvg__isEar(pts, idx, n, ia, i, ic)) {
+				dst[nverts++] = *a;
+				dst[nverts++] = *b;
+				dst[nverts++] = *c;
+				break;
+			}
+			// Points in the middle of a straight segment are dropped without a triangle.
+			if (ear == 0.0f && (b->x - a->x)*(c->x - b->x) + (b->y - a->y)*(c->y - b->y) > 0.0f)
+				break;
+			i = ic;
+		}
+		if (tries == n)
+			return 0;	// Numerical trouble, let the stencil handle it.
+		memmove(&idx[i], &idx[i+1], sizeof(unsigned short)*(n-i-1));
+		n--;
+		if (i == n) i = 0;
+	}
+
+	if (nvg__triarea2(pts[idx[0]].x,pts[idx[0]].y, pts[idx[1]].x,pts[idx[1]].y, pts[idx[2]].x,pts[idx[2]].y) > 0.0f) {
+		dst[nverts++] = pts[idx[0]];
+		dst[nverts++] = pts[idx[1]];
+		dst[nverts++] = pts[idx[2]];
+	}
+
+	return nverts;
+}
+
+static int nvg__fillTriCount(const NVGpath* path)
+{
+	return path->triangulated ? path->nfill/3 : path->nfill-2;
+}
+
 static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLimit)
 {
 	NVGpathCache* cache = ctx->cache;
 	NVGvertex* verts;
 	NVGvertex* dst;
-	int cverts, convex, i, j;
+	int cverts, convex, triangulate, i, j;
 	float aa = ctx->fringeWidth;
 	int fringe = w > 0.0f;
+	long long startTime = nvg__timeNs();
 
 	nvg__calculateJoins(ctx, w, lineJoin, miterLimit);
 
+	convex = cache->npaths == 1 && cache->paths[0].convex;
+	// Simple concave shapes are drawn like convex ones if the fill can be triangulated.
+	triangulate = cache->npaths == 1 && !convex && cache->paths[0].count <= ctx->triangulation;
+
 	// Calculate max vertex usage.
 	cverts = 0;
 	for (i = 0; i < cache->npaths; i++) {
@@ -1867,13 +2916,13 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 		cverts += path->count + path->nbevel + 1;
 		if (fringe)
 			cverts += (path->count + path->nbevel*5 + 1) * 2; // plus one for loop
+		if (triangulate)
+			cverts += (path->count + path->nbevel) * 3;
 	}
 
 	verts = nvg__allocTempVerts(ctx, cverts);
 	if (verts == NULL) return 0;
 
-	convex = cache->npaths == 1 && cache->paths[0].convex;
-
 	for (i = 0; i < cache->npaths; i++) {
 		NVGpath* path = &cache->paths[i];
 		NVGpoint* pts = &cache->points[path->first];
@@ -1924,6 +2973,17 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 		path->nfill = (int)(dst - verts);
 		verts = dst;
 
+		path->triangulated = 0;
+		if (triangulate) {
+			int n = nvg__triangulatePoly(verts, path->fill, path->nfill);
+			if (n > 0) {
+				path->fill = verts;
+				path->nfill = n;
+				path->triangulated = 1;
+				verts += n;
+			}
+		}
+
 		// Calculate fringe
 		if (fringe) {
 			lw = w + woff;
@@ -1934,7 +2994,8 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 			path->stroke = dst;
 
 			// Create only half a fringe for convex shapes so that
-			// the shape can be rendered without stenciling.
+			// the shape can be rendered without stenciling. The half fringe of a concave
+			// shape overlaps itself, triangulated shapes keep stenciling the full fringe.
 			if (convex) {
 				lw = woff;	// This should generate the same vertex as fill inset above.
 				lu = 0.5f;	// Set outline fade at middle.
@@ -1948,8 +3009,12 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 				if ((p1->flags & (NVG_PT_BEVEL | NVG_PR_INNERBEVEL)) != 0) {
 					dst = nvg__bevelJoin(dst, p0, p1, lw, rw, lu, ru, ctx->fringeWidth);
 				} else {
-					nvg__vset(dst, p1->x + (p1->dmx * lw), p1->y + (p1->dmy * lw), lu,1); dst++;
-					nvg__vset(dst, p1->x - (p1->dmx * rw), p1->y - (p1->dmy * rw), ru,1); dst++;
+#ifdef NVG_SSE2
+					if (ctx->simd)
+						dst = nvg__miterVertsSSE2(dst, p1, lw, rw, lu, ru);
+					else
+#endif
+					dst = nvg__miterVerts(dst, p1, lw, rw, lu, ru);
 				}
 				p0 = p1++;
 			}
@@ -1966,6 +3031,7 @@ static int nvg__expandFill(NVGcontext* ctx, float w, int lineJoin, float miterLi
 		}
 	}
 
+	ctx->stats.expandTime += nvg__timeNs() - startTime;
 	return 1;
 }
 
@@ -1997,13 +3063,8 @@ void nvgBezierTo(NVGcontext* ctx, float c1x, float c1y, float c2x, float c2y, fl
 
 void nvgQuadTo(NVGcontext* ctx, float cx, float cy, float x, float y)
 {
-    float x0 = ctx->commandx;
-    float y0 = ctx->commandy;
-    float vals[] = { NVG_BEZIERTO,
-        x0 + 2.0f/3.0f*(cx - x0), y0 + 2.0f/3.0f*(cy - y0),
-        x + 2.0f/3.0f*(cx - x), y + 2.0f/3.0f*(cy - y),
-        x, y };
-    nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
+	float vals[] = { NVG_QUADTO, cx, cy, x, y };
+	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 }
 
 void nvgArcTo(NVGcontext* ctx, float x1, float y1, float x2, float y2, float radius)
@@ -2076,11 +3137,7 @@ void nvgPathWinding(NVGcontext* ctx, int dir)
 
 void nvgArc(NVGcontext* ctx, float cx, float cy, float r, float a0, float a1, int dir)
 {
-	float a = 0, da = 0, hda = 0, kappa = 0;
-	float dx = 0, dy = 0, x = 0, y = 0, tanx = 0, tany = 0;
-	float px = 0, py = 0, ptanx = 0, ptany = 0;
-	float vals[3 + 5*7 + 100];
-	int i, ndivs, nvals;
+	float da = 0, a;
 	int move = ctx->ncommands > 0 ? NVG_LINETO : NVG_MOVETO;
 
 	// Clamp angles
@@ -2099,44 +3156,14 @@ void nvgArc(NVGcontext* ctx, float cx, float cy, float r, float a0, float a1, in
 		}
 	}
 
-	// Split arc into max 90 degree segments.
-	ndivs = nvg__maxi(1, nvg__mini((int)(nvg__absf(da) / (NVG_PI*0.5f) + 0.5f), 5));
-	hda = (da / (float)ndivs) / 2.0f;
-	kappa = nvg__absf(4.0f / 3.0f * (1.0f - nvg__cosf(hda)) / nvg__sinf(hda));
-
-	if (dir == NVG_CCW)
-		kappa = -kappa;
-
-	nvals = 0;
-	for (i = 0; i <= ndivs; i++) {
-		a = a0 + da * (i/(float)ndivs);
-		dx = nvg__cosf(a);
-		dy = nvg__sinf(a);
-		x = cx + dx*r;
-		y = cy + dy*r;
-		tanx = -dy*r*kappa;
-		tany = dx*r*kappa;
-
-		if (i == 0) {
-			vals[nvals++] = (float)move;
-			vals[nvals++] = x;
-			vals[nvals++] = y;
-		} else {
-			vals[nvals++] = NVG_BEZIERTO;
-			vals[nvals++] = px+ptanx;
-			vals[nvals++] = py+ptany;
-			vals[nvals++] = x-tanx;
-			vals[nvals++] = y-tany;
-			vals[nvals++] = x;
-			vals[nvals++] = y;
-		}
-		px = x;
-		py = y;
-		ptanx = tanx;
-		ptany = tany;
+	a = a0 + da;
+	{
+		float vals[] = {
+			(float)move, cx + nvg__cosf(a0)*r, cy + nvg__sinf(a0)*r,
+			NVG_ARCTO, cx, cy, r, 0, 0, r, a0, da, cx + nvg__cosf(a)*r, cy + nvg__sinf(a)*r
+		};
+		nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
 	}
-
-	nvg__appendCommands(ctx, vals, nvals);
 }
 
 void nvgRect(NVGcontext* ctx, float x, float y, float w, float h)
@@ -2171,13 +3198,13 @@ void nvgRoundedRectVarying(NVGcontext* ctx, float x, float y, float w, float h,
 		float vals[] = {
 			NVG_MOVETO, x, y + ryTL,
 			NVG_LINETO, x, y + h - ryBL,
-			NVG_BEZIERTO, x, y + h - ryBL*(1 - NVG_KAPPA90), x + rxBL*(1 - NVG_KAPPA90), y + h, x + rxBL, y + h,
+			NVG_ARCTO, x + rxBL, y + h - ryBL, rxBL, 0, 0, ryBL, NVG_PI, -NVG_PI*0.5f, x + rxBL, y + h,
 			NVG_LINETO, x + w - rxBR, y + h,
-			NVG_BEZIERTO, x + w - rxBR*(1 - NVG_KAPPA90), y + h, x + w, y + h - ryBR*(1 - NVG_KAPPA90), x + w, y + h - ryBR,
+			NVG_ARCTO, x + w - rxBR, y + h - ryBR, rxBR, 0, 0, ryBR, NVG_PI*0.5f, -NVG_PI*0.5f, x + w, y + h - ryBR,
 			NVG_LINETO, x + w, y + ryTR,
-			NVG_BEZIERTO, x + w, y + ryTR*(1 - NVG_KAPPA90), x + w - rxTR*(1 - NVG_KAPPA90), y, x + w - rxTR, y,
+			NVG_ARCTO, x + w - rxTR, y + ryTR, rxTR, 0, 0, ryTR, 0, -NVG_PI*0.5f, x + w - rxTR, y,
 			NVG_LINETO, x + rxTL, y,
-			NVG_BEZIERTO, x + rxTL*(1 - NVG_KAPPA90), y, x, y + ryTL*(1 - NVG_KAPPA90), x, y + ryTL,
+			NVG_ARCTO, x + rxTL, y + ryTL, rxTL, 0, 0, ryTL, -NVG_PI*0.5f, -NVG_PI*0.5f, x, y + ryTL,
 			NVG_CLOSE
 		};
 		nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
@@ -2188,10 +3215,7 @@ void nvgEllipse(NVGcontext* ctx, float cx, float cy, float rx, float ry)
 {
 	float vals[] = {
 		NVG_MOVETO, cx-rx, cy,
-		NVG_BEZIERTO, cx-rx, cy+ry*NVG_KAPPA90, cx-rx*NVG_KAPPA90, cy+ry, cx, cy+ry,
-		NVG_BEZIERTO, cx+rx*NVG_KAPPA90, cy+ry, cx+rx, cy+ry*NVG_KAPPA90, cx+rx, cy,
-		NVG_BEZIERTO, cx+rx, cy-ry*NVG_KAPPA90, cx+rx*NVG_KAPPA90, cy-ry, cx, cy-ry,
-		NVG_BEZIERTO, cx-rx*NVG_KAPPA90, cy-ry, cx-rx, cy-ry*NVG_KAPPA90, cx-rx, cy,
+		NVG_ARCTO, cx, cy, rx, 0, 0, ry, NVG_PI, -NVG_PI*2, cx-rx, cy,
 		NVG_CLOSE
 	};
 	nvg__appendCommands(ctx, vals, NVG_COUNTOF(vals));
@@ -2202,6 +3226,14 @@ void nvgCircle(NVGcontext* ctx, float cx, float cy, float r)
 	nvgEllipse(ctx, cx,cy, r,r);
 }
 
+void nvgDebugDisableSimd(NVGcontext* ctx, int disable)
+{
+	// Queued paths are expanded with the kernels they were drawn with.
+	nvg__flushDeferred(ctx);
+	ctx->simd = disable ? 0 : 1;
+	fonsDebugDisableSimd(ctx->fs, disable);
+}
+
 void nvgDebugDumpPathCache(NVGcontext* ctx)
 {
 	const NVGpath* path;
@@ -2224,125 +3256,822 @@ void nvgDebugDumpPathCache(NVGcontext* ctx)
 	}
 }
 
-void nvgFill(NVGcontext* ctx)
+static NVGdeferredCall* nvg__allocDeferredCall(NVGcontext* ctx)
 {
-	NVGstate* state = nvg__getState(ctx);
-	const NVGpath* path;
-	NVGpaint fillPaint = state->fill;
-	int i;
+	NVGdeferred* d = ctx->deferred;
+	NVGdeferredCall* calls;
+	NVGdeferredCall* call;
 
-	nvg__flattenPaths(ctx);
-	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
-		nvg__expandFill(ctx, ctx->fringeWidth, NVG_MITER, 2.4f);
-	else
-		nvg__expandFill(ctx, 0.0f, NVG_MITER, 2.4f);
+	calls = (NVGdeferredCall*)nvg__allocTransient(ctx, NVG_MEMORY_COMMANDS, d->calls, &d->ccalls, d->ncalls, 1, 0, sizeof(NVGdeferredCall));
+	if (calls == NULL) return NULL;
+	d->calls = calls;
 
-	// Apply global alpha
-	fillPaint.innerColor.a *= state->alpha;
-	fillPaint.outerColor.a *= state->alpha;
+	call = &d->calls[d->ncalls++];
+	memset(call, 0, sizeof(NVGdeferredCall));
+	return call;
+}
 
-	ctx->params.renderFill(ctx->params.userPtr, &fillPaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
-						   ctx->cache->bounds, ctx->cache->paths, ctx->cache->npaths);
+// Queues the current path to be tessellated when the deferred calls are flushed.
+static int nvg__deferPath(NVGcontext* ctx, int type, const NVGpaint* paint, float strokeWidth)
+{
+	NVGdeferred* d = ctx->deferred;
+	NVGstate* state = nvg__getState(ctx);
+	NVGdeferredCall* call;
+	float* commands;
 
-	// Count triangles
-	for (i = 0; i < ctx->cache->npaths; i++) {
-		path = &ctx->cache->paths[i];
-		ctx->fillTriCount += path->nfill-2;
-		ctx->fillTriCount += path->nstroke-2;
-		ctx->drawCallCount += 2;
-	}
+	commands = (float*)nvg__allocTransient(ctx, NVG_MEMORY_COMMANDS, d->commands, &d->ccommands, d->ncommands, ctx->ncommands, 0, sizeof(float));
+	if (commands == NULL) return 0;
+	d->commands = commands;
+
+	call = nvg__allocDeferredCall(ctx);
+	if (call == NULL) return 0;
+
+	call->type = type;
+	call->paint = *paint;
+	call->compositeOperation = state->compositeOperation;
+	call->scissor = state->scissor;
+	call->fringeWidth = ctx->fringeWidth;
+	call->fringe = (ctx->params.edgeAntiAlias && state->shapeAntiAlias) ? ctx->fringeWidth : 0.0f;
+	call->strokeWidth = strokeWidth;
+	call->miterLimit = state->miterLimit;
+	call->lineJoin = state->lineJoin;
+	call->lineCap = state->lineCap;
+	call->commandOffset = d->ncommands;
+	call->ncommands = ctx->ncommands;
+
+	memcpy(&d->commands[d->ncommands], ctx->commands, sizeof(float)*ctx->ncommands);
+	d->ncommands += ctx->ncommands;
+
+	return 1;
 }
 
-void nvgStroke(NVGcontext* ctx)
+static int nvg__deferTriangles(NVGcontext* ctx, const NVGpaint* paint, const NVGvertex* verts, int nverts)
 {
+	NVGdeferred* d = ctx->deferred;
 	NVGstate* state = nvg__getState(ctx);
-	float scale = nvg__getAverageScale(state->xform);
-	float strokeWidth = nvg__clampf(state->strokeWidth * scale, 0.0f, 200.0f);
-	NVGpaint strokePaint = state->stroke;
-	const NVGpath* path;
-	int i;
+	NVGdeferredCall* call;
+	NVGvertex* dverts;
 
+	dverts = (NVGvertex*)nvg__allocTransient(ctx, NVG_MEMORY_PATHCACHE, d->verts, &d->cverts, d->nverts, nverts, 0, sizeof(NVGvertex));
+	if (dverts == NULL) return 0;
+	d->verts = dverts;
 
-	if (strokeWidth < ctx->fringeWidth) {
-		// If the stroke width is less than pixel size, use alpha to emulate coverage.
-		// Since coverage is area, scale by alpha*alpha.
-		float alpha = nvg__clampf(strokeWidth / ctx->fringeWidth, 0.0f, 1.0f);
-		strokePaint.innerColor.a *= alpha*alpha;
-		strokePaint.outerColor.a *= alpha*alpha;
-		strokeWidth = ctx->fringeWidth;
-	}
+	call = nvg__allocDeferredCall(ctx);
+	if (call == NULL) return 0;
 
-	// Apply global alpha
-	strokePaint.innerColor.a *= state->alpha;
-	strokePaint.outerColor.a *= state->alpha;
+	call->type = NVG_DEFER_TRIANGLES;
+	call->paint = *paint;
+	call->compositeOperation = state->compositeOperation;
+	call->scissor = state->scissor;
+	call->fringeWidth = ctx->fringeWidth;
+	call->vertOffset = d->nverts;
+	call->nverts = nverts;
 
-	nvg__flattenPaths(ctx);
+	memcpy(&d->verts[d->nverts], verts, sizeof(NVGvertex)*nverts);
+	d->nverts += nverts;
 
-	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
-		nvg__expandStroke(ctx, strokeWidth*0.5f, ctx->fringeWidth, state->lineCap, state->lineJoin, state->miterLimit);
-	else
-		nvg__expandStroke(ctx, strokeWidth*0.5f, 0.0f, state->lineCap, state->lineJoin, state->miterLimit);
+	return 1;
+}
 
-	ctx->params.renderStroke(ctx->params.userPtr, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
-							 strokeWidth, ctx->cache->paths, ctx->cache->npaths);
+// Copies the expanded paths of a call to the worker output. The vertex pointers of the paths
+// are set when the call is submitted since the output may be reallocated.
+static int nvg__storeDeferredGeometry(NVGworker* w, NVGdeferredCall* call)
+{
+	NVGpathCache* cache = w->ctx->cache;
+	int i, nverts = 0;
 
-	// Count triangles
-	for (i = 0; i < ctx->cache->npaths; i++) {
-		path = &ctx->cache->paths[i];
-		ctx->strokeTriCount += path->nstroke-2;
-		ctx->drawCallCount++;
+	for (i = 0; i < cache->npaths; i++)
+		nverts += cache->paths[i].nfill + cache->paths[i].nstroke;
+
+	if (w->npaths+cache->npaths > w->cpaths) {
+		NVGpath* paths;
+		int cpaths = w->npaths+cache->npaths + w->cpaths/2;
+		paths = (NVGpath*)nvgInternalRealloc(w->ctx->params.allocator, NVG_MEMORY_PATHCACHE, w->paths, sizeof(NVGpath)*cpaths);
+		if (paths == NULL) return 0;
+		w->paths = paths;
+		w->cpaths = cpaths;
+	}
+	if (w->nverts+nverts > w->cverts) {
+		NVGvertex* verts;
+		int cverts = w->nverts+nverts + w->cverts/2;
+		verts = (NVGvertex*)nvgInternalRealloc(w->ctx->params.allocator, NVG_MEMORY_PATHCACHE, w->verts, sizeof(NVGvertex)*cverts);
+		if (verts == NULL) return 0;
+		w->verts = verts;
+		w->cverts = cverts;
 	}
-}
 
-// Add fonts
-int nvgCreateFont(NVGcontext* ctx, const char* name, const char* filename)
-{
-	return fonsAddFont(ctx->fs, name, filename, 0);
-}
+	call->pathOffset = w->npaths;
+	call->npaths = cache->npaths;
+	call->vertOffset = w->nverts;
+	call->nverts = nverts;
+	memcpy(call->bounds, cache->bounds, sizeof(call->bounds));
 
-int nvgCreateFontAtIndex(NVGcontext* ctx, const char* name, const char* filename, const int fontIndex)
-{
-	return fonsAddFont(ctx->fs, name, filename, fontIndex);
-}
+	for (i = 0; i < cache->npaths; i++) {
+		NVGpath* path = &cache->paths[i];
+		w->paths[w->npaths++] = *path;
+		if (path->nfill > 0)
+			memcpy(&w->verts[w->nverts], path->fill, sizeof(NVGvertex)*path->nfill);
+		w->nverts += path->nfill;
+		if (path->nstroke > 0)
+			memcpy(&w->verts[w->nverts], path->stroke, sizeof(NVGvertex)*path->nstroke);
+		w->nverts += path->nstroke;
+	}
 
-int nvgCreateFontMem(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData)
-{
-	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, 0);
+	return 1;
 }
 
-int nvgCreateFontMemAtIndex(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData, const int fontIndex)
+// Task run by each worker, may be called concurrently from different threads.
+static void nvg__tessellateDeferred(void* taskPtr, int index)
 {
-	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, fontIndex);
-}
+	NVGdeferred* d = (NVGdeferred*)taskPtr;
+	NVGworker* w = &d->workers[index];
+	NVGcontext* wctx = w->ctx;
+	int i, ret;
 
-int nvgFindFont(NVGcontext* ctx, const char* name)
-{
-	if (name == NULL) return -1;
-	return fonsGetFontByName(ctx->fs, name);
-}
+	w->npaths = 0;
+	w->nverts = 0;
 
+	// Interleave the calls between the workers to spread complex paths evenly.
+	for (i = index; i < d->ncalls; i += d->ntasks) {
+		NVGdeferredCall* call = &d->calls[i];
+		if (call->type == NVG_DEFER_TRIANGLES)
+			continue;
 
-int nvgAddFallbackFontId(NVGcontext* ctx, int baseFont, int fallbackFont)
-{
-	if(baseFont == -1 || fallbackFont == -1) return 0;
-	return fonsAddFallbackFont(ctx->fs, baseFont, fallbackFont);
-}
+		wctx->commands = &d->commands[call->commandOffset];
+		wctx->ncommands = call->ncommands;
+		nvg__clearPathCache(wctx);
+		nvg__flattenPaths(wctx);
+		if (call->type == NVG_DEFER_FILL)
+			ret = nvg__expandFill(wctx, call->fringe, NVG_MITER, 2.4f);
+		else
+			ret = nvg__expandStroke(wctx, call->strokeWidth*0.5f, call->fringe, call->lineCap, call->lineJoin, call->miterLimit);
 
-int nvgAddFallbackFont(NVGcontext* ctx, const char* baseFont, const char* fallbackFont)
-{
-	return nvgAddFallbackFontId(ctx, nvgFindFont(ctx, baseFont), nvgFindFont(ctx, fallbackFont));
-}
+		call->worker = index;
+		if (ret == 0 || nvg__storeDeferredGeometry(w, call) == 0)
+			call->npaths = 0;
+	}
 
-void nvgResetFallbackFontsId(NVGcontext* ctx, int baseFont)
-{
-	fonsResetFallbackFont(ctx->fs, baseFont);
+	wctx->commands = NULL;
+	wctx->ncommands = 0;
 }
 
-void nvgResetFallbackFonts(NVGcontext* ctx, const char* baseFont)
+static void nvg__submitDeferred(NVGcontext* ctx, NVGdeferredCall* call)
+{
+	NVGdeferred* d = ctx->deferred;
+	NVGpath* paths;
+	NVGvertex* verts;
+	int i;
+
+	if (call->type == NVG_DEFER_TRIANGLES) {
+		ctx->params.renderTriangles(ctx->params.userPtr, &call->paint, call->compositeOperation, &call->scissor,
+									&d->verts[call->vertOffset], call->nverts, call->fringeWidth);
+		ctx->drawCallCount++;
+		ctx->textTriCount += call->nverts/3;
+		return;
+	}
+
+	if (call->npaths == 0)
+		return;
+
+	paths = &d->workers[call->worker].paths[call->pathOffset];
+	verts = &d->workers[call->worker].verts[call->vertOffset];
+	for (i = 0; i < call->npaths; i++) {
+		paths[i].fill = verts;
+		verts += paths[i].nfill;
+		paths[i].stroke = verts;
+		verts += paths[i].nstroke;
+	}
+
+	if (call->type == NVG_DEFER_FILL) {
+		ctx->params.renderFill(ctx->params.userPtr, &call->paint, call->compositeOperation, &call->scissor, call->fringeWidth,
+							   call->bounds, paths, call->npaths);
+		for (i = 0; i < call->npaths; i++) {
+			ctx->fillTriCount += nvg__fillTriCount(&paths[i]);
+			ctx->fillTriCount += paths[i].nstroke-2;
+			ctx->drawCallCount += 2;
+		}
+	} else {
+		ctx->params.renderStroke(ctx->params.userPtr, &call->paint, call->compositeOperation, &call->scissor, call->fringeWidth,
+								 call->strokeWidth, paths, call->npaths);
+		for (i = 0; i < call->npaths; i++) {
+			ctx->strokeTriCount += paths[i].nstroke-2;
+			ctx->drawCallCount++;
+		}
+	}
+}
+
+// Tessellates the queued paths in parallel and submits all queued calls in order.
+static void nvg__flushDeferred(NVGcontext* ctx)
+{
+	NVGdeferred* d = ctx->deferred;
+	int i;
+
+	if (d == NULL || d->ncalls == 0)
+		return;
+
+	d->ntasks = nvg__mini(d->nworkers, d->ncalls);
+	for (i = 0; i < d->ntasks; i++) {
+		NVGcontext* wctx = d->workers[i].ctx;
+		wctx->tessTol = ctx->tessTol;
+		wctx->distTol = ctx->distTol;
+		wctx->flattening = ctx->flattening;
+		wctx->simd = ctx->simd;
+		wctx->triangulation = ctx->triangulation;
+		wctx->fringeWidth = ctx->fringeWidth;
+	}
+
+	if (d->runner != NULL && d->ntasks > 1) {
+		d->runner(d->userPtr, nvg__tessellateDeferred, d, d->ntasks);
+	} else {
+		for (i = 0; i < d->ntasks; i++)
+			nvg__tessellateDeferred(d, i);
+	}
+
+	// Collect the statistics of the workers.
+	for (i = 0; i < d->ntasks; i++) {
+		NVGframeStats* wstats = &d->workers[i].ctx->stats;
+		ctx->stats.points += wstats->points;
+		ctx->stats.bezierSubdivisions += wstats->bezierSubdivisions;
+		ctx->stats.vertexBytes += wstats->vertexBytes;
+		ctx->stats.flattenTime += wstats->flattenTime;
+		ctx->stats.expandTime += wstats->expandTime;
+		memset(wstats, 0, sizeof(*wstats));
+	}
+
+	for (i = 0; i < d->ncalls; i++)
+		nvg__submitDeferred(ctx, &d->calls[i]);
+
+	nvg__clearDeferred(d);
+}
+
+void nvgTessellationWorkers(NVGcontext* ctx, int nworkers, NVGtaskRunner runner, void* userPtr)
+{
+	nvg__flushDeferred(ctx);
+	nvg__deleteDeferred(ctx, ctx->deferred);
+	ctx->deferred = NULL;
+
+	if (nworkers <= 0)
+		return;
+
+	ctx->deferred = nvg__allocDeferred(ctx, nworkers);
+	if (ctx->deferred == NULL)
+		return;
+	ctx->deferred->runner = runner;
+	ctx->deferred->userPtr = userPtr;
+}
+
+void nvgCurveFlattening(NVGcontext* ctx, int method)
+{
+	// Queued paths are flattened with the method they were drawn with.
+	nvg__flushDeferred(ctx);
+	ctx->flattening = method;
+	nvg__clearPathCache(ctx);
+}
+
+void nvgFillTriangulation(NVGcontext* ctx, int maxPoints)
+{
+	// Queued paths are expanded with the cutoff they were drawn with.
+	nvg__flushDeferred(ctx);
+	ctx->triangulation = ctx->params.triangulatedFills ? nvg__clampi(maxPoints, 0, NVG_MAX_TRIANGULATION) : 0;
+	nvg__clearPathCache(ctx);
+}
+
+void nvgFill(NVGcontext* ctx)
+{
+	NVGstate* state = nvg__getState(ctx);
+	const NVGpath* path;
+	NVGpaint fillPaint = state->fill;
+	int i;
+
+	// Apply global alpha
+	fillPaint.innerColor.a *= state->alpha;
+	fillPaint.outerColor.a *= state->alpha;
+
+	if (ctx->deferred != NULL) {
+		if (nvg__deferPath(ctx, NVG_DEFER_FILL, &fillPaint, 0.0f))
+			return;
+		nvg__flushDeferred(ctx);
+	}
+
+	nvg__flattenPaths(ctx);
+	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
+		nvg__expandFill(ctx, ctx->fringeWidth, NVG_MITER, 2.4f);
+	else
+		nvg__expandFill(ctx, 0.0f, NVG_MITER, 2.4f);
+
+	ctx->params.renderFill(ctx->params.userPtr, &fillPaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+						   ctx->cache->bounds, ctx->cache->paths, ctx->cache->npaths);
+
+	// Count triangles
+	for (i = 0; i < ctx->cache->npaths; i++) {
+		path = &ctx->cache->paths[i];
+		ctx->fillTriCount += nvg__fillTriCount(path);
+		ctx->fillTriCount += path->nstroke-2;
+		ctx->drawCallCount += 2;
+	}
+}
+
+void nvgStroke(NVGcontext* ctx)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float scale = nvg__getAverageScale(state->xform);
+	float strokeWidth = nvg__clampf(state->strokeWidth * scale, 0.0f, 200.0f);
+	NVGpaint strokePaint = state->stroke;
+	const NVGpath* path;
+	int i;
+
+
+	if (strokeWidth < ctx->fringeWidth) {
+		// If the stroke width is less than pixel size, use alpha to emulate coverage.
+		// Since coverage is area, scale by alpha*alpha.
+		float alpha = nvg__clampf(strokeWidth / ctx->fringeWidth, 0.0f, 1.0f);
+		strokePaint.innerColor.a *= alpha*alpha;
+		strokePaint.outerColor.a *= alpha*alpha;
+		strokeWidth = ctx->fringeWidth;
+	}
+
+	// Apply global alpha
+	strokePaint.innerColor.a *= state->alpha;
+	strokePaint.outerColor.a *= state->alpha;
+
+	if (ctx->deferred != NULL) {
+		if (nvg__deferPath(ctx, NVG_DEFER_STROKE, &strokePaint, strokeWidth))
+			return;
+		nvg__flushDeferred(ctx);
+	}
+
+	nvg__flattenPaths(ctx);
+
+	if (ctx->params.edgeAntiAlias && state->shapeAntiAlias)
+		nvg__expandStroke(ctx, strokeWidth*0.5f, ctx->fringeWidth, state->lineCap, state->lineJoin, state->miterLimit);
+	else
+		nvg__expandStroke(ctx, strokeWidth*0.5f, 0.0f, state->lineCap, state->lineJoin, state->miterLimit);
+
+	ctx->params.renderStroke(ctx->params.userPtr, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+							 strokeWidth, ctx->cache->paths, ctx->cache->npaths);
+
+	// Count triangles
+	for (i = 0; i < ctx->cache->npaths; i++) {
+		path = &ctx->cache->paths[i];
+		ctx->strokeTriCount += path->nstroke-2;
+		ctx->drawCallCount++;
+	}
+}
+
+// Path objects
+static void nvg__clearPathMesh(NVGpathMesh* mesh)
+{
+	nvgInternalFree(mesh->paths);
+	nvgInternalFree(mesh->verts);
+	memset(mesh, 0, sizeof(*mesh));
+}
+
+NVGpathObject* nvgCreatePathObject(NVGcontext* ctx)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGpathObject* obj;
+	float inv[6];
+	int n = nvg__maxi(ctx->ncommands, 1);
+
+	obj = (NVGpathObject*)nvgInternalAlloc(ctx->params.allocator, NVG_MEMORY_COMMANDS, sizeof(NVGpathObject));
+	if (obj == NULL) goto error;
+	memset(obj, 0, sizeof(NVGpathObject));
+
+	obj->commands = (float*)nvgInternalAlloc(ctx->params.allocator, NVG_MEMORY_COMMANDS, sizeof(float)*n);
+	if (obj->commands == NULL) goto error;
+	obj->tcommands = (float*)nvgInternalAlloc(ctx->params.allocator, NVG_MEMORY_COMMANDS, sizeof(float)*n);
+	if (obj->tcommands == NULL) goto error;
+
+	// Store the commands relative to the current transform.
+	if (ctx->ncommands > 0)
+		memcpy(obj->commands, ctx->commands, sizeof(float)*ctx->ncommands);
+	obj->ncommands = ctx->ncommands;
+	nvgTransformInverse(inv, state->xform);
+	nvg__transformCommands(obj->commands, obj->ncommands, inv);
+
+	return obj;
+
+error:
+	nvgDeletePathObject(ctx, obj);
+	return NULL;
+}
+
+void nvgDeletePathObject(NVGcontext* ctx, NVGpathObject* obj)
+{
+	NVG_NOTUSED(ctx);
+	if (obj == NULL) return;
+	nvg__clearPathMesh(&obj->fill);
+	nvg__clearPathMesh(&obj->stroke);
+	nvgInternalFree(obj->commands);
+	nvgInternalFree(obj->tcommands);
+	nvgInternalFree(obj);
+}
+
+static int nvg__pathStyleEquals(const NVGpathStyle* a, const NVGpathStyle* b)
+{
+	return a->strokeWidth == b->strokeWidth && a->fringeWidth == b->fringeWidth &&
+		a->miterLimit == b->miterLimit && a->lineCap == b->lineCap &&
+		a->lineJoin == b->lineJoin && a->antiAlias == b->antiAlias;
+}
+
+// Calculates transform from the cached geometry to the current transform.
+// Returns 0 if the change is too large and the geometry needs to be tessellated again.
+static int nvg__pathMeshTransform(float* t, const float* cached, const float* xform)
+{
+	float sx, sy, skew;
+
+	if (cached[0] == xform[0] && cached[1] == xform[1] && cached[2] == xform[2] && cached[3] == xform[3]) {
+		nvgTransformTranslate(t, xform[4] - cached[4], xform[5] - cached[5]);
+		return 1;
+	}
+
+	if (nvgTransformInverse(t, cached) == 0) return 0;
+	nvgTransformMultiply(t, xform);
+
+	// Allow rotation and small uniform scaling, mirroring would flip the triangle winding.
+	if (t[0]*t[3] - t[2]*t[1] <= 0.0f) return 0;
+	sx = nvg__sqrtf(t[0]*t[0] + t[1]*t[1]);
+	sy = nvg__sqrtf(t[2]*t[2] + t[3]*t[3]);
+	skew = (t[0]*t[2] + t[1]*t[3]) / (sx*sy);
+	return nvg__absf(sx - 1.0f) < NVG_PATHOBJECT_SCALE_TOL &&
+		nvg__absf(sy - 1.0f) < NVG_PATHOBJECT_SCALE_TOL &&
+		nvg__absf(skew) < NVG_PATHOBJECT_SCALE_TOL;
+}
+
+static int nvg__storePathMesh(NVGcontext* ctx, NVGpathMesh* mesh, NVGpathCache* cache)
+{
+	NVGpath* paths;
+	NVGvertex* verts;
+	int i, nverts = 0;
+
+	for (i = 0; i < cache->npaths; i++)
+		nverts += cache->paths[i].nfill + cache->paths[i].nstroke;
+
+	paths = (NVGpath*)nvgInternalRealloc(ctx->params.allocator, NVG_MEMORY_PATHCACHE, mesh->paths, sizeof(NVGpath)*nvg__maxi(cache->npaths*2, 1));
+	if (paths == NULL) return 0;
+	mesh->paths = paths;
+	verts = (NVGvertex*)nvgInternalRealloc(ctx->params.allocator, NVG_MEMORY_PATHCACHE, mesh->verts, sizeof(NVGvertex)*nvg__maxi(nverts, 1));
+	if (verts == NULL) return 0;
+	mesh->verts = verts;
+
+	for (i = 0; i < cache->npaths; i++) {
+		NVGpath* path = &paths[i];
+		*path = cache->paths[i];
+		if (path->nfill > 0)
+			memcpy(verts, path->fill, sizeof(NVGvertex)*path->nfill);
+		path->fill = verts;
+		verts += path->nfill;
+		if (path->nstroke > 0)
+			memcpy(verts, path->stroke, sizeof(NVGvertex)*path->nstroke);
+		path->stroke = verts;
+		verts += path->nstroke;
+	}
+	mesh->npaths = cache->npaths;
+	mesh->nverts = nverts;
+	memcpy(mesh->bounds, cache->bounds, sizeof(mesh->bounds));
+
+	return 1;
+}
+
+static int nvg__tessellatePathMesh(NVGcontext* ctx, NVGpathObject* obj, NVGpathMesh* mesh,
+								   const NVGpathStyle* style, int stroke, float strokeWidth)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float* commands = ctx->commands;
+	int ncommands = ctx->ncommands;
+	float fringe = style->antiAlias ? style->fringeWidth : 0.0f;
+	int ret;
+
+	// Flatten and expand the object in place of the current path.
+	memcpy(obj->tcommands, obj->commands, sizeof(float)*obj->ncommands);
+	nvg__transformCommands(obj->tcommands, obj->ncommands, state->xform);
+	ctx->commands = obj->tcommands;
+	ctx->ncommands = obj->ncommands;
+
+	nvg__clearPathCache(ctx);
+	nvg__flattenPaths(ctx);
+	if (stroke)
+		ret = nvg__expandStroke(ctx, strokeWidth*0.5f, fringe, style->lineCap, style->lineJoin, style->miterLimit);
+	else
+		ret = nvg__expandFill(ctx, fringe, style->lineJoin, style->miterLimit);
+	if (ret)
+		ret = nvg__storePathMesh(ctx, mesh, ctx->cache);
+
+	// The current path needs to be flattened again.
+	ctx->commands = commands;
+	ctx->ncommands = ncommands;
+	nvg__clearPathCache(ctx);
+
+	mesh->valid = ret;
+	mesh->style = *style;
+	memcpy(mesh->xform, state->xform, sizeof(mesh->xform));
+
+	return ret;
+}
+
+// Returns the path object geometry for the current transform.
+static const NVGpath* nvg__pathObjectGeometry(NVGcontext* ctx, NVGpathObject* obj, NVGpathMesh* mesh,
+											  const NVGpathStyle* style, int stroke, float strokeWidth, float* bounds)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGpath* paths;
+	NVGvertex* dst;
+	float t[6];
+	int i, j;
+
+	if (!mesh->valid || !nvg__pathStyleEquals(&mesh->style, style) ||
+		!nvg__pathMeshTransform(t, mesh->xform, state->xform)) {
+		if (nvg__tessellatePathMesh(ctx, obj, mesh, style, stroke, strokeWidth) == 0)
+			return NULL;
+		nvgTransformIdentity(t);
+	}
+
+	if (mesh->npaths == 0 || (t[0] == 1.0f && t[1] == 0.0f && t[2] == 0.0f && t[3] == 1.0f && t[4] == 0.0f && t[5] == 0.0f)) {
+		memcpy(bounds, mesh->bounds, sizeof(float)*4);
+		return mesh->paths;
+	}
+
+	dst = nvg__allocTempVerts(ctx, mesh->nverts);
+	if (dst == NULL) return NULL;
+
+	paths = &mesh->paths[mesh->npaths];
+	for (i = 0; i < mesh->npaths; i++) {
+		const NVGpath* src = &mesh->paths[i];
+		NVGpath* path = &paths[i];
+		*path = *src;
+		path->fill = dst;
+		memcpy(dst, src->fill, sizeof(NVGvertex)*src->nfill);
+		dst += src->nfill;
+		path->stroke = dst;
+		memcpy(dst, src->stroke, sizeof(NVGvertex)*src->nstroke);
+		dst += src->nstroke;
+	}
+
+	dst = paths[0].fill;
+	if (t[0] == 1.0f && t[1] == 0.0f && t[2] == 0.0f && t[3] == 1.0f) {
+		// Pure translation
+		for (j = 0; j < mesh->nverts; j++) {
+			dst[j].x += t[4];
+			dst[j].y += t[5];
+		}
+		bounds[0] = mesh->bounds[0] + t[4];
+		bounds[1] = mesh->bounds[1] + t[5];
+		bounds[2] = mesh->bounds[2] + t[4];
+		bounds[3] = mesh->bounds[3] + t[5];
+	} else {
+		float x, y;
+		for (j = 0; j < mesh->nverts; j++)
+			nvgTransformPoint(&dst[j].x, &dst[j].y, t, dst[j].x, dst[j].y);
+		bounds[0] = bounds[1] = 1e6f;
+		bounds[2] = bounds[3] = -1e6f;
+		for (j = 0; j < 4; j++) {
+			nvgTransformPoint(&x, &y, t, mesh->bounds[(j & 1) ? 2 : 0], mesh->bounds[(j & 2) ? 3 : 1]);
+			bounds[0] = nvg__minf(bounds[0], x);
+			bounds[1] = nvg__minf(bounds[1], y);
+			bounds[2] = nvg__maxf(bounds[2], x);
+			bounds[3] = nvg__maxf(bounds[3], y);
+		}
+	}
+
+	return paths;
+}
+
+void nvgFillPathObject(NVGcontext* ctx, NVGpathObject* obj)
+{
+	NVGstate* state = nvg__getState(ctx);
+	NVGpaint fillPaint = state->fill;
+	NVGpathStyle style;
+	const NVGpath* paths;
+	float bounds[4];
+	int i;
+
+	if (obj == NULL) return;
+
+	// Keep the draw order with queued paths.
+	nvg__flushDeferred(ctx);
+
+	memset(&style, 0, sizeof(style));
+	style.fringeWidth = ctx->fringeWidth;
+	style.miterLimit = 2.4f;
+	style.lineJoin = NVG_MITER;
+	style.antiAlias = ctx->params.edgeAntiAlias && state->shapeAntiAlias;
+
+	paths = nvg__pathObjectGeometry(ctx, obj, &obj->fill, &style, 0, 0.0f, bounds);
+	if (paths == NULL) return;
+
+	// Apply global alpha
+	fillPaint.innerColor.a *= state->alpha;
+	fillPaint.outerColor.a *= state->alpha;
+
+	ctx->params.renderFill(ctx->params.userPtr, &fillPaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+						   bounds, paths, obj->fill.npaths);
+
+	// Count triangles
+	for (i = 0; i < obj->fill.npaths; i++) {
+		ctx->fillTriCount += nvg__fillTriCount(&paths[i]);
+		ctx->fillTriCount += paths[i].nstroke-2;
+		ctx->drawCallCount += 2;
+	}
+}
+
+void nvgStrokePathObject(NVGcontext* ctx, NVGpathObject* obj)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float scale = nvg__getAverageScale(state->xform);
+	float strokeWidth = nvg__clampf(state->strokeWidth * scale, 0.0f, 200.0f);
+	NVGpaint strokePaint = state->stroke;
+	NVGpathStyle style;
+	const NVGpath* paths;
+	float bounds[4];
+	int i;
+
+	if (obj == NULL) return;
+
+	// Keep the draw order with queued paths.
+	nvg__flushDeferred(ctx);
+
+	if (strokeWidth < ctx->fringeWidth) {
+		// If the stroke width is less than pixel size, use alpha to emulate coverage.
+		// Since coverage is area, scale by alpha*alpha.
+		float alpha = nvg__clampf(strokeWidth / ctx->fringeWidth, 0.0f, 1.0f);
+		strokePaint.innerColor.a *= alpha*alpha;
+		strokePaint.outerColor.a *= alpha*alpha;
+		strokeWidth = ctx->fringeWidth;
+	}
+
+	// Apply global alpha
+	strokePaint.innerColor.a *= state->alpha;
+	strokePaint.outerColor.a *= state->alpha;
+
+	style.strokeWidth = state->strokeWidth;
+	style.fringeWidth = ctx->fringeWidth;
+	style.miterLimit = state->miterLimit;
+	style.lineCap = state->lineCap;
+	style.lineJoin = state->lineJoin;
+	style.antiAlias = ctx->params.edgeAntiAlias && state->shapeAntiAlias;
+
+	paths = nvg__pathObjectGeometry(ctx, obj, &obj->stroke, &style, 1, strokeWidth, bounds);
+	if (paths == NULL) return;
+
+	ctx->params.renderStroke(ctx->params.userPtr, &strokePaint, state->compositeOperation, &state->scissor, ctx->fringeWidth,
+							 strokeWidth, paths, obj->stroke.npaths);
+
+	// Count triangles
+	for (i = 0; i < obj->stroke.npaths; i++) {
+		ctx->strokeTriCount += paths[i].nstroke-2;
+		ctx->drawCallCount++;
+	}
+}
+
+// Add fonts
+int nvgCreateFont(NVGcontext* ctx, const char* name, const char* filename)
+{
+	return fonsAddFont(ctx->fs, name, filename, 0);
+}
+
+int nvgCreateFontAtIndex(NVGcontext* ctx, const char* name, const char* filename, const int fontIndex)
+{
+	return fonsAddFont(ctx->fs, name, filename, fontIndex);
+}
+
+int nvgCreateFontMem(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData)
+{
+	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, 0);
+}
+
+int nvgCreateFontMemAtIndex(NVGcontext* ctx, const char* name, unsigned char* data, int ndata, int freeData, const int fontIndex)
+{
+	return fonsAddFontMem(ctx->fs, name, data, ndata, freeData, fontIndex);
+}
+
+int nvgFindFont(NVGcontext* ctx, const char* name)
+{
+	if (name == NULL) return -1;
+	return fonsGetFontByName(ctx->fs, name);
+}
+
+
+int nvgAddFallbackFontId(NVGcontext* ctx, int baseFont, int fallbackFont)
+{
+	if(baseFont == -1 || fallbackFont == -1) return 0;
+	return fonsAddFallbackFont(ctx->fs, baseFont, fallbackFont);
+}
+
+int nvgAddFallbackFont(NVGcontext* ctx, const char* baseFont, const char* fallbackFont)
+{
+	return nvgAddFallbackFontId(ctx, nvgFindFont(ctx, baseFont), nvgFindFont(ctx, fallbackFont));
+}
+
+void nvgResetFallbackFontsId(NVGcontext* ctx, int baseFont)
+{
+	fonsResetFallbackFont(ctx->fs, baseFont);
+}
+
+void nvgResetFallbackFonts(NVGcontext* ctx, const char* baseFont)
 {
 	nvgResetFallbackFontsId(ctx, nvgFindFont(ctx, baseFont));
 }
 
+void nvgGlyphWorkers(NVGcontext* ctx, int nworkers, NVGtaskRunner runner, void* userPtr)
+{
+	fonsSetRasterizeWorkers(ctx->fs, nworkers, runner, userPtr);
+}
+
+// Grows the atlas when it is full, fontstash tries to add the glyph again before evicting old glyphs.
+static void nvg__growTextAtlas(void* uptr, int error, int val)
+{
+	NVG_NOTUSED(val);
+	if (error == FONS_ATLAS_FULL)
+		nvg__allocTextAtlas((NVGcontext*)uptr);
+}
+
+int nvgWarmGlyphs(NVGcontext* ctx, int font, const float* sizes, int nsizes, const unsigned int* ranges, int nranges)
+{
+	NVGstate* state = nvg__getState(ctx);
+	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
+	unsigned int first, last;
+	int i, j, ret = 1;
+
+	if (font < 0) return 0;
+	// Glyphs smaller than 0.2 pixels are not created, the size is stored in tenths of a pixel in a short.
+	for (i = 0; i < nsizes; i++) {
+		if (!(sizes[i] >= 0.2f && sizes[i] <= 3276.0f))
+			return 0;
+	}
+
+	fonsSetFont(ctx->fs, font);
+	// Same blur as nvgText(), the glyphs are looked up with it.
+	fonsSetBlur(ctx->fs, state->fontBlur*scale);
+	fonsSetErrorCallback(ctx->fs, nvg__growTextAtlas, ctx);
+	for (i = 0; i < nsizes && ret; i++) {
+		fonsSetSize(ctx->fs, sizes[i]);
+		for (j = 0; j < nranges && ret; j++) {
+			first = ranges[j*2];
+			last = ranges[j*2+1] < 0x10ffff ? ranges[j*2+1] : 0x10ffff;
+			// Stops short only if the atlas can not grow and no glyph can be evicted, or out of memory.
+			if (first <= last && fonsPrepareGlyphs(ctx->fs, first, last) <= (int)(last - first))
+				ret = 0;
+		}
+	}
+	fonsSetErrorCallback(ctx->fs, NULL, NULL);
+	return ret;
+}
+
+int nvgSaveFontAtlas(NVGcontext* ctx, unsigned char* data, int size)
+{
+	return fonsSaveSnapshot(ctx->fs, data, size);
+}
+
+int nvgLoadFontAtlas(NVGcontext* ctx, const unsigned char* data, int size)
+{
+	int images[NVG_MAX_FONTIMAGES];
+	int i, w, h, npages, n;
+
+	if (!fonsGetSnapshotInfo(ctx->fs, data, size, &w, &h, &npages))
+		return 0;
+	if (w > NVG_MAX_FONTIMAGE_SIZE || h > NVG_MAX_FONTIMAGE_SIZE || npages > NVG_MAX_FONTIMAGES)
+		return 0;
+
+	// Create the textures first to keep the atlas if this fails.
+	memset(images, 0, sizeof(images));
+	for (i = 0; i < npages; i++) {
+		images[i] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, w, h, nvg__fontImageFlags(ctx), NULL);
+		if (images[i] == 0)
+			goto error;
+	}
+
+	n = fonsLoadSnapshot(ctx->fs, data, size);
+	if (n == 0)
+		goto error;
+	if (n < 0) {
+		// Out of memory, continue with an empty atlas.
+		fonsResetAtlas(ctx->fs, w, h);
+		n = 0;
+	}
+
+	// The new pages are uploaded whole at the end of the next frame.
+	for (i = 0; i < NVG_MAX_FONTIMAGES; i++) {
+		if (ctx->fontImages[i] != 0)
+			nvgDeleteImage(ctx, ctx->fontImages[i]);
+		ctx->fontImages[i] = 0;
+	}
+	npages = fonsGetAtlasPageCount(ctx->fs);
+	for (i = 0; i < NVG_MAX_FONTIMAGES; i++) {
+		if (i < npages)
+			ctx->fontImages[i] = images[i];
+		else if (images[i] != 0)
+			nvgDeleteImage(ctx, images[i]);
+	}
+	return n;
+
+error:
+	for (i = 0; i < npages; i++) {
+		if (images[i] != 0)
+			nvgDeleteImage(ctx, images[i]);
+	}
+	return 0;
+}
+
 // State setting
 void nvgFontSize(NVGcontext* ctx, float size)
 {
@@ -2396,61 +4125,257 @@ static float nvg__getFontScale(NVGstate* state)
 	return nvg__minf(nvg__quantize(nvg__getAverageScale(state->xform), 0.01f), 4.0f);
 }
 
+// Text layout is timed without the glyph rasterization done by fontstash meanwhile.
+static long long nvg__textLayoutStart(NVGcontext* ctx)
+{
+	FONSstats fstats;
+	fonsGetStats(ctx->fs, &fstats);
+	return nvg__timeNs() - fstats.rasterizeTime;
+}
+
+static void nvg__textLayoutEnd(NVGcontext* ctx, long long start)
+{
+	FONSstats fstats;
+	fonsGetStats(ctx->fs, &fstats);
+	ctx->stats.textLayoutTime += nvg__timeNs() - fstats.rasterizeTime - start;
+}
+
+static void nvg__deleteTextCache(NVGtextCache* cache)
+{
+	int i;
+	for (i = 0; i < cache->nlayouts; i++)
+		nvgInternalFree(cache->layouts[i].str);
+	nvgInternalFree(cache->layouts);
+	nvgInternalFree(cache->buckets);
+	nvgInternalFree(cache);
+}
+
+void nvgTextLayoutCache(NVGcontext* ctx, int maxEntries, int maxFrames)
+{
+	NVGtextCache* cache;
+	int i, nbuckets = 1;
+
+	if (ctx->textCache != NULL)
+		nvg__deleteTextCache(ctx->textCache);
+	ctx->textCache = NULL;
+
+	if (maxEntries <= 0)
+		return;
+
+	while (nbuckets < maxEntries*2)
+		nbuckets *= 2;
+
+	cache = (NVGtextCache*)nvgInternalAlloc(ctx->params.allocator, NVG_MEMORY_GLYPHS, sizeof(NVGtextCache));
+	if (cache == NULL) return;
+	memset(cache, 0, sizeof(NVGtextCache));
+	cache->layouts = (NVGtextLayout*)nvgInternalAlloc(ctx->params.allocator, NVG_MEMORY_GLYPHS, sizeof(NVGtextLayout)*maxEntries);
+	cache->buckets = (int*)nvgInternalAlloc(ctx->params.allocator, NVG_MEMORY_GLYPHS, sizeof(int)*nbuckets);
+	if (cache->layouts == NULL || cache->buckets == NULL) {
+		nvg__deleteTextCache(cache);
+		return;
+	}
+	cache->clayouts = maxEntries;
+	cache->nbuckets = nbuckets;
+	cache->maxFrames = nvg__maxi(maxFrames, 0);
+	for (i = 0; i < nbuckets; i++)
+		cache->buckets[i] = -1;
+
+	ctx->textCache = cache;
+}
+
+// Releases the layouts not used for maxFrames frames.
+static void nvg__evictTextLayouts(NVGcontext* ctx)
+{
+	NVGtextCache* cache = ctx->textCache;
+	int i, n = 0;
+
+	if (cache == NULL) return;
+
+	cache->frame++;
+	for (i = 0; i < cache->nlayouts; i++) {
+		NVGtextLayout* layout = &cache->layouts[i];
+		if (cache->frame - layout->lastUsed > cache->maxFrames)
+			nvgInternalFree(layout->str);
+		else
+			cache->layouts[n++] = *layout;
+	}
+	if (n == cache->nlayouts)
+		return;
+	cache->nlayouts = n;
+
+	for (i = 0; i < cache->nbuckets; i++)
+		cache->buckets[i] = -1;
+	for (i = 0; i < n; i++) {
+		int h = (int)(cache->layouts[i].hash & (unsigned int)(cache->nbuckets-1));
+		cache->layouts[i].next = cache->buckets[h];
+		cache->buckets[h] = i;
+	}
+}
+
+static unsigned int nvg__hashText(const char* str, const char* end)
+{
+	// FNV-1a
+	unsigned int h = 2166136261u;
+	while (str < end) {
+		h ^= (unsigned char)*str++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+// Returns the cached layout of the string drawn at x,y (atlas scale) with the current text style.
+// A new layout is added if not found, it is valid only if its generation matches the font atlas.
+// Returns NULL if the string is not cached and the cache is full.
+static NVGtextLayout* nvg__getTextLayout(NVGcontext* ctx, int kind, float scale, float x, float y, const char* string, const char* end)
+{
+	NVGtextCache* cache = ctx->textCache;
+	NVGstate* state = nvg__getState(ctx);
+	NVGtextLayout* layout;
+	unsigned int hash = nvg__hashText(string, end);
+	int i, h = (int)(hash & (unsigned int)(cache->nbuckets-1));
+	int len = (int)(end - string);
+	int nquads = kind == NVG_LAYOUT_QUADS ? len : 0;
+	float size = state->fontSize*scale;
+	float spacing = state->letterSpacing*scale;
+	float blur = state->fontBlur*scale;
+	float fx = x - floorf(x), fy = y - floorf(y);
+
+	for (i = cache->buckets[h]; i != -1; i = cache->layouts[i].next) {
+		layout = &cache->layouts[i];
+		if (layout->hash == hash && layout->kind == kind && layout->len == len &&
+			layout->font == state->fontId && layout->align == state->textAlign &&
+			layout->size == size && layout->spacing == spacing && layout->blur == blur &&
+			layout->fx == fx && layout->fy == fy && memcmp(layout->str, string, len) == 0) {
+			layout->lastUsed = cache->frame;
+			return layout;
+		}
+	}
+
+	if (cache->nlayouts >= cache->clayouts)
+		return NULL;
+
+	layout = &cache->layouts[cache->nlayouts];
+	memset(layout, 0, sizeof(NVGtextLayout));
+	// The string is stored first, the quads and their glyphs start aligned after it. There is at most one quad per byte.
+	layout->str = (char*)nvgInternalAlloc(ctx->params.allocator, NVG_MEMORY_GLYPHS, ((len+15) & ~15) + (int)(sizeof(FONSquad)+sizeof(int))*nquads);
+	if (layout->str == NULL)
+		return NULL;
+	memcpy(layout->str, string, len);
+	layout->quads = (FONSquad*)(layout->str + ((len+15) & ~15));
+	layout->glyphs = (int*)(layout->quads + nquads);
+	layout->hash = hash;
+	layout->kind = kind;
+	layout->len = len;
+	layout->font = state->fontId;
+	layout->align = state->textAlign;
+	layout->size = size;
+	layout->spacing = spacing;
+	layout->blur = blur;
+	layout->fx = fx;
+	layout->fy = fy;
+	layout->generation = fonsGetAtlasGeneration(ctx->fs) - 1;
+	layout->lastUsed = cache->frame;
+	layout->next = cache->buckets[h];
+	cache->buckets[h] = cache->nlayouts++;
+
+	return layout;
+}
+
 static void nvg__flushTextTexture(NVGcontext* ctx)
 {
-	int dirty[4];
+	int i, dirty[4];
 
-	if (fonsValidateTexture(ctx->fs, dirty)) {
-		int fontImage = ctx->fontImages[ctx->fontImageIdx];
+	for (i = 0; i < fonsGetAtlasPageCount(ctx->fs); i++) {
+		int fontImage = ctx->fontImages[i];
 		// Update texture
-		if (fontImage != 0) {
+		if (fontImage != 0 && fonsValidatePageTexture(ctx->fs, i, dirty)) {
 			int iw, ih;
-			const unsigned char* data = fonsGetTextureData(ctx->fs, &iw, &ih);
+			const unsigned char* data = fonsGetPageTextureData(ctx->fs, i, &iw, &ih);
 			int x = dirty[0];
 			int y = dirty[1];
 			int w = dirty[2] - dirty[0];
 			int h = dirty[3] - dirty[1];
 			ctx->params.renderUpdateTexture(ctx->params.userPtr, fontImage, x,y, w,h, data);
+			ctx->stats.atlasUploads++;
+			ctx->stats.atlasUploadBytes += w*h;
 		}
 	}
 }
 
+static void nvg__deleteRetiredFontImages(NVGcontext* ctx)
+{
+	int i;
+	for (i = 0; i < ctx->nretiredFontImages; i++)
+		nvgDeleteImage(ctx, ctx->retiredFontImages[i]);
+	ctx->nretiredFontImages = 0;
+}
+
+// Makes room for more glyphs. The single atlas page is grown up to the max texture size,
+// after that pages are added. Returns 0 when the atlas can not grow anymore.
 static int nvg__allocTextAtlas(NVGcontext* ctx)
 {
-	int iw, ih;
+	int iw = 0, ih = 0, image, npages = fonsGetAtlasPageCount(ctx->fs);
 	nvg__flushTextTexture(ctx);
-	if (ctx->fontImageIdx >= NVG_MAX_FONTIMAGES-1)
-		return 0;
-	// if next fontImage already have a texture
-	if (ctx->fontImages[ctx->fontImageIdx+1] != 0)
-		nvgImageSize(ctx, ctx->fontImages[ctx->fontImageIdx+1], &iw, &ih);
-	else { // calculate the new font image size and create it.
-		nvgImageSize(ctx, ctx->fontImages[ctx->fontImageIdx], &iw, &ih);
+	fonsGetAtlasSize(ctx->fs, &iw, &ih);
+
+	if (npages == 1 && (iw < NVG_MAX_FONTIMAGE_SIZE || ih < NVG_MAX_FONTIMAGE_SIZE)) {
+		if (ctx->nretiredFontImages >= NVG_MAX_FONTIMAGES)
+			return 0;
 		if (iw > ih)
 			ih *= 2;
 		else
 			iw *= 2;
 		if (iw > NVG_MAX_FONTIMAGE_SIZE || ih > NVG_MAX_FONTIMAGE_SIZE)
 			iw = ih = NVG_MAX_FONTIMAGE_SIZE;
-		ctx->fontImages[ctx->fontImageIdx+1] = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, iw, ih, 0, NULL);
+		image = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, iw, ih, nvg__fontImageFlags(ctx), NULL);
+		if (image == 0)
+			return 0;
+		// Keep the cached glyphs, the new texture gets the whole atlas uploaded.
+		if (!fonsExpandAtlas(ctx->fs, iw, ih)) {
+			nvgDeleteImage(ctx, image);
+			return 0;
+		}
+		// Text drawn earlier in the frame still uses the old texture.
+		ctx->retiredFontImages[ctx->nretiredFontImages++] = ctx->fontImages[0];
+		ctx->fontImages[0] = image;
+		return 1;
+	}
+
+	// Add a page rather than evict glyphs, the existing glyphs stay where they are.
+	if (npages >= NVG_MAX_FONTIMAGES)
+		return 0;
+	image = ctx->params.renderCreateTexture(ctx->params.userPtr, NVG_TEXTURE_ALPHA, iw, ih, nvg__fontImageFlags(ctx), NULL);
+	if (image == 0)
+		return 0;
+	if (fonsAddAtlasPage(ctx->fs) != npages) {
+		nvgDeleteImage(ctx, image);
+		return 0;
 	}
-	++ctx->fontImageIdx;
-	fonsResetAtlas(ctx->fs, iw, ih);
+	ctx->fontImages[npages] = image;
 	return 1;
 }
 
-static void nvg__renderText(NVGcontext* ctx, NVGvertex* verts, int nverts)
+static void nvg__renderText(NVGcontext* ctx, int page, NVGvertex* verts, int nverts)
 {
 	NVGstate* state = nvg__getState(ctx);
 	NVGpaint paint = state->fill;
 
 	// Render triangles.
-	paint.image = ctx->fontImages[ctx->fontImageIdx];
+	paint.image = ctx->fontImages[page];
+	// Distance field glyphs are not blurred, the edge is feathered instead.
+	if (ctx->params.sdfText)
+		paint.feather = state->fontBlur * 2.0f * nvg__getFontScale(state) * ctx->devicePxRatio;
 
 	// Apply global alpha
 	paint.innerColor.a *= state->alpha;
 	paint.outerColor.a *= state->alpha;
 
+	if (ctx->deferred != NULL) {
+		if (nvg__deferTriangles(ctx, &paint, verts, nverts))
+			return;
+		nvg__flushDeferred(ctx);
+	}
+
 	ctx->params.renderTriangles(ctx->params.userPtr, &paint, state->compositeOperation, &state->scissor, verts, nverts, ctx->fringeWidth);
 
 	ctx->drawCallCount++;
@@ -2463,23 +4388,58 @@ static int nvg__isTransformFlipped(const float *xform)
 	return( det < 0);
 }
 
+static int nvg__textQuadVerts(NVGstate* state, NVGvertex* verts, int nverts, int cverts, FONSquad q, float invscale, int isFlipped)
+{
+	float c[4*2];
+	if(isFlipped) {
+		float tmp;
+
+		tmp = q.y0; q.y0 = q.y1; q.y1 = tmp;
+		tmp = q.t0; q.t0 = q.t1; q.t1 = tmp;
+	}
+	// Transform corners.
+	nvgTransformPoint(&c[0],&c[1], state->xform, q.x0*invscale, q.y0*invscale);
+	nvgTransformPoint(&c[2],&c[3], state->xform, q.x1*invscale, q.y0*invscale);
+	nvgTransformPoint(&c[4],&c[5], state->xform, q.x1*invscale, q.y1*invscale);
+	nvgTransformPoint(&c[6],&c[7], state->xform, q.x0*invscale, q.y1*invscale);
+	// Create triangles
+	if (nverts+6 <= cverts) {
+		nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
+		nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
+		nvg__vset(&verts[nverts], c[2], c[3], q.s1, q.t0); nverts++;
+		nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
+		nvg__vset(&verts[nverts], c[6], c[7], q.s0, q.t1); nverts++;
+		nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
+	}
+	return nverts;
+}
+
 float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char* end)
 {
 	NVGstate* state = nvg__getState(ctx);
 	FONStextIter iter, prevIter;
 	FONSquad q;
 	NVGvertex* verts;
+	NVGtextLayout* layout = NULL;
 	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
 	float invscale = 1.0f / scale;
+	float ox = floorf(x*scale), oy = floorf(y*scale);
+	float nextx;
 	int cverts = 0;
 	int nverts = 0;
+	int nquads = 0;
+	int page = 0;
 	int isFlipped = nvg__isTransformFlipped(state->xform);
+	int i;
+	long long startTime;
 
 	if (end == NULL)
 		end = string + strlen(string);
 
 	if (state->fontId == FONS_INVALID) return x;
 
+	startTime = nvg__textLayoutStart(ctx);
+
 	fonsSetSize(ctx->fs, state->fontSize*scale);
 	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
 	fonsSetBlur(ctx->fs, state->fontBlur*scale);
@@ -2488,53 +4448,81 @@ float nvgText(NVGcontext* ctx, float x, float y, const char* string, const char*
 
 	cverts = nvg__maxi(2, (int)(end - string)) * 6; // conservative estimate.
 	verts = nvg__allocTempVerts(ctx, cverts);
-	if (verts == NULL) return x;
+	if (verts == NULL) {
+		nvg__textLayoutEnd(ctx, startTime);
+		return x;
+	}
 
-	fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, end, FONS_GLYPH_BITMAP_REQUIRED);
-	prevIter = iter;
-	while (fonsTextIterNext(ctx->fs, &iter, &q)) {
-		float c[4*2];
-		if (iter.prevGlyphIndex == -1) { // can not retrieve glyph?
-			if (nverts != 0) {
-				nvg__renderText(ctx, verts, nverts);
+	if (ctx->textCache != NULL)
+		layout = nvg__getTextLayout(ctx, NVG_LAYOUT_QUADS, scale, x*scale, y*scale, string, end);
+
+	if (layout != NULL && layout->generation == fonsGetAtlasGeneration(ctx->fs)) {
+		ctx->stats.textCacheHits++;
+		// The glyphs are not looked up, keep them from being evicted by the text drawn later in the frame.
+		fonsTouchGlyphs(ctx->fs, layout->font, layout->glyphs, layout->nquads);
+		for (i = 0; i < layout->nquads; i++) {
+			q = layout->quads[i];
+			q.x0 += ox; q.y0 += oy;
+			q.x1 += ox; q.y1 += oy;
+			if (q.page != page) {
+				if (nverts != 0)
+					nvg__renderText(ctx, page, verts, nverts);
 				nverts = 0;
+				page = q.page;
 			}
-			if (!nvg__allocTextAtlas(ctx))
-				break; // no memory :(
-			iter = prevIter;
-			fonsTextIterNext(ctx->fs, &iter, &q); // try again
-			if (iter.prevGlyphIndex == -1) // still can not find glyph?
-				break;
+			nverts = nvg__textQuadVerts(state, verts, nverts, cverts, q, invscale, isFlipped);
 		}
+		nextx = layout->advance + ox;
+	} else {
+		if (ctx->textCache != NULL)
+			ctx->stats.textCacheMisses++;
+		fonsTextIterInit(ctx->fs, &iter, x*scale, y*scale, string, end, FONS_GLYPH_BITMAP_REQUIRED);
 		prevIter = iter;
-		if(isFlipped) {
-			float tmp;
-
-			tmp = q.y0; q.y0 = q.y1; q.y1 = tmp;
-			tmp = q.t0; q.t0 = q.t1; q.t1 = tmp;
+		while (fonsTextIterNext(ctx->fs, &iter, &q)) {
+			if (iter.prevGlyphIndex == -1) { // can not retrieve glyph?
+				// The atlas texture changes, do not cache the partial layout.
+				layout = NULL;
+				if (nverts != 0) {
+					nvg__renderText(ctx, page, verts, nverts);
+					nverts = 0;
+				}
+				if (!nvg__allocTextAtlas(ctx))
+					break; // no memory :(
+				iter = prevIter;
+				fonsTextIterNext(ctx->fs, &iter, &q); // try again
+				if (iter.prevGlyphIndex == -1) // still can not find glyph?
+					break;
+			}
+			prevIter = iter;
+			if (layout != NULL && nquads < layout->len) {
+				FONSquad* lq = &layout->quads[nquads];
+				*lq = q;
+				lq->x0 -= ox; lq->y0 -= oy;
+				lq->x1 -= ox; lq->y1 -= oy;
+				layout->glyphs[nquads++] = iter.glyph;
+			}
+			// Glyphs on different atlas pages are drawn with separate calls.
+			if (q.page != page) {
+				if (nverts != 0)
+					nvg__renderText(ctx, page, verts, nverts);
+				nverts = 0;
+				page = q.page;
+			}
+			nverts = nvg__textQuadVerts(state, verts, nverts, cverts, q, invscale, isFlipped);
 		}
-		// Transform corners.
-		nvgTransformPoint(&c[0],&c[1], state->xform, q.x0*invscale, q.y0*invscale);
-		nvgTransformPoint(&c[2],&c[3], state->xform, q.x1*invscale, q.y0*invscale);
-		nvgTransformPoint(&c[4],&c[5], state->xform, q.x1*invscale, q.y1*invscale);
-		nvgTransformPoint(&c[6],&c[7], state->xform, q.x0*invscale, q.y1*invscale);
-		// Create triangles
-		if (nverts+6 <= cverts) {
-			nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
-			nvg__vset(&verts[nverts], c[2], c[3], q.s1, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[0], c[1], q.s0, q.t0); nverts++;
-			nvg__vset(&verts[nverts], c[6], c[7], q.s0, q.t1); nverts++;
-			nvg__vset(&verts[nverts], c[4], c[5], q.s1, q.t1); nverts++;
+		nextx = iter.nextx;
+		if (layout != NULL) {
+			layout->nquads = nquads;
+			layout->advance = nextx - ox;
+			layout->generation = fonsGetAtlasGeneration(ctx->fs);
 		}
 	}
 
-	// TODO: add back-end bit to do this just once per frame.
-	nvg__flushTextTexture(ctx);
+	nvg__textLayoutEnd(ctx, startTime);
 
-	nvg__renderText(ctx, verts, nverts);
+	nvg__renderText(ctx, page, verts, nverts);
 
-	return iter.nextx / scale;
+	return nextx / scale;
 }
 
 void nvgTextBox(NVGcontext* ctx, float x, float y, float breakRowWidth, const char* string, const char* end)
@@ -2578,6 +4566,7 @@ int nvgTextGlyphPositions(NVGcontext* ctx, float x, float y, const char* string,
 	FONStextIter iter, prevIter;
 	FONSquad q;
 	int npos = 0;
+	long long startTime;
 
 	if (state->fontId == FONS_INVALID) return 0;
 
@@ -2587,6 +4576,8 @@ int nvgTextGlyphPositions(NVGcontext* ctx, float x, float y, const char* string,
 	if (string == end)
 		return 0;
 
+	startTime = nvg__textLayoutStart(ctx);
+
 	fonsSetSize(ctx->fs, state->fontSize*scale);
 	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
 	fonsSetBlur(ctx->fs, state->fontBlur*scale);
@@ -2610,6 +4601,7 @@ int nvgTextGlyphPositions(NVGcontext* ctx, float x, float y, const char* string,
 			break;
 	}
 
+	nvg__textLayoutEnd(ctx, startTime);
 	return npos;
 }
 
@@ -2620,7 +4612,7 @@ enum NVGcodepointType {
 	NVG_CJK_CHAR,
 };
 
-int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth, NVGtextRow* rows, int maxRows)
+static int nvg__textBreakLines(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth, NVGtextRow* rows, int maxRows)
 {
 	NVGstate* state = nvg__getState(ctx);
 	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
@@ -2826,22 +4818,62 @@ int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, floa
 	return nrows;
 }
 
+int nvgTextBreakLines(NVGcontext* ctx, const char* string, const char* end, float breakRowWidth, NVGtextRow* rows, int maxRows)
+{
+	long long startTime = nvg__textLayoutStart(ctx);
+	int nrows = nvg__textBreakLines(ctx, string, end, breakRowWidth, rows, maxRows);
+	nvg__textLayoutEnd(ctx, startTime);
+	return nrows;
+}
+
 float nvgTextBounds(NVGcontext* ctx, float x, float y, const char* string, const char* end, float* bounds)
 {
 	NVGstate* state = nvg__getState(ctx);
 	float scale = nvg__getFontScale(state) * ctx->devicePxRatio;
 	float invscale = 1.0f / scale;
+	float ox = floorf(x*scale);
 	float width;
+	NVGtextLayout* layout = NULL;
+	long long startTime;
 
 	if (state->fontId == FONS_INVALID) return 0;
 
+	startTime = nvg__textLayoutStart(ctx);
+
 	fonsSetSize(ctx->fs, state->fontSize*scale);
 	fonsSetSpacing(ctx->fs, state->letterSpacing*scale);
 	fonsSetBlur(ctx->fs, state->fontBlur*scale);
 	fonsSetAlign(ctx->fs, state->textAlign);
 	fonsSetFont(ctx->fs, state->fontId);
 
-	width = fonsTextBounds(ctx->fs, x*scale, y*scale, string, end, bounds);
+	if (ctx->textCache != NULL) {
+		if (end == NULL)
+			end = string + strlen(string);
+		layout = nvg__getTextLayout(ctx, NVG_LAYOUT_BOUNDS, scale, x*scale, y*scale, string, end);
+	}
+
+	if (layout != NULL && layout->generation == fonsGetAtlasGeneration(ctx->fs)) {
+		ctx->stats.textCacheHits++;
+		width = layout->advance;
+		if (bounds != NULL) {
+			bounds[0] = layout->bounds[0] + ox;
+			bounds[2] = layout->bounds[2] + ox;
+		}
+	} else {
+		if (ctx->textCache != NULL)
+			ctx->stats.textCacheMisses++;
+		width = fonsTextBounds(ctx->fs, x*scale, y*scale, string, end, layout != NULL ? layout->bounds : bounds);
+		if (layout != NULL) {
+			layout->advance = width;
+			layout->generation = fonsGetAtlasGeneration(ctx->fs);
+			if (bounds != NULL) {
+				bounds[0] = layout->bounds[0];
+				bounds[2] = layout->bounds[2];
+			}
+			layout->bounds[0] -= ox;
+			layout->bounds[2] -= ox;
+		}
+	}
 	if (bounds != NULL) {
 		// Use line bounds for height.
 		fonsLineBounds(ctx->fs, y*scale, &bounds[1], &bounds[3]);
@@ -2850,6 +4882,7 @@ float nvgTextBounds(NVGcontext* ctx, float x, float y, const char* string, const
 		bounds[2] *= invscale;
 		bounds[3] *= invscale;
 	}
+	nvg__textLayoutEnd(ctx, startTime);
 	return width * invscale;
 }
 
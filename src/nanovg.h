@@ -31,6 +31,7 @@ extern "C" {
 #endif
 
 typedef struct NVGcontext NVGcontext;
+typedef struct NVGpathObject NVGpathObject;
 
 struct NVGcolor {
 	union {
@@ -142,6 +143,7 @@ enum NVGimageFlags {
 	NVG_IMAGE_FLIPY				= 1<<3,		// Flips (inverses) image in Y direction when rendered.
 	NVG_IMAGE_PREMULTIPLIED		= 1<<4,		// Image data has premultiplied alpha.
 	NVG_IMAGE_NEAREST			= 1<<5,		// Image interpolation is Nearest instead Linear
+	NVG_IMAGE_SDF				= 1<<6,		// Alpha image is a signed distance field with the edge at 0.5, paint feather widens the edge.
 };
 
 // Begin drawing a new frame
@@ -160,6 +162,51 @@ void nvgCancelFrame(NVGcontext* ctx);
 // Ends drawing flushing remaining render state.
 void nvgEndFrame(NVGcontext* ctx);
 
+// Transient per frame memory (path commands, flattened points, vertices and renderer buffers)
+// is allocated from a frame allocator which is reset in nvgBeginFrame(). The current path is copied
+// over the reset. By default a built-in arena allocator is used, which grows during the first frames
+// and then serves whole frames from one block without touching the heap.
+
+// Reserves size bytes for the built-in frame allocator, the memory is allocated in the next nvgBeginFrame().
+// Use nvgFrameMemoryHighWater() from earlier runs to avoid the allocations during the first frames.
+void nvgReserveFrameMemory(NVGcontext* ctx, int size);
+
+// Returns the largest amount of frame memory used by a frame so far, in bytes.
+// Returns 0 if the context uses a custom frame allocator.
+int nvgFrameMemoryHighWater(NVGcontext* ctx);
+
+// Returns number of bytes currently allocated in specified category, see NVGmemoryCategory.
+// The counters belong to the allocator of the context, and include all contexts sharing it.
+int nvgMemoryUsage(NVGcontext* ctx, int category);
+
+// Statistics of a frame, times are CPU time in nanoseconds. Time spent in the tessellation
+// workers is summed over all workers. Define NVG_NO_FRAME_TIMING to leave the times zero.
+struct NVGframeStats {
+	int drawCalls;
+	int fillTriangles;
+	int strokeTriangles;
+	int textTriangles;
+	int points;					// Points created by flattening the paths.
+	int bezierSubdivisions;		// Bezier curve subdivisions done while flattening.
+	int vertexBytes;			// Temporary vertex memory requested by tessellation and text.
+	int glyphCacheHits;
+	int glyphCacheMisses;
+	int glyphCacheEvictions;	// Glyphs evicted from the full font atlas.
+	int textCacheHits;			// Strings drawn or measured from the text layout cache.
+	int textCacheMisses;
+	int atlasUploads;			// Font atlas texture updates, at most one per frame unless the atlas grows.
+	int atlasUploadBytes;		// Font atlas texture data uploaded to the back-end.
+	long long flattenTime;
+	long long expandTime;
+	long long textLayoutTime;	// Excludes glyph rasterization.
+	long long glyphRasterizeTime;
+	long long flushTime;		// Time spent in the back-end flush.
+};
+typedef struct NVGframeStats NVGframeStats;
+
+// Returns the statistics of the current frame, call after nvgEndFrame() to get the whole frame.
+void nvgGetFrameStats(NVGcontext* ctx, NVGframeStats* stats);
+
 //
 // Composite operation
 //
@@ -508,6 +555,79 @@ void nvgFill(NVGcontext* ctx);
 // Fills the current path with current stroke style.
 void nvgStroke(NVGcontext* ctx);
 
+//
+// Path Objects
+//
+// Path objects capture the current path so that it can be drawn many times without defining,
+// flattening and tessellating it again. The path is stored relative to the current transform
+// at the time of creation, and drawn using the current transform and style when replayed.
+//
+// The tessellated fill and stroke geometry is cached inside the object. Replays under a pure
+// translation reuse the vertices directly. Other transforms reuse them as long as the scale
+// stays close enough to the cached one not to affect the tessellation tolerance, otherwise
+// the path is tessellated again.
+
+// Creates path object from the current path. Returns NULL on failure.
+NVGpathObject* nvgCreatePathObject(NVGcontext* ctx);
+
+// Deletes path object.
+void nvgDeletePathObject(NVGcontext* ctx, NVGpathObject* obj);
+
+// Fills the path object with current fill style.
+void nvgFillPathObject(NVGcontext* ctx, NVGpathObject* obj);
+
+// Strokes the path object with current stroke style.
+void nvgStrokePathObject(NVGcontext* ctx, NVGpathObject* obj);
+
+//
+// Deferred Tessellation
+//
+// By default nvgFill() and nvgStroke() tessellate the current path immediately. In deferred mode
+// the paths are queued together with a snapshot of the render state, tessellated in parallel
+// during nvgEndFrame(), and submitted to the renderer in the original order. Text is queued
+// as well to keep the order. Drawing a path object flushes the queue.
+
+// Task runner used to tessellate the queued paths. It must call task(taskPtr, i) once for
+// each i in [0..count), possibly concurrently on different threads, and return when all
+// the tasks have completed.
+typedef void (*NVGtaskRunner)(void* userPtr, void (*task)(void* taskPtr, int index), void* taskPtr, int count);
+
+// Enables deferred tessellation using specified number of workers, each worker is one task
+// passed to the runner. If runner is NULL, the tasks are run one after another on the calling thread.
+// Passing nworkers <= 0 disables deferred tessellation (default).
+void nvgTessellationWorkers(NVGcontext* ctx, int nworkers, NVGtaskRunner runner, void* userPtr);
+
+//
+// Curve Flattening
+//
+// Bezier curves are flattened into line segments before tessellation. The recursive method splits
+// the curve until each piece passes a flatness test. The analytic method calculates the number of
+// segments up front using Wang's formula and evaluates the points with forward differencing,
+// which is faster for curve heavy content. The analytic method may produce slightly more points.
+
+enum NVGcurveFlattening {
+	NVG_FLATTEN_RECURSIVE = 0,	// Recursive subdivision (default).
+	NVG_FLATTEN_ANALYTIC = 1,	// Segment count from Wang's formula, points using forward differencing.
+};
+
+// Sets the method used to flatten bezier curves, see NVGcurveFlattening.
+void nvgCurveFlattening(NVGcontext* ctx, int method);
+
+
+//
+// Fill Triangulation
+//
+// Concave fills are drawn by stenciling the shape and covering its bounds, which costs two passes
+// over the covered pixels. A fill with a single contour which does not intersect itself can instead
+// be triangulated on the CPU and drawn directly like a convex fill. With antialiasing the fringe would
+// overlap the shape, so the triangles only replace the overlapping fan of the stencil pass.
+// The triangulation time grows quickly with the number of points, so only contours up to a set
+// number of points are triangulated.
+
+// Sets the maximum number of points of a concave fill to triangulate on the CPU, 0 disables (default).
+// The value is clamped to NVG_MAX_TRIANGULATION, ignored if the back-end does not draw triangulated fills.
+void nvgFillTriangulation(NVGcontext* ctx, int maxPoints);
+
 
 //
 // Text
@@ -571,6 +691,39 @@ void nvgResetFallbackFontsId(NVGcontext* ctx, int baseFont);
 // Resets fallback fonts by name.
 void nvgResetFallbackFonts(NVGcontext* ctx, const char* baseFont);
 
+// Rasterizes the glyphs missing from the font atlas in parallel using specified number of workers,
+// each worker is one task passed to the runner (see NVGtaskRunner). The glyphs of each text string
+// are batched. If runner is NULL, the tasks are run one after another on the calling thread.
+// Passing nworkers <= 0 rasterizes the glyphs one at a time (default).
+void nvgGlyphWorkers(NVGcontext* ctx, int nworkers, NVGtaskRunner runner, void* userPtr);
+
+// Rasterizes the glyphs of the code point ranges into the font atlas ahead of time, for example before
+// the first frame or while a loading screen is shown, so that the first frame drawing the text does not stall.
+// ranges holds nranges pairs of first and last code point, inclusive. The sizes are in pixels, that is
+// the font size multiplied by the device pixel ratio, and must be at least 0.2. The glyphs are created with
+// the blur of the current text style scaled like in nvgText(). The atlas grows when full. The glyph workers
+// are used if set (see nvgGlyphWorkers()), the call returns when all the glyphs are rasterized.
+// Returns 1 if all the glyphs were added, 0 if a size is invalid or the atlas is full.
+int nvgWarmGlyphs(NVGcontext* ctx, int font, const float* sizes, int nsizes, const unsigned int* ranges, int nranges);
+
+// Saves the font atlas and the glyphs of all fonts to data, so that they can be restored with nvgLoadFontAtlas()
+// without rasterizing them again, for example at the next start of the application. Pass NULL to query the size.
+// Returns the size of the snapshot, or 0 if size is too small.
+int nvgSaveFontAtlas(NVGcontext* ctx, unsigned char* data, int size);
+
+// Replaces the font atlas with a snapshot saved by nvgSaveFontAtlas(). Create the fonts first, the fonts are
+// identified by a hash of their data and the glyphs of fonts which differ or have different fallbacks are dropped.
+// Call outside nvgBeginFrame() and nvgEndFrame(), the data is not used after the call.
+// Returns number of glyphs restored, 0 if the snapshot can not be used and the atlas is left unchanged.
+int nvgLoadFontAtlas(NVGcontext* ctx, const unsigned char* data, int size);
+
+// Caches the glyph quads and advance of the strings drawn with nvgText() and the bounds measured
+// with nvgTextBounds(), keyed by the string, font, size, letter spacing, blur, align and scale.
+// Text drawn at the same sub-pixel offset reuses the layout. Up to maxEntries strings are cached,
+// the ones not used for maxFrames frames are evicted in nvgBeginFrame().
+// Passing maxEntries <= 0 disables the cache (default).
+void nvgTextLayoutCache(NVGcontext* ctx, int maxEntries, int maxFrames);
+
 // Sets the font size of current text style.
 void nvgFontSize(NVGcontext* ctx, float size);
 
@@ -654,9 +807,44 @@ struct NVGpath {
 	int nstroke;
 	int winding;
 	int convex;
+	int triangulated;	// Fill vertices are a triangle list instead of a fan, a fringe is still drawn with the stencil.
 };
 typedef struct NVGpath NVGpath;
 
+enum NVGmemoryCategory {
+	NVG_MEMORY_COMMANDS,	// Path commands and path objects.
+	NVG_MEMORY_PATHCACHE,	// Flattened paths and tessellated vertices.
+	NVG_MEMORY_GLYPHS,		// Fonts, glyph cache and text layout cache.
+	NVG_MEMORY_ATLAS,		// Font atlas.
+	NVG_MEMORY_TEXTURES,	// Image data.
+	NVG_MEMORY_BACKEND,		// Render back-end buffers.
+	NVG_MEMORY_FRAME,		// Built-in frame allocator, holds the per frame commands, path cache and back-end buffers.
+	NVG_MEMORY_OTHER,
+	NVG_MEMORY_COUNT
+};
+
+// Allocator used for all memory allocated by nanovg, the back-ends, fontstash and stb_image.
+// The functions must be thread safe when deferred tessellation is used. Malloc, realloc and free
+// are used when the allocator is NULL. The usage counters are maintained by nanovg.
+struct NVGallocator {
+	void* userPtr;
+	void* (*alloc)(void* userPtr, int size);
+	void* (*resize)(void* userPtr, void* ptr, int size);
+	void (*release)(void* userPtr, void* ptr);
+	int usage[NVG_MEMORY_COUNT];	// Bytes allocated in each NVGmemoryCategory.
+};
+typedef struct NVGallocator NVGallocator;
+
+// Allocator for transient memory that is used only during one frame.
+// The memory returned by alloc must be aligned for any type, and stay valid until reset is called.
+// Reset is called in nvgBeginFrame(), after the previous frame has been flushed or cancelled.
+struct NVGframeAllocator {
+	void* userPtr;
+	void* (*alloc)(void* userPtr, int size);
+	void (*reset)(void* userPtr);
+};
+typedef struct NVGframeAllocator NVGframeAllocator;
+
 struct NVGparams {
 	void* userPtr;
 	int edgeAntiAlias;
@@ -670,8 +858,14 @@ struct NVGparams {
 	void (*renderFlush)(void* uptr);
 	void (*renderFill)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe, const float* bounds, const NVGpath* paths, int npaths);
 	void (*renderStroke)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe, float strokeWidth, const NVGpath* paths, int npaths);
+	// The font texture is updated once before renderFlush(), text must not be drawn before the flush.
 	void (*renderTriangles)(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, const NVGvertex* verts, int nverts, float fringe);
 	void (*renderDelete)(void* uptr);
+	// New fields are added at the end to keep the layout of existing back-ends.
+	NVGallocator* allocator;			// Default allocator owned by the context is used if NULL.
+	NVGframeAllocator frameAllocator;	// Built-in arena allocator is used if alloc is NULL.
+	int sdfText;						// Glyphs are cached as distance fields in a NVG_IMAGE_SDF texture.
+	int triangulatedFills;				// Back-end draws NVGpath::triangulated fills as triangle lists.
 };
 typedef struct NVGparams NVGparams;
 
@@ -681,9 +875,19 @@ void nvgDeleteInternal(NVGcontext* ctx);
 
 NVGparams* nvgInternalParams(NVGcontext* ctx);
 
+// Memory allocation for the render back-ends, tracked in the specified NVGmemoryCategory.
+// The memory must be released with nvgInternalFree(). Allocator can be NULL.
+void* nvgInternalAlloc(NVGallocator* allocator, int category, int size);
+void* nvgInternalRealloc(NVGallocator* allocator, int category, void* ptr, int size);
+void nvgInternalFree(void* ptr);
+
 // Debug function to dump cached path data.
 void nvgDebugDumpPathCache(NVGcontext* ctx);
 
+// Debug function to tessellate and blur the glyphs with the scalar code instead of the SIMD kernels.
+// Both produce identical results, bench -verify-simd compares them.
+void nvgDebugDisableSimd(NVGcontext* ctx, int disable);
+
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
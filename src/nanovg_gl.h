@@ -24,6 +24,8 @@ extern "C" {
 
 // Create flags
 
+#ifndef NANOVG_CREATE_FLAGS
+#define NANOVG_CREATE_FLAGS
 enum NVGcreateFlags {
 	// Flag indicating if geometry based anti-aliasing is used (may not be needed when using MSAA).
 	NVG_ANTIALIAS 		= 1<<0,
@@ -32,7 +34,14 @@ enum NVGcreateFlags {
 	NVG_STENCIL_STROKES	= 1<<1,
 	// Flag indicating that additional debug checks are done.
 	NVG_DEBUG 			= 1<<2,
+	// Flag indicating that text is rendered from signed distance field glyphs, which are scaled
+	// to any size from a few cached sizes instead of being rasterized for each size.
+	NVG_SDF_TEXT		= 1<<3,
+	// Flag indicating that consecutive triangle and convex fill calls with the same image and blending
+	// are merged into a single draw call. Only the GL3 and GLES3 back-ends merge calls.
+	NVG_MERGE_CALLS		= 1<<4,
 };
+#endif
 
 #if defined NANOVG_GL2_IMPLEMENTATION
 #  define NANOVG_GL2 1
@@ -41,22 +50,41 @@ enum NVGcreateFlags {
 #  define NANOVG_GL3 1
 #  define NANOVG_GL_IMPLEMENTATION 1
 #  define NANOVG_GL_USE_UNIFORMBUFFER 1
+#  define NANOVG_GL_USE_CALLMERGE 1
 #elif defined NANOVG_GLES2_IMPLEMENTATION
 #  define NANOVG_GLES2 1
 #  define NANOVG_GL_IMPLEMENTATION 1
 #elif defined NANOVG_GLES3_IMPLEMENTATION
 #  define NANOVG_GLES3 1
 #  define NANOVG_GL_IMPLEMENTATION 1
+#  define NANOVG_GL_USE_CALLMERGE 1
 #endif
 
 #define NANOVG_GL_USE_STATE_FILTER (1)
 
+// GL3 streams vertices and uniforms through persistently mapped buffers when the context supports
+// GL 4.4 or ARB_buffer_storage. Define NANOVG_GL_NO_BUFFERSTORAGE to always use glBufferData.
+// Define NANOVG_GL_COMPACT_VERTICES to stream texture coordinates as 16-bit normalized integers,
+// which makes a vertex 12 bytes instead of 16.
+#if defined NANOVG_GL3 && defined GL_MAP_PERSISTENT_BIT && !defined NANOVG_GL_NO_BUFFERSTORAGE
+#  define NANOVG_GL_USE_BUFFERSTORAGE 1
+#endif
+
+// Merged calls read their uniforms from a texture with up to GL_MAX_TEXTURE_SIZE rows of 64 uniform sets.
+// When the uniforms of a frame do not fit, the calls are drawn in batches which upload the texture again.
+// Define NANOVG_GL_MAX_FRAG_ROWS to use fewer rows.
+#ifndef NANOVG_GL_MAX_FRAG_ROWS
+#  define NANOVG_GL_MAX_FRAG_ROWS 0
+#endif
+
 // Creates NanoVG contexts for different OpenGL (ES) versions.
 // Flags should be combination of the create flags above.
+// The WithAllocator variants allocate all memory of the context from the specified allocator.
 
 #if defined NANOVG_GL2
 
 NVGcontext* nvgCreateGL2(int flags);
+NVGcontext* nvgCreateGL2WithAllocator(int flags, NVGallocator* allocator);
 void nvgDeleteGL2(NVGcontext* ctx);
 
 int nvglCreateImageFromHandleGL2(NVGcontext* ctx, GLuint textureId, int w, int h, int flags);
@@ -67,6 +95,7 @@ GLuint nvglImageHandleGL2(NVGcontext* ctx, int image);
 #if defined NANOVG_GL3
 
 NVGcontext* nvgCreateGL3(int flags);
+NVGcontext* nvgCreateGL3WithAllocator(int flags, NVGallocator* allocator);
 void nvgDeleteGL3(NVGcontext* ctx);
 
 int nvglCreateImageFromHandleGL3(NVGcontext* ctx, GLuint textureId, int w, int h, int flags);
@@ -77,6 +106,7 @@ GLuint nvglImageHandleGL3(NVGcontext* ctx, int image);
 #if defined NANOVG_GLES2
 
 NVGcontext* nvgCreateGLES2(int flags);
+NVGcontext* nvgCreateGLES2WithAllocator(int flags, NVGallocator* allocator);
 void nvgDeleteGLES2(NVGcontext* ctx);
 
 int nvglCreateImageFromHandleGLES2(NVGcontext* ctx, GLuint textureId, int w, int h, int flags);
@@ -87,6 +117,7 @@ GLuint nvglImageHandleGLES2(NVGcontext* ctx, int image);
 #if defined NANOVG_GLES3
 
 NVGcontext* nvgCreateGLES3(int flags);
+NVGcontext* nvgCreateGLES3WithAllocator(int flags, NVGallocator* allocator);
 void nvgDeleteGLES3(NVGcontext* ctx);
 
 int nvglCreateImageFromHandleGLES3(NVGcontext* ctx, GLuint textureId, int w, int h, int flags);
@@ -110,6 +141,7 @@ enum NVGimageFlagsGL {
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include <math.h>
 #include "nanovg.h"
 
@@ -117,6 +149,7 @@ enum GLNVGuniformLoc {
 	GLNVG_LOC_VIEWSIZE,
 	GLNVG_LOC_TEX,
 	GLNVG_LOC_FRAG,
+	GLNVG_LOC_FRAGTEX,
 	GLNVG_MAX_LOCS
 };
 
@@ -133,6 +166,14 @@ enum GLNVGuniformBindings {
 };
 #endif
 
+#if NANOVG_GL_USE_CALLMERGE
+// When calls are merged, the uniforms of all calls are stored in a float texture
+// which the vertex shader reads. Each uniform set takes a run of texels on a row,
+// don't forget to also update the vertex shader source!
+#define GLNVG_FRAG_TEXELS 11
+#define GLNVG_FRAGS_PER_ROW 64
+#endif
+
 struct GLNVGshader {
 	GLuint prog;
 	GLuint frag;
@@ -165,6 +206,7 @@ enum GLNVGcallType {
 	GLNVG_CONVEXFILL,
 	GLNVG_STROKE,
 	GLNVG_TRIANGLES,
+	GLNVG_MERGED,
 };
 
 struct GLNVGcall {
@@ -176,14 +218,29 @@ struct GLNVGcall {
 	int triangleCount;
 	int uniformOffset;
 	GLNVGblend blendFunc;
+#if NANOVG_GL_USE_CALLMERGE
+	int fragBase;		// First uniform set in the uniform texture when the call is drawn.
+#endif
 };
 typedef struct GLNVGcall GLNVGcall;
 
+// Texture coordinates are stroke and fringe coverage or font atlas coordinates, all in [0,1].
+#ifdef NANOVG_GL_COMPACT_VERTICES
+struct GLNVGvertex {
+	float x,y;
+	unsigned short u,v;
+};
+typedef struct GLNVGvertex GLNVGvertex;
+#else
+typedef NVGvertex GLNVGvertex;
+#endif
+
 struct GLNVGpath {
 	int fillOffset;
 	int fillCount;
 	int strokeOffset;
 	int strokeCount;
+	int triangulated;	// Fill is a triangle list instead of a fan.
 };
 typedef struct GLNVGpath GLNVGpath;
 
@@ -228,6 +285,34 @@ struct GLNVGfragUniforms {
 };
 typedef struct GLNVGfragUniforms GLNVGfragUniforms;
 
+#if NANOVG_GL_USE_BUFFERSTORAGE
+#define GLNVG_RING_SEGMENTS 3
+
+// Persistently mapped buffer split into segments, which consecutive frames write to in turn.
+struct GLNVGring {
+	GLuint buf;
+	GLenum target;
+	unsigned char* data;
+	int itemSize;
+	int count;		// Number of items in a segment.
+	int segment;	// Segment of the current frame.
+	int mapped;		// The current frame is written to the segment.
+	int overflow;	// Number of items needed by a frame which did not fit into a segment.
+	int prefix;		// Number of items written to the segment before the frame overflowed.
+	GLsync fences[GLNVG_RING_SEGMENTS];
+};
+typedef struct GLNVGring GLNVGring;
+#endif
+
+// Uniforms written earlier in the frame, looked up by the hash of their contents.
+#define GLNVG_FRAG_HASH_SIZE 256
+struct GLNVGfragHash {
+	unsigned int hash;
+	int offset;
+	int count;		// Number of uniform sets, zero if the entry is not used.
+};
+typedef struct GLNVGfragHash GLNVGfragHash;
+
 struct GLNVGcontext {
 	GLNVGshader shader;
 	GLNVGtexture* textures;
@@ -241,27 +326,50 @@ struct GLNVGcontext {
 #endif
 #if NANOVG_GL_USE_UNIFORMBUFFER
 	GLuint fragBuf;
+	GLuint frameFragBuf;	// Buffer and offset the uniforms of the current frame are bound from.
+	int frameFragOffset;
+#endif
+#if NANOVG_GL_USE_BUFFERSTORAGE
+	GLNVGring vertRing;
+	GLNVGring fragRing;
+#endif
+#if NANOVG_GL_USE_CALLMERGE
+	GLuint fragTex;
+	int fragTexRows;
+	int fragTexMaxRows;
+	int fragTexBase;	// First uniform set in the uniform texture, -1 if not uploaded.
+	GLuint fragIndexBuf;
 #endif
 	int fragSize;
 	int flags;
 
-	// Per frame buffers
+	// Per frame buffers, allocated from the frame allocator of the context when it has one.
+	NVGallocator* allocator;
+	NVGframeAllocator frameAllocator;
 	GLNVGcall* calls;
 	int ccalls;
 	int ncalls;
 	GLNVGpath* paths;
 	int cpaths;
 	int npaths;
-	struct NVGvertex* verts;
+	GLNVGvertex* verts;
 	int cverts;
 	int nverts;
 	unsigned char* uniforms;
 	int cuniforms;
 	int nuniforms;
+	GLNVGfragHash fragHash[GLNVG_FRAG_HASH_SIZE];
+#if NANOVG_GL_USE_CALLMERGE
+	float* fragIndices;
+	int cfragIndices;
+	float* fragTexels;
+	int cfragTexels;
+#endif
 
 	// cached state
 	#if NANOVG_GL_USE_STATE_FILTER
 	GLuint boundTexture;
+	int boundFragOffset;
 	GLuint stencilMask;
 	GLenum stencilFunc;
 	GLint stencilFuncRef;
@@ -274,6 +382,9 @@ struct GLNVGcontext {
 typedef struct GLNVGcontext GLNVGcontext;
 
 static int glnvg__maxi(int a, int b) { return a > b ? a : b; }
+#if NANOVG_GL_USE_CALLMERGE
+static int glnvg__mini(int a, int b) { return a < b ? a : b; }
+#endif
 
 #ifdef NANOVG_GLES2
 static unsigned int glnvg__nearestPow2(unsigned int num)
@@ -345,6 +456,106 @@ static void glnvg__blendFuncSeparate(GLNVGcontext* gl, const GLNVGblend* blend)
 #endif
 }
 
+#if NANOVG_GL_USE_BUFFERSTORAGE
+static int glnvg__hasBufferStorage(void)
+{
+	GLint major = 0, minor = 0, n = 0, i;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	if (major > 4 || (major == 4 && minor >= 4))
+		return 1;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &n);
+	for (i = 0; i < n; i++) {
+		const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		if (ext != NULL && strcmp(ext, "GL_ARB_buffer_storage") == 0)
+			return 1;
+	}
+	return 0;
+}
+
+static void glnvg__deleteRing(GLNVGring* ring)
+{
+	int i;
+	for (i = 0; i < GLNVG_RING_SEGMENTS; i++) {
+		if (ring->fences[i] != 0)
+			glDeleteSync(ring->fences[i]);
+		ring->fences[i] = 0;
+	}
+	// Deleting the buffer unmaps it, the GL keeps it alive until pending draws are done.
+	if (ring->buf != 0)
+		glDeleteBuffers(1, &ring->buf);
+	ring->buf = 0;
+	ring->data = NULL;
+}
+
+static int glnvg__createRing(GLNVGring* ring, GLenum target, int itemSize, int count)
+{
+	// Write only, the items which are read back are kept in CPU memory.
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = (GLsizeiptr)itemSize * count * GLNVG_RING_SEGMENTS;
+
+	glnvg__deleteRing(ring);
+	ring->target = target;
+	ring->itemSize = itemSize;
+	ring->count = count;
+	ring->segment = 0;
+	ring->overflow = 0;
+	ring->prefix = 0;
+
+	glGenBuffers(1, &ring->buf);
+	glBindBuffer(target, ring->buf);
+	glBufferStorage(target, size, NULL, flags);
+	ring->data = (unsigned char*)glMapBufferRange(target, 0, size, flags);
+	glBindBuffer(target, 0);
+	if (ring->data == NULL) {
+		glnvg__deleteRing(ring);
+		return 0;
+	}
+	return 1;
+}
+
+// Waits until the GPU is done with the segment of the current frame and returns it for writing.
+static void* glnvg__acquireRing(GLNVGring* ring)
+{
+	GLsync fence = ring->fences[ring->segment];
+	if (fence != 0) {
+		GLenum ret;
+		do {
+			ret = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		} while (ret == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fence);
+		ring->fences[ring->segment] = 0;
+	}
+	ring->mapped = 1;
+	return ring->data + (size_t)ring->segment * ring->count * ring->itemSize;
+}
+
+// Fences the segment drawn by the current frame, or grows the ring if the frame did not fit.
+static void glnvg__releaseRing(GLNVGring* ring)
+{
+	if (ring->buf == 0) return;
+	if (ring->mapped) {
+		ring->fences[ring->segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		ring->segment = (ring->segment + 1) % GLNVG_RING_SEGMENTS;
+	}
+	if (ring->overflow > 0)
+		glnvg__createRing(ring, ring->target, ring->itemSize, ring->overflow + ring->overflow/2);
+}
+
+// Copies the items built in CPU memory to the segment of the current frame. Returns the byte offset
+// of the items in the ring buffer, or -1 if they do not fit, the ring grows at the end of the frame.
+static int glnvg__copyToRing(GLNVGring* ring, const void* items, int n)
+{
+	if (ring->buf == 0) return -1;
+	if (n > ring->count) {
+		ring->overflow = n;
+		return -1;
+	}
+	memcpy(glnvg__acquireRing(ring), items, (size_t)n * ring->itemSize);
+	return ring->segment * ring->count * ring->itemSize;
+}
+#endif
+
 static GLNVGtexture* glnvg__allocTexture(GLNVGcontext* gl)
 {
 	GLNVGtexture* tex = NULL;
@@ -360,7 +571,7 @@ static GLNVGtexture* glnvg__allocTexture(GLNVGcontext* gl)
 		if (gl->ntextures+1 > gl->ctextures) {
 			GLNVGtexture* textures;
 			int ctextures = glnvg__maxi(gl->ntextures+1, 4) +  gl->ctextures/2; // 1.5x Overallocate
-			textures = (GLNVGtexture*)realloc(gl->textures, sizeof(GLNVGtexture)*ctextures);
+			textures = (GLNVGtexture*)nvgInternalRealloc(gl->allocator, NVG_MEMORY_BACKEND, gl->textures, sizeof(GLNVGtexture)*ctextures);
 			if (textures == NULL) return NULL;
 			gl->textures = textures;
 			gl->ctextures = ctextures;
@@ -465,6 +676,7 @@ static int glnvg__createShader(GLNVGshader* shader, const char* name, const char
 
 	glBindAttribLocation(prog, 0, "vertex");
 	glBindAttribLocation(prog, 1, "tcoord");
+	glBindAttribLocation(prog, 2, "fragIndex");
 
 	glLinkProgram(prog);
 	glGetProgramiv(prog, GL_LINK_STATUS, &status);
@@ -500,6 +712,7 @@ static void glnvg__getUniforms(GLNVGshader* shader)
 #else
 	shader->loc[GLNVG_LOC_FRAG] = glGetUniformLocation(shader->prog, "frag");
 #endif
+	shader->loc[GLNVG_LOC_FRAGTEX] = glGetUniformLocation(shader->prog, "fragTex");
 }
 
 static int glnvg__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data);
@@ -508,6 +721,7 @@ static int glnvg__renderCreate(void* uptr)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	int align = 4;
+	char opts[256];
 
 	// TODO: mediump float may not be enough for GLES2 in iOS.
 	// see the following discussion: https://github.com/memononen/nanovg/issues/46
@@ -519,6 +733,7 @@ static int glnvg__renderCreate(void* uptr)
 		"#define NANOVG_GL3 1\n"
 #elif defined NANOVG_GLES2
 		"#version 100\n"
+		"#extension GL_OES_standard_derivatives : enable\n"
 		"#define NANOVG_GL2 1\n"
 #elif defined NANOVG_GLES3
 		"#version 300 es\n"
@@ -532,6 +747,18 @@ static int glnvg__renderCreate(void* uptr)
 #endif
 	"\n";
 
+#if NANOVG_GL_USE_CALLMERGE
+	// Merged calls read the uniforms from a texture in the vertex shader and pass them
+	// to the fragment shader as flat varyings instead of the uniform block or array.
+	static const char* mergeOpts =
+		"#define MERGE_CALLS 1\n"
+		"#define FRAGS_PER_ROW 64\n"
+		"#undef USE_UNIFORMBUFFER\n"
+		"#ifndef UNIFORMARRAY_SIZE\n"
+		"#define UNIFORMARRAY_SIZE 11\n"
+		"#endif\n";
+#endif
+
 	static const char* fillVertShader =
 		"#ifdef NANOVG_GL3\n"
 		"	uniform vec2 viewSize;\n"
@@ -539,6 +766,11 @@ static int glnvg__renderCreate(void* uptr)
 		"	in vec2 tcoord;\n"
 		"	out vec2 ftcoord;\n"
 		"	out vec2 fpos;\n"
+		"#ifdef MERGE_CALLS\n"
+		"	uniform highp sampler2D fragTex;\n"
+		"	in float fragIndex;\n"
+		"	flat out vec4 frag[UNIFORMARRAY_SIZE];\n"
+		"#endif\n"
 		"#else\n"
 		"	uniform vec2 viewSize;\n"
 		"	attribute vec2 vertex;\n"
@@ -547,6 +779,12 @@ static int glnvg__renderCreate(void* uptr)
 		"	varying vec2 fpos;\n"
 		"#endif\n"
 		"void main(void) {\n"
+		"#ifdef MERGE_CALLS\n"
+		"	int i = int(fragIndex);\n"
+		"	ivec2 p = ivec2((i % FRAGS_PER_ROW) * UNIFORMARRAY_SIZE, i / FRAGS_PER_ROW);\n"
+		"	for (int j = 0; j < UNIFORMARRAY_SIZE; j++)\n"
+		"		frag[j] = texelFetch(fragTex, ivec2(p.x + j, p.y), 0);\n"
+		"#endif\n"
 		"	ftcoord = tcoord;\n"
 		"	fpos = vertex;\n"
 		"	gl_Position = vec4(2.0*vertex.x/viewSize.x - 1.0, 1.0 - 2.0*vertex.y/viewSize.y, 0, 1);\n"
@@ -577,6 +815,8 @@ static int glnvg__renderCreate(void* uptr)
 		"		int texType;\n"
 		"		int type;\n"
 		"	};\n"
+		"#elif defined(MERGE_CALLS)\n"
+		"	flat in vec4 frag[UNIFORMARRAY_SIZE];\n"
 		"#else\n" // NANOVG_GL3 && !USE_UNIFORMBUFFER
 		"	uniform vec4 frag[UNIFORMARRAY_SIZE];\n"
 		"#endif\n"
@@ -618,6 +858,15 @@ static int glnvg__renderCreate(void* uptr)
 		"	sc = vec2(0.5,0.5) - sc * scissorScale;\n"
 		"	return clamp(sc.x,0.0,1.0) * clamp(sc.y,0.0,1.0);\n"
 		"}\n"
+		"// Signed distance field with the edge at 0.5, feather widens the edge.\n"
+		"float sdfAlpha(float d) {\n"
+		"#if defined(GL_ES) && !defined(NANOVG_GL3) && !defined(GL_OES_standard_derivatives)\n"
+		"	float w = 0.05 * (1.0 + feather);\n"
+		"#else\n"
+		"	float w = max(fwidth(d), 0.0001) * (1.0 + feather);\n"
+		"#endif\n"
+		"	return clamp((d - 0.5) / w + 0.5, 0.0, 1.0);\n"
+		"}\n"
 		"#ifdef EDGE_AA\n"
 		"// Stroke - from [0..1] to clipped pyramid, where the slope is 1px.\n"
 		"float strokeMask() {\n"
@@ -652,6 +901,7 @@ static int glnvg__renderCreate(void* uptr)
 		"#endif\n"
 		"		if (texType == 1) color = vec4(color.xyz*color.w,color.w);"
 		"		if (texType == 2) color = vec4(color.x);"
+		"		if (texType == 3) color = vec4(sdfAlpha(color.x));"
 		"		// Apply color tint and alpha.\n"
 		"		color *= innerCol;\n"
 		"		// Combine alpha\n"
@@ -667,6 +917,7 @@ static int glnvg__renderCreate(void* uptr)
 		"#endif\n"
 		"		if (texType == 1) color = vec4(color.xyz*color.w,color.w);"
 		"		if (texType == 2) color = vec4(color.x);"
+		"		if (texType == 3) color = vec4(sdfAlpha(color.x));"
 		"		color *= scissor;\n"
 		"		result = color * innerCol;\n"
 		"	}\n"
@@ -679,13 +930,15 @@ static int glnvg__renderCreate(void* uptr)
 
 	glnvg__checkError(gl, "init");
 
-	if (gl->flags & NVG_ANTIALIAS) {
-		if (glnvg__createShader(&gl->shader, "shader", shaderHeader, "#define EDGE_AA 1\n", fillVertShader, fillFragShader) == 0)
-			return 0;
-	} else {
-		if (glnvg__createShader(&gl->shader, "shader", shaderHeader, NULL, fillVertShader, fillFragShader) == 0)
-			return 0;
-	}
+	opts[0] = '\0';
+	if (gl->flags & NVG_ANTIALIAS)
+		strcat(opts, "#define EDGE_AA 1\n");
+#if NANOVG_GL_USE_CALLMERGE
+	if (gl->flags & NVG_MERGE_CALLS)
+		strcat(opts, mergeOpts);
+#endif
+	if (glnvg__createShader(&gl->shader, "shader", shaderHeader, opts, fillVertShader, fillFragShader) == 0)
+		return 0;
 
 	glnvg__checkError(gl, "uniform locations");
 	glnvg__getUniforms(&gl->shader);
@@ -698,12 +951,34 @@ static int glnvg__renderCreate(void* uptr)
 
 #if NANOVG_GL_USE_UNIFORMBUFFER
 	// Create UBOs
-	glUniformBlockBinding(gl->shader.prog, gl->shader.loc[GLNVG_LOC_FRAG], GLNVG_FRAG_BINDING);
-	glGenBuffers(1, &gl->fragBuf);
-	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+	if ((gl->flags & NVG_MERGE_CALLS) == 0) {
+		glUniformBlockBinding(gl->shader.prog, gl->shader.loc[GLNVG_LOC_FRAG], GLNVG_FRAG_BINDING);
+		glGenBuffers(1, &gl->fragBuf);
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &align);
+	}
+#endif
+#if NANOVG_GL_USE_CALLMERGE
+	// Create uniform texture and per vertex uniform index buffer for merged calls.
+	if (gl->flags & NVG_MERGE_CALLS) {
+		glGenTextures(1, &gl->fragTex);
+		glGenBuffers(1, &gl->fragIndexBuf);
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &gl->fragTexMaxRows);
+		if (NANOVG_GL_MAX_FRAG_ROWS > 0 && gl->fragTexMaxRows > NANOVG_GL_MAX_FRAG_ROWS)
+			gl->fragTexMaxRows = NANOVG_GL_MAX_FRAG_ROWS;
+	}
 #endif
 	gl->fragSize = sizeof(GLNVGfragUniforms) + align - sizeof(GLNVGfragUniforms) % align;
 
+#if NANOVG_GL_USE_BUFFERSTORAGE
+	// Write vertices directly to a persistently mapped buffer when supported, the uniforms and
+	// the vertices of merged calls are copied to one when the frame is drawn.
+	if (glnvg__hasBufferStorage()) {
+		glnvg__createRing(&gl->vertRing, GL_ARRAY_BUFFER, sizeof(GLNVGvertex), 16384);
+		if ((gl->flags & NVG_MERGE_CALLS) == 0)
+			glnvg__createRing(&gl->fragRing, GL_UNIFORM_BUFFER, gl->fragSize, 256);
+	}
+#endif
+
 	// Some platforms does not allow to have samples to unset textures.
 	// Create empty one which is bound when there's no texture specified.
 	gl->dummyTex = glnvg__renderCreateTexture(gl, NVG_TEXTURE_ALPHA, 1, 1, 0, NULL);
@@ -957,13 +1232,15 @@ static int glnvg__convertPaint(GLNVGcontext* gl, GLNVGfragUniforms* frag, NVGpai
 		if (tex->type == NVG_TEXTURE_RGBA)
 			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
 		else
-			frag->texType = 2;
+			frag->texType = (tex->flags & NVG_IMAGE_SDF) ? 3 : 2;
 		#else
 		if (tex->type == NVG_TEXTURE_RGBA)
 			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0.0f : 1.0f;
 		else
-			frag->texType = 2.0f;
+			frag->texType = (tex->flags & NVG_IMAGE_SDF) ? 3.0f : 2.0f;
 		#endif
+		if (tex->flags & NVG_IMAGE_SDF)
+			frag->feather = paint->feather;
 //		printf("frag->texType = %d\n", frag->texType);
 	} else {
 		frag->type = NSVG_SHADER_FILLGRAD;
@@ -979,16 +1256,35 @@ static int glnvg__convertPaint(GLNVGcontext* gl, GLNVGfragUniforms* frag, NVGpai
 
 static GLNVGfragUniforms* nvg__fragUniformPtr(GLNVGcontext* gl, int i);
 
-static void glnvg__setUniforms(GLNVGcontext* gl, int uniformOffset, int image)
+static void glnvg__bindFragUniforms(GLNVGcontext* gl, int uniformOffset)
 {
-	GLNVGtexture* tex = NULL;
+#if !NANOVG_GL_USE_UNIFORMBUFFER
+	GLNVGfragUniforms* frag;
+#endif
+#if NANOVG_GL_USE_STATE_FILTER
+	// Calls which share uniforms are bound only once.
+	if (gl->boundFragOffset == uniformOffset)
+		return;
+	gl->boundFragOffset = uniformOffset;
+#endif
+#if NANOVG_GL_USE_CALLMERGE
+	if (gl->flags & NVG_MERGE_CALLS) {
+		// All vertices of an unmerged call use the same uniforms from the uniform texture.
+		glVertexAttrib1f(2, (float)(uniformOffset / gl->fragSize - gl->fragTexBase));
+		return;
+	}
+#endif
 #if NANOVG_GL_USE_UNIFORMBUFFER
-	glBindBufferRange(GL_UNIFORM_BUFFER, GLNVG_FRAG_BINDING, gl->fragBuf, uniformOffset, sizeof(GLNVGfragUniforms));
+	glBindBufferRange(GL_UNIFORM_BUFFER, GLNVG_FRAG_BINDING, gl->frameFragBuf, gl->frameFragOffset + uniformOffset, sizeof(GLNVGfragUniforms));
 #else
-	GLNVGfragUniforms* frag = nvg__fragUniformPtr(gl, uniformOffset);
+	frag = nvg__fragUniformPtr(gl, uniformOffset);
 	glUniform4fv(gl->shader.loc[GLNVG_LOC_FRAG], NANOVG_GL_UNIFORMARRAY_SIZE, &(frag->uniformArray[0][0]));
 #endif
+}
 
+static void glnvg__bindImage(GLNVGcontext* gl, int image)
+{
+	GLNVGtexture* tex = NULL;
 	if (image != 0) {
 		tex = glnvg__findTexture(gl, image);
 	}
@@ -1000,6 +1296,12 @@ static void glnvg__setUniforms(GLNVGcontext* gl, int uniformOffset, int image)
 	glnvg__checkError(gl, "tex paint tex");
 }
 
+static void glnvg__setUniforms(GLNVGcontext* gl, int uniformOffset, int image)
+{
+	glnvg__bindFragUniforms(gl, uniformOffset);
+	glnvg__bindImage(gl, image);
+}
+
 static void glnvg__renderViewport(void* uptr, float width, float height, float devicePixelRatio)
 {
 	NVG_NOTUSED(devicePixelRatio);
@@ -1027,7 +1329,7 @@ static void glnvg__fill(GLNVGcontext* gl, GLNVGcall* call)
 	glStencilOpSeparate(GL_BACK, GL_KEEP, GL_KEEP, GL_DECR_WRAP);
 	glDisable(GL_CULL_FACE);
 	for (i = 0; i < npaths; i++)
-		glDrawArrays(GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
+		glDrawArrays(paths[i].triangulated ? GL_TRIANGLES : GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
 	glEnable(GL_CULL_FACE);
 
 	// Draw anti-aliased pixels
@@ -1061,7 +1363,7 @@ static void glnvg__convexFill(GLNVGcontext* gl, GLNVGcall* call)
 	glnvg__checkError(gl, "convex fill");
 
 	for (i = 0; i < npaths; i++) {
-		glDrawArrays(GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
+		glDrawArrays(paths[i].triangulated ? GL_TRIANGLES : GL_TRIANGLE_FAN, paths[i].fillOffset, paths[i].fillCount);
 		// Draw fringes
 		if (paths[i].strokeCount > 0) {
 			glDrawArrays(GL_TRIANGLE_STRIP, paths[i].strokeOffset, paths[i].strokeCount);
@@ -1124,12 +1426,301 @@ static void glnvg__triangles(GLNVGcontext* gl, GLNVGcall* call)
 	glDrawArrays(GL_TRIANGLES, call->triangleOffset, call->triangleCount);
 }
 
-static void glnvg__renderCancel(void* uptr) {
-	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+#if NANOVG_GL_USE_CALLMERGE
+static void* glnvg__allocBuffer(GLNVGcontext* gl, void* items, int* citems, int nitems, int n, int minItems, int itemSize);
+static int glnvg__allocVerts(GLNVGcontext* gl, int n);
+
+static void glnvg__mergedTriangles(GLNVGcontext* gl, GLNVGcall* call)
+{
+	glnvg__bindImage(gl, call->image);
+	glnvg__checkError(gl, "merged triangles");
+
+	// The uniform index comes from the per vertex index buffer.
+	glEnableVertexAttribArray(2);
+	glDrawArrays(GL_TRIANGLES, call->triangleOffset, call->triangleCount);
+	glDisableVertexAttribArray(2);
+#if NANOVG_GL_USE_STATE_FILTER
+	// The current index attribute value is undefined after drawing from the array.
+	gl->boundFragOffset = -1;
+#endif
+}
+
+static int glnvg__mergeable(GLNVGcall* a, GLNVGcall* b)
+{
+	if (b->type != GLNVG_TRIANGLES && b->type != GLNVG_CONVEXFILL)
+		return 0;
+	return a->image == b->image &&
+		a->fragBase == b->fragBase &&
+		a->blendFunc.srcRGB == b->blendFunc.srcRGB &&
+		a->blendFunc.dstRGB == b->blendFunc.dstRGB &&
+		a->blendFunc.srcAlpha == b->blendFunc.srcAlpha &&
+		a->blendFunc.dstAlpha == b->blendFunc.dstAlpha;
+}
+
+// Returns the end of the run of calls starting at 'first' which can be drawn with one draw call.
+static int glnvg__mergeRunEnd(GLNVGcontext* gl, int first)
+{
+	int i = first+1;
+	if (!glnvg__mergeable(&gl->calls[first], &gl->calls[first]))
+		return i;
+	while (i < gl->ncalls && glnvg__mergeable(&gl->calls[first], &gl->calls[i]))
+		i++;
+	return i;
+}
+
+// Returns 1 if the run has only triangle calls whose vertices follow each other,
+// in which case the run can be drawn in place.
+static int glnvg__contiguousRun(GLNVGcontext* gl, int first, int end)
+{
+	int i;
+	for (i = first; i < end; i++) {
+		GLNVGcall* call = &gl->calls[i];
+		if (call->type != GLNVG_TRIANGLES)
+			return 0;
+		if (i > first && call->triangleOffset != call[-1].triangleOffset + call[-1].triangleCount)
+			return 0;
+	}
+	return 1;
+}
+
+// Returns the number of vertices the call takes as a triangle list.
+static int glnvg__listVertCount(GLNVGcontext* gl, GLNVGcall* call)
+{
+	GLNVGpath* paths = &gl->paths[call->pathOffset];
+	int i, count = 0;
+	if (call->type == GLNVG_TRIANGLES)
+		return call->triangleCount;
+	for (i = 0; i < call->pathCount; i++) {
+		if (paths[i].triangulated)
+			count += paths[i].fillCount;
+		else if (paths[i].fillCount > 2)
+			count += (paths[i].fillCount - 2) * 3;
+		if (paths[i].strokeCount > 2)
+			count += (paths[i].strokeCount - 2) * 3;
+	}
+	return count;
+}
+
+static int glnvg__fanToList(GLNVGvertex* dst, const GLNVGvertex* src, int n)
+{
+	int i, count = 0;
+	for (i = 2; i < n; i++) {
+		dst[count++] = src[0];
+		dst[count++] = src[i-1];
+		dst[count++] = src[i];
+	}
+	return count;
+}
+
+static int glnvg__stripToList(GLNVGvertex* dst, const GLNVGvertex* src, int n)
+{
+	int i, count = 0;
+	for (i = 2; i < n; i++) {
+		// Every other triangle of a strip is flipped to keep the winding for culling.
+		if (i & 1) {
+			dst[count++] = src[i-1];
+			dst[count++] = src[i-2];
+		} else {
+			dst[count++] = src[i-2];
+			dst[count++] = src[i-1];
+		}
+		dst[count++] = src[i];
+	}
+	return count;
+}
+
+static void glnvg__setFragIndices(GLNVGcontext* gl, int offset, int count, GLNVGcall* call)
+{
+	float index = (float)(call->uniformOffset / gl->fragSize - call->fragBase);
+	int i;
+	for (i = 0; i < count; i++)
+		gl->fragIndices[offset + i] = index;
+}
+
+// Merges runs of consecutive triangle and convex fill calls with the same image and blending
+// into single triangle list calls. Fans and strips are converted to triangle lists appended
+// to the vertex data, so that the draw order stays the same. Returns the number of merged calls.
+static int glnvg__mergeCalls(GLNVGcontext* gl)
+{
+	int i, j, k, n, first, offset, extra = 0, nmerged = 0;
+	float* indices;
+
+	for (i = 0; i < gl->ncalls; i = j) {
+		j = glnvg__mergeRunEnd(gl, i);
+		if (j - i < 2)
+			continue;
+		if (!glnvg__contiguousRun(gl, i, j)) {
+			for (k = i; k < j; k++)
+				extra += glnvg__listVertCount(gl, &gl->calls[k]);
+		}
+		nmerged++;
+	}
+	if (nmerged == 0) return 0;
+
+	offset = glnvg__allocVerts(gl, extra);
+	if (offset == -1) return 0;
+	indices = (float*)glnvg__allocBuffer(gl, gl->fragIndices, &gl->cfragIndices, 0, gl->nverts, 4096, sizeof(float));
+	if (indices == NULL) return 0;
+	gl->fragIndices = indices;
+
+	for (i = 0; i < gl->ncalls; i = j) {
+		j = glnvg__mergeRunEnd(gl, i);
+		if (j - i < 2)
+			continue;
+		if (glnvg__contiguousRun(gl, i, j)) {
+			first = gl->calls[i].triangleOffset;
+			for (k = i; k < j; k++)
+				glnvg__setFragIndices(gl, gl->calls[k].triangleOffset, gl->calls[k].triangleCount, &gl->calls[k]);
+			n = gl->calls[j-1].triangleOffset + gl->calls[j-1].triangleCount - first;
+		} else {
+			first = offset;
+			for (k = i; k < j; k++) {
+				GLNVGcall* call = &gl->calls[k];
+				GLNVGpath* paths = &gl->paths[call->pathOffset];
+				int p, start = offset;
+				if (call->type == GLNVG_TRIANGLES) {
+					memcpy(&gl->verts[offset], &gl->verts[call->triangleOffset], sizeof(GLNVGvertex) * call->triangleCount);
+					offset += call->triangleCount;
+				} else {
+					for (p = 0; p < call->pathCount; p++) {
+						if (paths[p].triangulated) {
+							memcpy(&gl->verts[offset], &gl->verts[paths[p].fillOffset], sizeof(GLNVGvertex) * paths[p].fillCount);
+							offset += paths[p].fillCount;
+						} else {
+							offset += glnvg__fanToList(&gl->verts[offset], &gl->verts[paths[p].fillOffset], paths[p].fillCount);
+						}
+						offset += glnvg__stripToList(&gl->verts[offset], &gl->verts[paths[p].strokeOffset], paths[p].strokeCount);
+					}
+				}
+				glnvg__setFragIndices(gl, start, offset - start, call);
+			}
+			n = offset - first;
+		}
+		gl->calls[i].type = GLNVG_MERGED;
+		gl->calls[i].triangleOffset = first;
+		gl->calls[i].triangleCount = n;
+		for (k = i+1; k < j; k++)
+			gl->calls[k].type = GLNVG_NONE;
+	}
+
+	return nmerged;
+}
+
+// Returns the number of uniform sets the call uses, fills and stencil strokes use two.
+static int glnvg__fragCount(GLNVGcontext* gl, GLNVGcall* call)
+{
+	if (call->type == GLNVG_FILL || (call->type == GLNVG_STROKE && (gl->flags & NVG_STENCIL_STROKES)))
+		return 2;
+	return 1;
+}
+
+// Splits the calls into batches whose uniform sets fit in the uniform texture, and sets the
+// first uniform set of the batch of each call.
+static void glnvg__batchFragUniforms(GLNVGcontext* gl)
+{
+	int i, j, k, lo, hi, first, end;
+	int maxFrags = gl->fragTexMaxRows * GLNVG_FRAGS_PER_ROW;
+
+	for (i = 0; i < gl->ncalls; i = j) {
+		lo = gl->calls[i].uniformOffset / gl->fragSize;
+		hi = lo + glnvg__fragCount(gl, &gl->calls[i]);
+		// Deduplicated uniforms may be anywhere before the call, so track the whole range.
+		for (j = i+1; j < gl->ncalls; j++) {
+			first = gl->calls[j].uniformOffset / gl->fragSize;
+			end = first + glnvg__fragCount(gl, &gl->calls[j]);
+			if (glnvg__maxi(hi, end) - glnvg__mini(lo, first) > maxFrags)
+				break;
+			lo = glnvg__mini(lo, first);
+			hi = glnvg__maxi(hi, end);
+		}
+		for (k = i; k < j; k++)
+			gl->calls[k].fragBase = lo;
+	}
+}
+
+// Uploads the uniform sets starting at 'base' to the uniform texture, as many as fit.
+static void glnvg__uploadFragTexture(GLNVGcontext* gl, int base)
+{
+	int i, rows, width = GLNVG_FRAGS_PER_ROW * GLNVG_FRAG_TEXELS, n = gl->nuniforms - base;
+	float* texels;
+
+	if (n > gl->fragTexMaxRows * GLNVG_FRAGS_PER_ROW)
+		n = gl->fragTexMaxRows * GLNVG_FRAGS_PER_ROW;
+	rows = (n + GLNVG_FRAGS_PER_ROW-1) / GLNVG_FRAGS_PER_ROW;
+	gl->fragTexBase = base;
+#if NANOVG_GL_USE_STATE_FILTER
+	// The same uniform offset has a different index in the new batch.
+	gl->boundFragOffset = -1;
+#endif
+
+	texels = (float*)glnvg__allocBuffer(gl, gl->fragTexels, &gl->cfragTexels, 0, rows * width * 4, 4096, sizeof(float));
+	if (texels == NULL) return;
+	gl->fragTexels = texels;
+
+	for (i = 0; i < n; i++) {
+		GLNVGfragUniforms* frag = nvg__fragUniformPtr(gl, (base + i) * gl->fragSize);
+		float* dst = &texels[i * GLNVG_FRAG_TEXELS * 4];
+		// Everything before the types is floats in both uniform layouts.
+		memcpy(dst, frag, offsetof(GLNVGfragUniforms, texType));
+		dst[GLNVG_FRAG_TEXELS*4-2] = (float)frag->texType;
+		dst[GLNVG_FRAG_TEXELS*4-1] = (float)frag->type;
+	}
+
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, gl->fragTex);
+	if (rows > gl->fragTexRows) {
+		gl->fragTexRows = glnvg__mini(glnvg__maxi(rows, gl->fragTexRows + gl->fragTexRows/2), gl->fragTexMaxRows);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, gl->fragTexRows, 0, GL_RGBA, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+	if (rows > 0)
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, rows, GL_RGBA, GL_FLOAT, texels);
+	glActiveTexture(GL_TEXTURE0);
+	glnvg__checkError(gl, "upload uniform texture");
+}
+#endif
+
+static void glnvg__resetFrameBuffers(GLNVGcontext* gl)
+{
 	gl->nverts = 0;
 	gl->npaths = 0;
 	gl->ncalls = 0;
 	gl->nuniforms = 0;
+	memset(gl->fragHash, 0, sizeof(gl->fragHash));
+
+#if NANOVG_GL_USE_BUFFERSTORAGE
+	// The next frame writes to the next ring segment. A frame whose vertices overflowed the ring
+	// was built in CPU memory, which is released unless it came from the frame allocator.
+	if (gl->vertRing.buf != 0 && (gl->flags & NVG_MERGE_CALLS) == 0) {
+		if (gl->vertRing.overflow > 0 && gl->frameAllocator.alloc == NULL)
+			nvgInternalFree(gl->verts);
+		gl->verts = NULL;
+	}
+	gl->vertRing.mapped = 0;
+	gl->vertRing.overflow = 0;
+	gl->vertRing.prefix = 0;
+	gl->fragRing.mapped = 0;
+	gl->fragRing.overflow = 0;
+#endif
+
+	// The memory is released when the frame allocator is reset, keep the capacities
+	// so that the next frame allocates the buffers at once.
+	if (gl->frameAllocator.alloc != NULL) {
+		gl->calls = NULL;
+		gl->paths = NULL;
+		gl->verts = NULL;
+		gl->uniforms = NULL;
+#if NANOVG_GL_USE_CALLMERGE
+		gl->fragIndices = NULL;
+		gl->fragTexels = NULL;
+#endif
+	}
+}
+
+static void glnvg__renderCancel(void* uptr) {
+	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	glnvg__resetFrameBuffers(gl);
 }
 
 static GLenum glnvg_convertBlendFuncFactor(int factor)
@@ -1179,10 +1770,24 @@ static GLNVGblend glnvg__blendCompositeOperation(NVGcompositeOperationState op)
 static void glnvg__renderFlush(void* uptr)
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
+	GLuint vertBuf = gl->vertBuf;
+	size_t vertOffset = 0;
 	int i;
+#if NANOVG_GL_USE_CALLMERGE
+	int nmerged = 0;
+#endif
 
 	if (gl->ncalls > 0) {
 
+#if NANOVG_GL_USE_CALLMERGE
+		if (gl->flags & NVG_MERGE_CALLS) {
+			// The uniform texture is uploaded before the first call of each batch.
+			glnvg__batchFragUniforms(gl);
+			gl->fragTexBase = -1;
+			nmerged = glnvg__mergeCalls(gl);
+		}
+#endif
+
 		// Setup require GL state.
 		glUseProgram(gl->shader.prog);
 
@@ -1200,6 +1805,7 @@ static void glnvg__renderFlush(void* uptr)
 		glBindTexture(GL_TEXTURE_2D, 0);
 		#if NANOVG_GL_USE_STATE_FILTER
 		gl->boundTexture = 0;
+		gl->boundFragOffset = -1;
 		gl->stencilMask = 0xffffffff;
 		gl->stencilFunc = GL_ALWAYS;
 		gl->stencilFuncRef = 0;
@@ -1212,31 +1818,96 @@ static void glnvg__renderFlush(void* uptr)
 
 #if NANOVG_GL_USE_UNIFORMBUFFER
 		// Upload ubo for frag shaders
-		glBindBuffer(GL_UNIFORM_BUFFER, gl->fragBuf);
-		glBufferData(GL_UNIFORM_BUFFER, gl->nuniforms * gl->fragSize, gl->uniforms, GL_STREAM_DRAW);
+		gl->frameFragBuf = gl->fragBuf;
+		gl->frameFragOffset = 0;
+#if NANOVG_GL_USE_BUFFERSTORAGE
+		// The uniforms are built in CPU memory, because they are compared with the earlier ones when added.
+		if ((gl->flags & NVG_MERGE_CALLS) == 0) {
+			int offset = glnvg__copyToRing(&gl->fragRing, gl->uniforms, gl->nuniforms);
+			if (offset != -1) {
+				gl->frameFragBuf = gl->fragRing.buf;
+				gl->frameFragOffset = offset;
+			}
+		}
+#endif
+		if ((gl->flags & NVG_MERGE_CALLS) == 0 && gl->frameFragBuf == gl->fragBuf) {
+			glBindBuffer(GL_UNIFORM_BUFFER, gl->fragBuf);
+			glBufferData(GL_UNIFORM_BUFFER, gl->nuniforms * gl->fragSize, gl->uniforms, GL_STREAM_DRAW);
+		}
 #endif
 
 		// Upload vertex data
 #if defined NANOVG_GL3
 		glBindVertexArray(gl->vertArr);
 #endif
-		glBindBuffer(GL_ARRAY_BUFFER, gl->vertBuf);
-		glBufferData(GL_ARRAY_BUFFER, gl->nverts * sizeof(NVGvertex), gl->verts, GL_STREAM_DRAW);
+#if NANOVG_GL_USE_CALLMERGE
+		if (nmerged > 0) {
+			glBindBuffer(GL_ARRAY_BUFFER, gl->fragIndexBuf);
+			glBufferData(GL_ARRAY_BUFFER, gl->nverts * sizeof(float), gl->fragIndices, GL_STREAM_DRAW);
+			glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(float), (const GLvoid*)(size_t)0);
+		}
+#endif
+#if NANOVG_GL_USE_BUFFERSTORAGE
+		if (gl->flags & NVG_MERGE_CALLS) {
+			// Merging reads the vertices back, they were built in CPU memory.
+			int offset = glnvg__copyToRing(&gl->vertRing, gl->verts, gl->nverts);
+			if (offset != -1) {
+				vertBuf = gl->vertRing.buf;
+				vertOffset = (size_t)offset;
+			}
+		} else if (gl->vertRing.mapped && gl->vertRing.overflow == 0) {
+			// Already written to the ring buffer.
+			vertBuf = gl->vertRing.buf;
+			vertOffset = (size_t)gl->vertRing.segment * gl->vertRing.count * sizeof(GLNVGvertex);
+		}
+#endif
+		glBindBuffer(GL_ARRAY_BUFFER, vertBuf);
+		if (vertBuf == gl->vertBuf) {
+#if NANOVG_GL_USE_BUFFERSTORAGE
+			if (gl->vertRing.prefix > 0) {
+				// The start of the frame is in the ring segment, it is copied on the GPU instead of read back.
+				GLsizeiptr prefix = (GLsizeiptr)gl->vertRing.prefix * sizeof(GLNVGvertex);
+				glBufferData(GL_ARRAY_BUFFER, gl->nverts * sizeof(GLNVGvertex), NULL, GL_STREAM_DRAW);
+				glBufferSubData(GL_ARRAY_BUFFER, prefix, gl->nverts * sizeof(GLNVGvertex) - prefix, &gl->verts[gl->vertRing.prefix]);
+				glBindBuffer(GL_COPY_READ_BUFFER, gl->vertRing.buf);
+				glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, (GLintptr)gl->vertRing.segment * gl->vertRing.count * sizeof(GLNVGvertex), 0, prefix);
+				glBindBuffer(GL_COPY_READ_BUFFER, 0);
+			} else
+#endif
+			glBufferData(GL_ARRAY_BUFFER, gl->nverts * sizeof(GLNVGvertex), gl->verts, GL_STREAM_DRAW);
+		}
 		glEnableVertexAttribArray(0);
 		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(NVGvertex), (const GLvoid*)(size_t)0);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(NVGvertex), (const GLvoid*)(0 + 2*sizeof(float)));
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(GLNVGvertex), (const GLvoid*)(vertOffset));
+#ifdef NANOVG_GL_COMPACT_VERTICES
+		glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(GLNVGvertex), (const GLvoid*)(vertOffset + 2*sizeof(float)));
+#else
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GLNVGvertex), (const GLvoid*)(vertOffset + 2*sizeof(float)));
+#endif
 
 		// Set view and texture just once per frame.
 		glUniform1i(gl->shader.loc[GLNVG_LOC_TEX], 0);
 		glUniform2fv(gl->shader.loc[GLNVG_LOC_VIEWSIZE], 1, gl->view);
+#if NANOVG_GL_USE_CALLMERGE
+		if (gl->flags & NVG_MERGE_CALLS) {
+			glUniform1i(gl->shader.loc[GLNVG_LOC_FRAGTEX], 1);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, gl->fragTex);
+			glActiveTexture(GL_TEXTURE0);
+		}
+#endif
 
 #if NANOVG_GL_USE_UNIFORMBUFFER
-		glBindBuffer(GL_UNIFORM_BUFFER, gl->fragBuf);
+		if ((gl->flags & NVG_MERGE_CALLS) == 0)
+			glBindBuffer(GL_UNIFORM_BUFFER, gl->frameFragBuf);
 #endif
 
 		for (i = 0; i < gl->ncalls; i++) {
 			GLNVGcall* call = &gl->calls[i];
+#if NANOVG_GL_USE_CALLMERGE
+			if ((gl->flags & NVG_MERGE_CALLS) && call->fragBase != gl->fragTexBase)
+				glnvg__uploadFragTexture(gl, call->fragBase);
+#endif
 			glnvg__blendFuncSeparate(gl,&call->blendFunc);
 			if (call->type == GLNVG_FILL)
 				glnvg__fill(gl, call);
@@ -1246,24 +1917,36 @@ static void glnvg__renderFlush(void* uptr)
 				glnvg__stroke(gl, call);
 			else if (call->type == GLNVG_TRIANGLES)
 				glnvg__triangles(gl, call);
+#if NANOVG_GL_USE_CALLMERGE
+			else if (call->type == GLNVG_MERGED)
+				glnvg__mergedTriangles(gl, call);
+#endif
 		}
 
 		glDisableVertexAttribArray(0);
 		glDisableVertexAttribArray(1);
 #if defined NANOVG_GL3
 		glBindVertexArray(0);
+#endif
+#if NANOVG_GL_USE_BUFFERSTORAGE
+		glnvg__releaseRing(&gl->vertRing);
+		glnvg__releaseRing(&gl->fragRing);
 #endif
 		glDisable(GL_CULL_FACE);
 			glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glUseProgram(0);
 		glnvg__bindTexture(gl, 0);
+#if NANOVG_GL_USE_CALLMERGE
+		if (gl->flags & NVG_MERGE_CALLS) {
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			glActiveTexture(GL_TEXTURE0);
+		}
+#endif
 	}
 
 	// Reset calls
-	gl->nverts = 0;
-	gl->npaths = 0;
-	gl->ncalls = 0;
-	gl->nuniforms = 0;
+	glnvg__resetFrameBuffers(gl);
 }
 
 static int glnvg__maxVertCount(const NVGpath* paths, int npaths)
@@ -1276,17 +1959,72 @@ static int glnvg__maxVertCount(const NVGpath* paths, int npaths)
 	return count;
 }
 
+// Makes room for n more items to a per frame buffer and returns the new buffer, or NULL on failure.
+static void* glnvg__allocBuffer(GLNVGcontext* gl, void* items, int* citems, int nitems, int n, int minItems, int itemSize)
+{
+	void* ret;
+	int c;
+
+	if (items != NULL && nitems+n <= *citems)
+		return items;
+
+	if (items == NULL)
+		c = glnvg__maxi(glnvg__maxi(nitems+n, minItems), *citems); // Start from the size of the previous frame.
+	else
+		c = glnvg__maxi(nitems+n, minItems) + *citems/2; // 1.5x Overallocate
+
+	if (gl->frameAllocator.alloc != NULL) {
+		ret = gl->frameAllocator.alloc(gl->frameAllocator.userPtr, itemSize * c);
+		if (ret != NULL && nitems > 0)
+			memcpy(ret, items, itemSize * nitems);
+	} else {
+		ret = nvgInternalRealloc(gl->allocator, NVG_MEMORY_BACKEND, items, itemSize * c);
+	}
+	if (ret == NULL) return NULL;
+
+	*citems = c;
+	return ret;
+}
+
+#if NANOVG_GL_USE_BUFFERSTORAGE
+// Makes room for n more items to a per frame buffer which is written directly to the ring buffer.
+// When the frame does not fit into the ring segment, the rest of the frame is built in CPU memory.
+// The items already in the segment are not read back, the CPU memory before them is left unused.
+static void* glnvg__allocStream(GLNVGcontext* gl, GLNVGring* ring, void* items, int* citems, int nitems, int n, int minItems, int itemSize)
+{
+	void* ret;
+	int c = 0;
+
+	if (ring->buf == 0)
+		return glnvg__allocBuffer(gl, items, citems, nitems, n, minItems, itemSize);
+	if (ring->overflow > 0) {
+		// Already overflowed, remember how much the whole frame needs.
+		ring->overflow = nitems+n;
+		return glnvg__allocBuffer(gl, items, citems, nitems, n, minItems, itemSize);
+	}
+
+	if (items == NULL) {
+		items = glnvg__acquireRing(ring);
+		*citems = ring->count;
+	}
+	if (nitems+n <= *citems)
+		return items;
+
+	ret = glnvg__allocBuffer(gl, NULL, &c, 0, nitems+n, minItems, itemSize);
+	if (ret == NULL) return NULL;
+	*citems = c;
+	ring->prefix = nitems;
+	ring->overflow = nitems+n;
+	return ret;
+}
+#endif
+
 static GLNVGcall* glnvg__allocCall(GLNVGcontext* gl)
 {
 	GLNVGcall* ret = NULL;
-	if (gl->ncalls+1 > gl->ccalls) {
-		GLNVGcall* calls;
-		int ccalls = glnvg__maxi(gl->ncalls+1, 128) + gl->ccalls/2; // 1.5x Overallocate
-		calls = (GLNVGcall*)realloc(gl->calls, sizeof(GLNVGcall) * ccalls);
-		if (calls == NULL) return NULL;
-		gl->calls = calls;
-		gl->ccalls = ccalls;
-	}
+	GLNVGcall* calls = (GLNVGcall*)glnvg__allocBuffer(gl, gl->calls, &gl->ccalls, gl->ncalls, 1, 128, sizeof(GLNVGcall));
+	if (calls == NULL) return NULL;
+	gl->calls = calls;
 	ret = &gl->calls[gl->ncalls++];
 	memset(ret, 0, sizeof(GLNVGcall));
 	return ret;
@@ -1295,14 +2033,9 @@ static GLNVGcall* glnvg__allocCall(GLNVGcontext* gl)
 static int glnvg__allocPaths(GLNVGcontext* gl, int n)
 {
 	int ret = 0;
-	if (gl->npaths+n > gl->cpaths) {
-		GLNVGpath* paths;
-		int cpaths = glnvg__maxi(gl->npaths + n, 128) + gl->cpaths/2; // 1.5x Overallocate
-		paths = (GLNVGpath*)realloc(gl->paths, sizeof(GLNVGpath) * cpaths);
-		if (paths == NULL) return -1;
-		gl->paths = paths;
-		gl->cpaths = cpaths;
-	}
+	GLNVGpath* paths = (GLNVGpath*)glnvg__allocBuffer(gl, gl->paths, &gl->cpaths, gl->npaths, n, 128, sizeof(GLNVGpath));
+	if (paths == NULL) return -1;
+	gl->paths = paths;
 	ret = gl->npaths;
 	gl->npaths += n;
 	return ret;
@@ -1311,14 +2044,16 @@ static int glnvg__allocPaths(GLNVGcontext* gl, int n)
 static int glnvg__allocVerts(GLNVGcontext* gl, int n)
 {
 	int ret = 0;
-	if (gl->nverts+n > gl->cverts) {
-		NVGvertex* verts;
-		int cverts = glnvg__maxi(gl->nverts + n, 4096) + gl->cverts/2; // 1.5x Overallocate
-		verts = (NVGvertex*)realloc(gl->verts, sizeof(NVGvertex) * cverts);
-		if (verts == NULL) return -1;
-		gl->verts = verts;
-		gl->cverts = cverts;
-	}
+	GLNVGvertex* verts;
+#if NANOVG_GL_USE_BUFFERSTORAGE
+	// Merging reads the vertices back, they are built in CPU memory and copied to the ring when drawn.
+	if ((gl->flags & NVG_MERGE_CALLS) == 0)
+		verts = (GLNVGvertex*)glnvg__allocStream(gl, &gl->vertRing, gl->verts, &gl->cverts, gl->nverts, n, 4096, sizeof(GLNVGvertex));
+	else
+#endif
+	verts = (GLNVGvertex*)glnvg__allocBuffer(gl, gl->verts, &gl->cverts, gl->nverts, n, 4096, sizeof(GLNVGvertex));
+	if (verts == NULL) return -1;
+	gl->verts = verts;
 	ret = gl->nverts;
 	gl->nverts += n;
 	return ret;
@@ -1327,14 +2062,9 @@ static int glnvg__allocVerts(GLNVGcontext* gl, int n)
 static int glnvg__allocFragUniforms(GLNVGcontext* gl, int n)
 {
 	int ret = 0, structSize = gl->fragSize;
-	if (gl->nuniforms+n > gl->cuniforms) {
-		unsigned char* uniforms;
-		int cuniforms = glnvg__maxi(gl->nuniforms+n, 128) + gl->cuniforms/2; // 1.5x Overallocate
-		uniforms = (unsigned char*)realloc(gl->uniforms, structSize * cuniforms);
-		if (uniforms == NULL) return -1;
-		gl->uniforms = uniforms;
-		gl->cuniforms = cuniforms;
-	}
+	unsigned char* uniforms = (unsigned char*)glnvg__allocBuffer(gl, gl->uniforms, &gl->cuniforms, gl->nuniforms, n, 128, structSize);
+	if (uniforms == NULL) return -1;
+	gl->uniforms = uniforms;
 	ret = gl->nuniforms * structSize;
 	gl->nuniforms += n;
 	return ret;
@@ -1345,12 +2075,72 @@ static GLNVGfragUniforms* nvg__fragUniformPtr(GLNVGcontext* gl, int i)
 	return (GLNVGfragUniforms*)&gl->uniforms[i];
 }
 
-static void glnvg__vset(NVGvertex* vtx, float x, float y, float u, float v)
+// Returns the offset of identical uniforms written earlier in the frame, and releases the n uniforms
+// at offset, which must be the last ones allocated. Otherwise the uniforms are remembered for later
+// calls and offset is returned.
+static int glnvg__dedupFragUniforms(GLNVGcontext* gl, int offset, int n)
+{
+	const unsigned int* words;
+	unsigned int h = 2166136261u;
+	int i, j, nwords = (int)(sizeof(GLNVGfragUniforms) / sizeof(unsigned int));
+	GLNVGfragHash* entry;
+
+	// FNV-1a over the uniform words, the padding up to fragSize is not initialized.
+	for (i = 0; i < n; i++) {
+		words = (const unsigned int*)&gl->uniforms[offset + i*gl->fragSize];
+		for (j = 0; j < nwords; j++)
+			h = (h ^ words[j]) * 16777619u;
+	}
+
+	entry = &gl->fragHash[(h ^ (h >> 16)) & (GLNVG_FRAG_HASH_SIZE-1)];
+	if (entry->count == n && entry->hash == h) {
+		for (i = 0; i < n; i++) {
+			if (memcmp(&gl->uniforms[entry->offset + i*gl->fragSize], &gl->uniforms[offset + i*gl->fragSize], sizeof(GLNVGfragUniforms)) != 0)
+				break;
+		}
+		if (i == n) {
+			gl->nuniforms -= n;
+			return entry->offset;
+		}
+	}
+
+	entry->hash = h;
+	entry->offset = offset;
+	entry->count = n;
+	return offset;
+}
+
+#ifdef NANOVG_GL_COMPACT_VERTICES
+static unsigned short glnvg__unorm16(float a)
+{
+	if (a < 0.0f) a = 0.0f;
+	if (a > 1.0f) a = 1.0f;
+	return (unsigned short)(a * 65535.0f + 0.5f);
+}
+#endif
+
+static void glnvg__vset(GLNVGvertex* vtx, float x, float y, float u, float v)
 {
 	vtx->x = x;
 	vtx->y = y;
+#ifdef NANOVG_GL_COMPACT_VERTICES
+	vtx->u = glnvg__unorm16(u);
+	vtx->v = glnvg__unorm16(v);
+#else
 	vtx->u = u;
 	vtx->v = v;
+#endif
+}
+
+static void glnvg__copyVerts(GLNVGvertex* dst, const NVGvertex* src, int n)
+{
+#ifdef NANOVG_GL_COMPACT_VERTICES
+	int i;
+	for (i = 0; i < n; i++)
+		glnvg__vset(&dst[i], src[i].x, src[i].y, src[i].u, src[i].v);
+#else
+	memcpy(dst, src, sizeof(NVGvertex) * n);
+#endif
 }
 
 static void glnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
@@ -1358,7 +2148,7 @@ static void glnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperation
 {
 	GLNVGcontext* gl = (GLNVGcontext*)uptr;
 	GLNVGcall* call = glnvg__allocCall(gl);
-	NVGvertex* quad;
+	GLNVGvertex* quad;
 	GLNVGfragUniforms* frag;
 	int i, maxverts, offset;
 
@@ -1372,7 +2162,8 @@ static void glnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperation
 	call->image = paint->image;
 	call->blendFunc = glnvg__blendCompositeOperation(compositeOperation);
 
-	if (npaths == 1 && paths[0].convex)
+	// Triangulated fills with a fringe are stenciled, so that the fringe is not drawn over the fill.
+	if (npaths == 1 && (paths[0].convex || (paths[0].triangulated && paths[0].nstroke == 0)))
 	{
 		call->type = GLNVG_CONVEXFILL;
 		call->triangleCount = 0;	// Bounding box fill quad not needed for convex fill
@@ -1390,13 +2181,14 @@ static void glnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperation
 		if (path->nfill > 0) {
 			copy->fillOffset = offset;
 			copy->fillCount = path->nfill;
-			memcpy(&gl->verts[offset], path->fill, sizeof(NVGvertex) * path->nfill);
+			copy->triangulated = path->triangulated;
+			glnvg__copyVerts(&gl->verts[offset], path->fill, path->nfill);
 			offset += path->nfill;
 		}
 		if (path->nstroke > 0) {
 			copy->strokeOffset = offset;
 			copy->strokeCount = path->nstroke;
-			memcpy(&gl->verts[offset], path->stroke, sizeof(NVGvertex) * path->nstroke);
+			glnvg__copyVerts(&gl->verts[offset], path->stroke, path->nstroke);
 			offset += path->nstroke;
 		}
 	}
@@ -1426,6 +2218,7 @@ static void glnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperation
 		// Fill shader
 		glnvg__convertPaint(gl, nvg__fragUniformPtr(gl, call->uniformOffset), paint, scissor, fringe, fringe, -1.0f);
 	}
+	call->uniformOffset = glnvg__dedupFragUniforms(gl, call->uniformOffset, call->type == GLNVG_FILL ? 2 : 1);
 
 	return;
 
@@ -1463,7 +2256,7 @@ static void glnvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperati
 		if (path->nstroke) {
 			copy->strokeOffset = offset;
 			copy->strokeCount = path->nstroke;
-			memcpy(&gl->verts[offset], path->stroke, sizeof(NVGvertex) * path->nstroke);
+			glnvg__copyVerts(&gl->verts[offset], path->stroke, path->nstroke);
 			offset += path->nstroke;
 		}
 	}
@@ -1482,6 +2275,7 @@ static void glnvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperati
 		if (call->uniformOffset == -1) goto error;
 		glnvg__convertPaint(gl, nvg__fragUniformPtr(gl, call->uniformOffset), paint, scissor, strokeWidth, fringe, -1.0f);
 	}
+	call->uniformOffset = glnvg__dedupFragUniforms(gl, call->uniformOffset, (gl->flags & NVG_STENCIL_STROKES) ? 2 : 1);
 
 	return;
 
@@ -1509,7 +2303,7 @@ static void glnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOper
 	if (call->triangleOffset == -1) goto error;
 	call->triangleCount = nverts;
 
-	memcpy(&gl->verts[call->triangleOffset], verts, sizeof(NVGvertex) * nverts);
+	glnvg__copyVerts(&gl->verts[call->triangleOffset], verts, nverts);
 
 	// Fill shader
 	call->uniformOffset = glnvg__allocFragUniforms(gl, 1);
@@ -1517,6 +2311,7 @@ static void glnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOper
 	frag = nvg__fragUniformPtr(gl, call->uniformOffset);
 	glnvg__convertPaint(gl, frag, paint, scissor, 1.0f, fringe, -1.0f);
 	frag->type = NSVG_SHADER_IMG;
+	call->uniformOffset = glnvg__dedupFragUniforms(gl, call->uniformOffset, 1);
 
 	return;
 
@@ -1544,39 +2339,81 @@ static void glnvg__renderDelete(void* uptr)
 #endif
 	if (gl->vertBuf != 0)
 		glDeleteBuffers(1, &gl->vertBuf);
+#if NANOVG_GL_USE_BUFFERSTORAGE
+	if (gl->vertRing.buf != 0 && (gl->flags & NVG_MERGE_CALLS) == 0 && gl->vertRing.overflow == 0)
+		gl->verts = NULL;
+	glnvg__deleteRing(&gl->vertRing);
+	glnvg__deleteRing(&gl->fragRing);
+#endif
+#if NANOVG_GL_USE_CALLMERGE
+	if (gl->fragIndexBuf != 0)
+		glDeleteBuffers(1, &gl->fragIndexBuf);
+	if (gl->fragTex != 0)
+		glDeleteTextures(1, &gl->fragTex);
+#endif
 
 	for (i = 0; i < gl->ntextures; i++) {
 		if (gl->textures[i].tex != 0 && (gl->textures[i].flags & NVG_IMAGE_NODELETE) == 0)
 			glDeleteTextures(1, &gl->textures[i].tex);
 	}
-	free(gl->textures);
-
-	free(gl->paths);
-	free(gl->verts);
-	free(gl->uniforms);
-	free(gl->calls);
+	nvgInternalFree(gl->textures);
+
+	if (gl->frameAllocator.alloc == NULL) {
+		nvgInternalFree(gl->paths);
+		nvgInternalFree(gl->verts);
+		nvgInternalFree(gl->uniforms);
+		nvgInternalFree(gl->calls);
+#if NANOVG_GL_USE_CALLMERGE
+		nvgInternalFree(gl->fragIndices);
+		nvgInternalFree(gl->fragTexels);
+#endif
+	}
 
-	free(gl);
+	nvgInternalFree(gl);
 }
 
 
 #if defined NANOVG_GL2
 NVGcontext* nvgCreateGL2(int flags)
+{
+	return nvgCreateGL2WithAllocator(flags, NULL);
+}
 #elif defined NANOVG_GL3
 NVGcontext* nvgCreateGL3(int flags)
+{
+	return nvgCreateGL3WithAllocator(flags, NULL);
+}
 #elif defined NANOVG_GLES2
 NVGcontext* nvgCreateGLES2(int flags)
+{
+	return nvgCreateGLES2WithAllocator(flags, NULL);
+}
 #elif defined NANOVG_GLES3
 NVGcontext* nvgCreateGLES3(int flags)
+{
+	return nvgCreateGLES3WithAllocator(flags, NULL);
+}
+#endif
+
+#if defined NANOVG_GL2
+NVGcontext* nvgCreateGL2WithAllocator(int flags, NVGallocator* allocator)
+#elif defined NANOVG_GL3
+NVGcontext* nvgCreateGL3WithAllocator(int flags, NVGallocator* allocator)
+#elif defined NANOVG_GLES2
+NVGcontext* nvgCreateGLES2WithAllocator(int flags, NVGallocator* allocator)
+#elif defined NANOVG_GLES3
+NVGcontext* nvgCreateGLES3WithAllocator(int flags, NVGallocator* allocator)
 #endif
 {
 	NVGparams params;
 	NVGcontext* ctx = NULL;
-	GLNVGcontext* gl = (GLNVGcontext*)malloc(sizeof(GLNVGcontext));
+	GLNVGcontext* gl = (GLNVGcontext*)nvgInternalAlloc(allocator, NVG_MEMORY_BACKEND, sizeof(GLNVGcontext));
 	if (gl == NULL) goto error;
 	memset(gl, 0, sizeof(GLNVGcontext));
+	gl->allocator = allocator;
 
 	memset(&params, 0, sizeof(params));
+	params.allocator = allocator;
 	params.renderCreate = glnvg__renderCreate;
 	params.renderCreateTexture = glnvg__renderCreateTexture;
 	params.renderDeleteTexture = glnvg__renderDeleteTexture;
@@ -1591,12 +2428,17 @@ NVGcontext* nvgCreateGLES3(int flags)
 	params.renderDelete = glnvg__renderDelete;
 	params.userPtr = gl;
 	params.edgeAntiAlias = flags & NVG_ANTIALIAS ? 1 : 0;
+	params.sdfText = flags & NVG_SDF_TEXT ? 1 : 0;
+	params.triangulatedFills = 1;
 
 	gl->flags = flags;
 
 	ctx = nvgCreateInternal(&params);
 	if (ctx == NULL) goto error;
 
+	gl->allocator = nvgInternalParams(ctx)->allocator;
+	gl->frameAllocator = nvgInternalParams(ctx)->frameAllocator;
+
 	return ctx;
 
 error:
@@ -0,0 +1,1302 @@
+//
+// Copyright (c) 2009-2013 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+#ifndef NANOVG_SW_H
+#define NANOVG_SW_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Create flags, shared with the OpenGL back-end.
+
+#ifndef NANOVG_CREATE_FLAGS
+#define NANOVG_CREATE_FLAGS
+enum NVGcreateFlags {
+	// Flag indicating if geometry based anti-aliasing is used (may not be needed when using MSAA).
+	NVG_ANTIALIAS 		= 1<<0,
+	// Flag indicating if strokes should be drawn using stencil buffer. The rendering will be a little
+	// slower, but path overlaps (i.e. self-intersecting or sharp turns) will be drawn just once.
+	NVG_STENCIL_STROKES	= 1<<1,
+	// Flag indicating that additional debug checks are done.
+	NVG_DEBUG 			= 1<<2,
+	// Flag indicating that text is rendered from signed distance field glyphs, which are scaled
+	// to any size from a few cached sizes instead of being rasterized for each size.
+	NVG_SDF_TEXT		= 1<<3,
+	// Flag indicating that consecutive triangle and convex fill calls with the same image and blending
+	// are merged into a single draw call. Only the GL3 and GLES3 back-ends merge calls.
+	NVG_MERGE_CALLS		= 1<<4,
+};
+#endif
+
+// Creates NanoVG context which renders on the CPU into a RGBA8 pixel buffer.
+// The rasterizer follows the OpenGL back-end step by step (stencil fills, fringe anti-aliasing,
+// same paint evaluation), which makes it usable for headless rendering, tests and benchmarks.
+// Flags should be combination of the create flags above.
+NVGcontext* nvgCreateSW(int flags);
+// Creates the context allocating all its memory from the specified allocator.
+NVGcontext* nvgCreateSWWithAllocator(int flags, NVGallocator* allocator);
+void nvgDeleteSW(NVGcontext* ctx);
+
+// Sets the pixel buffer where the following frames are rendered to. Pixels are stored
+// as R,G,B,A bytes with premultiplied alpha, 'stride' is the size of one row in bytes.
+// If the pixel buffer is NULL, all rendering is discarded (null back-end).
+// Returns 0 if the stencil buffer could not be allocated.
+int nvgswSetFramebuffer(NVGcontext* ctx, unsigned char* pixels, int w, int h, int stride);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NANOVG_SW_H */
+
+#ifdef NANOVG_SW_IMPLEMENTATION
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "nanovg.h"
+
+enum SWNVGshaderType {
+	SWNVG_SHADER_FILLGRAD,
+	SWNVG_SHADER_FILLIMG,
+	SWNVG_SHADER_SIMPLE,
+	SWNVG_SHADER_IMG
+};
+
+enum SWNVGstencilFunc {
+	SWNVG_STENCIL_ALWAYS,
+	SWNVG_STENCIL_EQUAL,		// Passes when stencil is zero.
+	SWNVG_STENCIL_NOTEQUAL,		// Passes when stencil is non-zero.
+};
+
+enum SWNVGstencilOp {
+	SWNVG_OP_KEEP,
+	SWNVG_OP_WINDING,			// Front faces increment, back faces decrement (wrapping).
+	SWNVG_OP_INCR,				// Saturating increment.
+	SWNVG_OP_ZERO,
+};
+
+struct SWNVGtexture {
+	int id;
+	unsigned char* data;
+	int width, height;
+	int type;
+	int flags;
+};
+typedef struct SWNVGtexture SWNVGtexture;
+
+struct SWNVGblend
+{
+	int srcRGB;
+	int dstRGB;
+	int srcAlpha;
+	int dstAlpha;
+};
+typedef struct SWNVGblend SWNVGblend;
+
+enum SWNVGcallType {
+	SWNVG_NONE = 0,
+	SWNVG_FILL,
+	SWNVG_CONVEXFILL,
+	SWNVG_STROKE,
+	SWNVG_TRIANGLES,
+};
+
+struct SWNVGcall {
+	int type;
+	int image;
+	int pathOffset;
+	int pathCount;
+	int triangleOffset;
+	int triangleCount;
+	int uniformOffset;
+	SWNVGblend blendFunc;
+};
+typedef struct SWNVGcall SWNVGcall;
+
+struct SWNVGpath {
+	int fillOffset;
+	int fillCount;
+	int strokeOffset;
+	int strokeCount;
+	int triangulated;	// Fill is a triangle list instead of a fan.
+};
+typedef struct SWNVGpath SWNVGpath;
+
+// Same data as the OpenGL fragment uniforms, matrices are stored as 2x3 affine transforms.
+struct SWNVGfragUniforms {
+	float scissorMat[6];
+	float paintMat[6];
+	struct NVGcolor innerCol;
+	struct NVGcolor outerCol;
+	float scissorExt[2];
+	float scissorScale[2];
+	float extent[2];
+	float radius;
+	float feather;
+	float strokeMult;
+	float strokeThr;
+	int texType;
+	int type;
+};
+typedef struct SWNVGfragUniforms SWNVGfragUniforms;
+
+// Pipeline state used to rasterize a batch of triangles.
+struct SWNVGraster {
+	const SWNVGfragUniforms* frag;
+	const SWNVGtexture* tex;
+	SWNVGblend blend;
+	int cull;
+	int colorWrite;
+	int stencilFunc;
+	int stencilOp;
+};
+typedef struct SWNVGraster SWNVGraster;
+
+struct SWNVGcontext {
+	SWNVGtexture* textures;
+	float view[2];
+	int ntextures;
+	int ctextures;
+	int textureId;
+	int flags;
+
+	// Render target
+	unsigned char* pixels;
+	int width;
+	int height;
+	int stride;
+	unsigned char* stencil;
+	int cstencil;
+
+	// Per frame buffers, allocated from the frame allocator of the context when it has one.
+	NVGallocator* allocator;
+	NVGframeAllocator frameAllocator;
+	SWNVGcall* calls;
+	int ccalls;
+	int ncalls;
+	SWNVGpath* paths;
+	int cpaths;
+	int npaths;
+	struct NVGvertex* verts;
+	int cverts;
+	int nverts;
+	SWNVGfragUniforms* uniforms;
+	int cuniforms;
+	int nuniforms;
+};
+typedef struct SWNVGcontext SWNVGcontext;
+
+static int swnvg__maxi(int a, int b) { return a > b ? a : b; }
+static float swnvg__minf(float a, float b) { return a < b ? a : b; }
+static float swnvg__maxf(float a, float b) { return a > b ? a : b; }
+static float swnvg__clampf(float a, float mn, float mx) { return a < mn ? mn : (a > mx ? mx : a); }
+
+static SWNVGtexture* swnvg__allocTexture(SWNVGcontext* sw)
+{
+	SWNVGtexture* tex = NULL;
+	int i;
+
+	for (i = 0; i < sw->ntextures; i++) {
+		if (sw->textures[i].id == 0) {
+			tex = &sw->textures[i];
+			break;
+		}
+	}
+	if (tex == NULL) {
+		if (sw->ntextures+1 > sw->ctextures) {
+			SWNVGtexture* textures;
+			int ctextures = swnvg__maxi(sw->ntextures+1, 4) +  sw->ctextures/2; // 1.5x Overallocate
+			textures = (SWNVGtexture*)nvgInternalRealloc(sw->allocator, NVG_MEMORY_BACKEND, sw->textures, sizeof(SWNVGtexture)*ctextures);
+			if (textures == NULL) return NULL;
+			sw->textures = textures;
+			sw->ctextures = ctextures;
+		}
+		tex = &sw->textures[sw->ntextures++];
+	}
+
+	memset(tex, 0, sizeof(*tex));
+	tex->id = ++sw->textureId;
+
+	return tex;
+}
+
+static SWNVGtexture* swnvg__findTexture(SWNVGcontext* sw, int id)
+{
+	int i;
+	for (i = 0; i < sw->ntextures; i++)
+		if (sw->textures[i].id == id)
+			return &sw->textures[i];
+	return NULL;
+}
+
+static int swnvg__deleteTexture(SWNVGcontext* sw, int id)
+{
+	int i;
+	for (i = 0; i < sw->ntextures; i++) {
+		if (sw->textures[i].id == id) {
+			nvgInternalFree(sw->textures[i].data);
+			memset(&sw->textures[i], 0, sizeof(sw->textures[i]));
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int swnvg__renderCreate(void* uptr)
+{
+	NVG_NOTUSED(uptr);
+	return 1;
+}
+
+static int swnvg__renderCreateTexture(void* uptr, int type, int w, int h, int imageFlags, const unsigned char* data)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__allocTexture(sw);
+	int bpp = type == NVG_TEXTURE_RGBA ? 4 : 1;
+
+	if (tex == NULL) return 0;
+
+	tex->data = (unsigned char*)nvgInternalAlloc(sw->allocator, NVG_MEMORY_TEXTURES, w*h*bpp);
+	if (tex->data == NULL) {
+		tex->id = 0;
+		return 0;
+	}
+	if (data != NULL)
+		memcpy(tex->data, data, w*h*bpp);
+	else
+		memset(tex->data, 0, w*h*bpp);
+
+	tex->width = w;
+	tex->height = h;
+	tex->type = type;
+	tex->flags = imageFlags;
+
+	return tex->id;
+}
+
+static int swnvg__renderDeleteTexture(void* uptr, int image)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	return swnvg__deleteTexture(sw, image);
+}
+
+static int swnvg__renderUpdateTexture(void* uptr, int image, int x, int y, int w, int h, const unsigned char* data)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__findTexture(sw, image);
+	int i, bpp;
+
+	if (tex == NULL) return 0;
+
+	// Data is laid out as the whole image, like with GL_UNPACK_ROW_LENGTH.
+	bpp = tex->type == NVG_TEXTURE_RGBA ? 4 : 1;
+	for (i = 0; i < h; i++) {
+		int offset = ((y+i)*tex->width + x) * bpp;
+		memcpy(&tex->data[offset], &data[offset], w*bpp);
+	}
+
+	return 1;
+}
+
+static int swnvg__renderGetTextureSize(void* uptr, int image, int* w, int* h)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGtexture* tex = swnvg__findTexture(sw, image);
+	if (tex == NULL) return 0;
+	*w = tex->width;
+	*h = tex->height;
+	return 1;
+}
+
+static NVGcolor swnvg__premulColor(NVGcolor c)
+{
+	c.r *= c.a;
+	c.g *= c.a;
+	c.b *= c.a;
+	return c;
+}
+
+static int swnvg__convertPaint(SWNVGcontext* sw, SWNVGfragUniforms* frag, NVGpaint* paint,
+							   NVGscissor* scissor, float width, float fringe, float strokeThr)
+{
+	SWNVGtexture* tex = NULL;
+
+	memset(frag, 0, sizeof(*frag));
+
+	frag->innerCol = swnvg__premulColor(paint->innerColor);
+	frag->outerCol = swnvg__premulColor(paint->outerColor);
+
+	if (scissor->extent[0] < -0.5f || scissor->extent[1] < -0.5f) {
+		memset(frag->scissorMat, 0, sizeof(frag->scissorMat));
+		frag->scissorExt[0] = 1.0f;
+		frag->scissorExt[1] = 1.0f;
+		frag->scissorScale[0] = 1.0f;
+		frag->scissorScale[1] = 1.0f;
+	} else {
+		nvgTransformInverse(frag->scissorMat, scissor->xform);
+		frag->scissorExt[0] = scissor->extent[0];
+		frag->scissorExt[1] = scissor->extent[1];
+		frag->scissorScale[0] = sqrtf(scissor->xform[0]*scissor->xform[0] + scissor->xform[2]*scissor->xform[2]) / fringe;
+		frag->scissorScale[1] = sqrtf(scissor->xform[1]*scissor->xform[1] + scissor->xform[3]*scissor->xform[3]) / fringe;
+	}
+
+	memcpy(frag->extent, paint->extent, sizeof(frag->extent));
+	frag->strokeMult = (width*0.5f + fringe*0.5f) / fringe;
+	frag->strokeThr = strokeThr;
+
+	if (paint->image != 0) {
+		tex = swnvg__findTexture(sw, paint->image);
+		if (tex == NULL) return 0;
+		if ((tex->flags & NVG_IMAGE_FLIPY) != 0) {
+			float m1[6], m2[6];
+			nvgTransformTranslate(m1, 0.0f, frag->extent[1] * 0.5f);
+			nvgTransformMultiply(m1, paint->xform);
+			nvgTransformScale(m2, 1.0f, -1.0f);
+			nvgTransformMultiply(m2, m1);
+			nvgTransformTranslate(m1, 0.0f, -frag->extent[1] * 0.5f);
+			nvgTransformMultiply(m1, m2);
+			nvgTransformInverse(frag->paintMat, m1);
+		} else {
+			nvgTransformInverse(frag->paintMat, paint->xform);
+		}
+		frag->type = SWNVG_SHADER_FILLIMG;
+		if (tex->type == NVG_TEXTURE_RGBA)
+			frag->texType = (tex->flags & NVG_IMAGE_PREMULTIPLIED) ? 0 : 1;
+		else
+			frag->texType = (tex->flags & NVG_IMAGE_SDF) ? 3 : 2;
+		if (tex->flags & NVG_IMAGE_SDF)
+			frag->feather = paint->feather;
+	} else {
+		frag->type = SWNVG_SHADER_FILLGRAD;
+		frag->radius = paint->radius;
+		frag->feather = paint->feather;
+		nvgTransformInverse(frag->paintMat, paint->xform);
+	}
+
+	return 1;
+}
+
+static void swnvg__renderViewport(void* uptr, float width, float height, float devicePixelRatio)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	NVG_NOTUSED(devicePixelRatio);
+	sw->view[0] = width;
+	sw->view[1] = height;
+}
+
+//
+// Shading
+//
+
+static float swnvg__sdroundrect(float px, float py, float ex, float ey, float rad)
+{
+	float dx = fabsf(px) - (ex - rad);
+	float dy = fabsf(py) - (ey - rad);
+	float mx = swnvg__maxf(dx, 0.0f), my = swnvg__maxf(dy, 0.0f);
+	return swnvg__minf(swnvg__maxf(dx, dy), 0.0f) + sqrtf(mx*mx + my*my) - rad;
+}
+
+static float swnvg__scissorMask(const SWNVGfragUniforms* frag, float px, float py)
+{
+	const float* m = frag->scissorMat;
+	float scx = fabsf(m[0]*px + m[2]*py + m[4]) - frag->scissorExt[0];
+	float scy = fabsf(m[1]*px + m[3]*py + m[5]) - frag->scissorExt[1];
+	scx = 0.5f - scx * frag->scissorScale[0];
+	scy = 0.5f - scy * frag->scissorScale[1];
+	return swnvg__clampf(scx, 0.0f, 1.0f) * swnvg__clampf(scy, 0.0f, 1.0f);
+}
+
+// Stroke - from [0..1] to clipped pyramid, where the slope is 1px.
+static float swnvg__strokeMask(const SWNVGfragUniforms* frag, float u, float v)
+{
+	return swnvg__minf(1.0f, (1.0f - fabsf(u*2.0f - 1.0f)) * frag->strokeMult) * swnvg__minf(1.0f, v);
+}
+
+static void swnvg__fetchTexel(const SWNVGtexture* tex, int x, int y, float* c)
+{
+	if (tex->flags & NVG_IMAGE_REPEATX) {
+		x %= tex->width;
+		if (x < 0) x += tex->width;
+	} else {
+		x = x < 0 ? 0 : (x >= tex->width ? tex->width-1 : x);
+	}
+	if (tex->flags & NVG_IMAGE_REPEATY) {
+		y %= tex->height;
+		if (y < 0) y += tex->height;
+	} else {
+		y = y < 0 ? 0 : (y >= tex->height ? tex->height-1 : y);
+	}
+	if (tex->type == NVG_TEXTURE_RGBA) {
+		const unsigned char* p = &tex->data[(y*tex->width + x)*4];
+		c[0] = p[0] / 255.0f;
+		c[1] = p[1] / 255.0f;
+		c[2] = p[2] / 255.0f;
+		c[3] = p[3] / 255.0f;
+	} else {
+		c[0] = c[1] = c[2] = tex->data[y*tex->width + x] / 255.0f;
+		c[3] = 1.0f;
+	}
+}
+
+// Samples texture at normalized coordinates, no mip-mapping.
+static void swnvg__sampleTexture(const SWNVGtexture* tex, float s, float t, float* c)
+{
+	float x, y, fx, fy, c00[4], c10[4], c01[4], c11[4];
+	int i, ix, iy;
+
+	if (tex == NULL) {
+		c[0] = c[1] = c[2] = c[3] = 0.0f;
+		return;
+	}
+
+	x = s * tex->width - 0.5f;
+	y = t * tex->height - 0.5f;
+	if (tex->flags & NVG_IMAGE_NEAREST) {
+		swnvg__fetchTexel(tex, (int)floorf(x + 0.5f), (int)floorf(y + 0.5f), c);
+		return;
+	}
+
+	ix = (int)floorf(x);
+	iy = (int)floorf(y);
+	fx = x - ix;
+	fy = y - iy;
+	swnvg__fetchTexel(tex, ix, iy, c00);
+	swnvg__fetchTexel(tex, ix+1, iy, c10);
+	swnvg__fetchTexel(tex, ix, iy+1, c01);
+	swnvg__fetchTexel(tex, ix+1, iy+1, c11);
+	for (i = 0; i < 4; i++) {
+		float a = c00[i] + (c10[i] - c00[i]) * fx;
+		float b = c01[i] + (c11[i] - c01[i]) * fx;
+		c[i] = a + (b - a) * fy;
+	}
+}
+
+// Signed distance field with the edge at 0.5, feather widens the edge. The screen space
+// derivative is taken from the samples one pixel right and down, like fwidth() on the GPU.
+static float swnvg__sdfAlpha(const SWNVGfragUniforms* frag, const SWNVGtexture* tex, float s, float t, const float* duv)
+{
+	float d[4], dx[4], dy[4], w;
+	swnvg__sampleTexture(tex, s, t, d);
+	swnvg__sampleTexture(tex, s + duv[0], t + duv[1], dx);
+	swnvg__sampleTexture(tex, s + duv[2], t + duv[3], dy);
+	w = swnvg__maxf(fabsf(dx[0] - d[0]) + fabsf(dy[0] - d[0]), 0.0001f) * (1.0f + frag->feather);
+	return swnvg__clampf((d[0] - 0.5f) / w + 0.5f, 0.0f, 1.0f);
+}
+
+static void swnvg__texColor(const SWNVGfragUniforms* frag, const SWNVGtexture* tex, float s, float t, const float* duv, float* c)
+{
+	if (frag->texType == 3) {
+		c[0] = c[1] = c[2] = c[3] = swnvg__sdfAlpha(frag, tex, s, t, duv);
+		return;
+	}
+	swnvg__sampleTexture(tex, s, t, c);
+	if (frag->texType == 1) {
+		c[0] *= c[3];
+		c[1] *= c[3];
+		c[2] *= c[3];
+	} else if (frag->texType == 2) {
+		c[1] = c[2] = c[3] = c[0];
+	}
+}
+
+// Evaluates the fill shader, same logic as the OpenGL fragment shader. Result is premultiplied.
+static void swnvg__shade(const SWNVGraster* r, float px, float py, float u, float v, const float* duv, float strokeAlpha, float* c)
+{
+	const SWNVGfragUniforms* frag = r->frag;
+	const float* m = frag->paintMat;
+	float scissor, ptx, pty, d, a;
+	int i;
+
+	if (frag->type == SWNVG_SHADER_SIMPLE) {
+		c[0] = c[1] = c[2] = c[3] = 1.0f;
+		return;
+	}
+
+	scissor = swnvg__scissorMask(frag, px, py);
+
+	if (frag->type == SWNVG_SHADER_FILLGRAD) {
+		// Calculate gradient color using box gradient
+		ptx = m[0]*px + m[2]*py + m[4];
+		pty = m[1]*px + m[3]*py + m[5];
+		d = swnvg__clampf((swnvg__sdroundrect(ptx, pty, frag->extent[0], frag->extent[1], frag->radius) + frag->feather*0.5f) / frag->feather, 0.0f, 1.0f);
+		a = strokeAlpha * scissor;
+		c[0] = (frag->innerCol.r + (frag->outerCol.r - frag->innerCol.r) * d) * a;
+		c[1] = (frag->innerCol.g + (frag->outerCol.g - frag->innerCol.g) * d) * a;
+		c[2] = (frag->innerCol.b + (frag->outerCol.b - frag->innerCol.b) * d) * a;
+		c[3] = (frag->innerCol.a + (frag->outerCol.a - frag->innerCol.a) * d) * a;
+	} else if (frag->type == SWNVG_SHADER_FILLIMG) {
+		// Calculate color fron texture
+		ptx = (m[0]*px + m[2]*py + m[4]) / frag->extent[0];
+		pty = (m[1]*px + m[3]*py + m[5]) / frag->extent[1];
+		swnvg__texColor(frag, r->tex, ptx, pty, duv, c);
+		// Apply color tint and alpha.
+		a = strokeAlpha * scissor;
+		for (i = 0; i < 4; i++)
+			c[i] *= frag->innerCol.rgba[i] * a;
+	} else {
+		// Textured tris
+		swnvg__texColor(frag, r->tex, u, v, duv, c);
+		for (i = 0; i < 4; i++)
+			c[i] *= scissor * frag->innerCol.rgba[i];
+	}
+}
+
+static float swnvg__blendFactor(int factor, int i, const float* src, const float* dst)
+{
+	switch (factor) {
+	case NVG_ZERO:					return 0.0f;
+	case NVG_ONE:					return 1.0f;
+	case NVG_SRC_COLOR:				return src[i];
+	case NVG_ONE_MINUS_SRC_COLOR:	return 1.0f - src[i];
+	case NVG_DST_COLOR:				return dst[i];
+	case NVG_ONE_MINUS_DST_COLOR:	return 1.0f - dst[i];
+	case NVG_SRC_ALPHA:				return src[3];
+	case NVG_ONE_MINUS_SRC_ALPHA:	return 1.0f - src[3];
+	case NVG_DST_ALPHA:				return dst[3];
+	case NVG_ONE_MINUS_DST_ALPHA:	return 1.0f - dst[3];
+	case NVG_SRC_ALPHA_SATURATE:	return i == 3 ? 1.0f : swnvg__minf(src[3], 1.0f - dst[3]);
+	}
+	return 0.0f;
+}
+
+static void swnvg__blend(const SWNVGblend* blend, const float* src, unsigned char* pixel)
+{
+	float dst[4], c;
+	int i;
+
+	// Fast path for the default source-over operation.
+	if (blend->srcRGB == NVG_ONE && blend->dstRGB == NVG_ONE_MINUS_SRC_ALPHA &&
+		blend->srcAlpha == NVG_ONE && blend->dstAlpha == NVG_ONE_MINUS_SRC_ALPHA) {
+		float ia = 1.0f - src[3];
+		for (i = 0; i < 4; i++) {
+			c = swnvg__clampf(src[i] + pixel[i] / 255.0f * ia, 0.0f, 1.0f);
+			pixel[i] = (unsigned char)(c * 255.0f + 0.5f);
+		}
+		return;
+	}
+
+	for (i = 0; i < 4; i++)
+		dst[i] = pixel[i] / 255.0f;
+	for (i = 0; i < 4; i++) {
+		int sf = i < 3 ? blend->srcRGB : blend->srcAlpha;
+		int df = i < 3 ? blend->dstRGB : blend->dstAlpha;
+		c = src[i] * swnvg__blendFactor(sf, i, src, dst) + dst[i] * swnvg__blendFactor(df, i, src, dst);
+		c = swnvg__clampf(c, 0.0f, 1.0f);
+		pixel[i] = (unsigned char)(c * 255.0f + 0.5f);
+	}
+}
+
+//
+// Rasterization
+//
+
+// Returns true if the edge owns pixels exactly on it. Edges shared by two triangles
+// run in opposite directions, so exactly one of the triangles draws the pixel.
+static int swnvg__ownsEdge(float dx, float dy)
+{
+	return dy > 0.0f || (dy == 0.0f && dx < 0.0f);
+}
+
+static void swnvg__rasterizeTriangle(SWNVGcontext* sw, const SWNVGraster* r, const NVGvertex* va, const NVGvertex* vb, const NVGvertex* vc)
+{
+	const SWNVGfragUniforms* frag = r->frag;
+	const NVGvertex* vt;
+	float sx = sw->view[0] > 0.0f ? sw->width / sw->view[0] : 1.0f;
+	float sy = sw->view[1] > 0.0f ? sw->height / sw->view[1] : 1.0f;
+	float ax, ay, bx, by, cx, cy, t, area, invArea, duv[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+	int front, own0, own1, own2, x, y, minx, miny, maxx, maxy;
+	int aa = (sw->flags & NVG_ANTIALIAS) != 0;
+
+	// Triangles are counter-clockwise in window coordinates (y-up) when front facing.
+	ax = va->x * sx; ay = va->y * sy;
+	bx = vb->x * sx; by = vb->y * sy;
+	cx = vc->x * sx; cy = vc->y * sy;
+	area = (bx - ax) * (cy - ay) - (cx - ax) * (by - ay);
+	// Skip degenerate triangles, and triangles whose area overflows or is NaN as they cannot be interpolated.
+	if (area == 0.0f || !(fabsf(area) <= FLT_MAX)) return;
+	front = area < 0.0f;
+	if (r->cull && !front) return;
+	if (area < 0.0f) {
+		vt = vb; vb = vc; vc = vt;
+		t = bx; bx = cx; cx = t;
+		t = by; by = cy; cy = t;
+		area = -area;
+	}
+	invArea = 1.0f / area;
+
+	// Texture coordinate steps per pixel, used to anti-alias distance fields.
+	if (frag->texType == 3 && frag->type == SWNVG_SHADER_FILLIMG) {
+		const float* m = frag->paintMat;
+		duv[0] = m[0] / (sx * frag->extent[0]);
+		duv[1] = m[1] / (sx * frag->extent[1]);
+		duv[2] = m[2] / (sy * frag->extent[0]);
+		duv[3] = m[3] / (sy * frag->extent[1]);
+	} else if (frag->texType == 3) {
+		duv[0] = -(va->u * (cy - by) + vb->u * (ay - cy) + vc->u * (by - ay)) * invArea;
+		duv[1] = -(va->v * (cy - by) + vb->v * (ay - cy) + vc->v * (by - ay)) * invArea;
+		duv[2] = (va->u * (cx - bx) + vb->u * (ax - cx) + vc->u * (bx - ax)) * invArea;
+		duv[3] = (va->v * (cx - bx) + vb->v * (ax - cx) + vc->v * (bx - ax)) * invArea;
+	}
+
+	// Clamp the bounds before converting, huge coordinates do not fit in an int.
+	minx = (int)floorf(swnvg__clampf(swnvg__minf(ax, swnvg__minf(bx, cx)), 0.0f, (float)sw->width));
+	miny = (int)floorf(swnvg__clampf(swnvg__minf(ay, swnvg__minf(by, cy)), 0.0f, (float)sw->height));
+	maxx = (int)ceilf(swnvg__clampf(swnvg__maxf(ax, swnvg__maxf(bx, cx)), -1.0f, (float)(sw->width-1)));
+	maxy = (int)ceilf(swnvg__clampf(swnvg__maxf(ay, swnvg__maxf(by, cy)), -1.0f, (float)(sw->height-1)));
+
+	own0 = swnvg__ownsEdge(cx - bx, cy - by);
+	own1 = swnvg__ownsEdge(ax - cx, ay - cy);
+	own2 = swnvg__ownsEdge(bx - ax, by - ay);
+
+	for (y = miny; y <= maxy; y++) {
+		float py = y + 0.5f;
+		unsigned char* row = &sw->pixels[y * sw->stride];
+		unsigned char* srow = &sw->stencil[y * sw->width];
+		for (x = minx; x <= maxx; x++) {
+			float px = x + 0.5f;
+			float w0 = (cx - bx) * (py - by) - (cy - by) * (px - bx);
+			float w1 = (ax - cx) * (py - cy) - (ay - cy) * (px - cx);
+			float w2 = (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+			float u, v, strokeAlpha = 1.0f, c[4];
+			unsigned char* s = &srow[x];
+
+			if (w0 < 0.0f || (w0 == 0.0f && !own0)) continue;
+			if (w1 < 0.0f || (w1 == 0.0f && !own1)) continue;
+			if (w2 < 0.0f || (w2 == 0.0f && !own2)) continue;
+
+			if (r->stencilFunc == SWNVG_STENCIL_EQUAL && *s != 0) continue;
+			if (r->stencilFunc == SWNVG_STENCIL_NOTEQUAL && *s == 0) continue;
+
+			w0 *= invArea;
+			w1 *= invArea;
+			w2 *= invArea;
+			u = va->u * w0 + vb->u * w1 + vc->u * w2;
+			v = va->v * w0 + vb->v * w1 + vc->v * w2;
+
+			if (aa && frag->type != SWNVG_SHADER_SIMPLE && frag->type != SWNVG_SHADER_IMG) {
+				strokeAlpha = swnvg__strokeMask(frag, u, v);
+				if (strokeAlpha < frag->strokeThr) continue;
+			}
+
+			switch (r->stencilOp) {
+			case SWNVG_OP_WINDING:	*s = (unsigned char)(front ? *s + 1 : *s - 1); break;
+			case SWNVG_OP_INCR:		if (*s < 255) (*s)++; break;
+			case SWNVG_OP_ZERO:		*s = 0; break;
+			}
+
+			if (!r->colorWrite) continue;
+
+			// Shader is evaluated in NanoVG coordinates.
+			swnvg__shade(r, px / sx, py / sy, u, v, duv, strokeAlpha, c);
+			swnvg__blend(&r->blend, c, &row[x*4]);
+		}
+	}
+}
+
+static void swnvg__drawTriangles(SWNVGcontext* sw, const SWNVGraster* r, int offset, int count)
+{
+	const NVGvertex* verts = &sw->verts[offset];
+	int i;
+	for (i = 0; i+2 < count; i += 3)
+		swnvg__rasterizeTriangle(sw, r, &verts[i], &verts[i+1], &verts[i+2]);
+}
+
+static void swnvg__drawFan(SWNVGcontext* sw, const SWNVGraster* r, int offset, int count)
+{
+	const NVGvertex* verts = &sw->verts[offset];
+	int i;
+	for (i = 2; i < count; i++)
+		swnvg__rasterizeTriangle(sw, r, &verts[0], &verts[i-1], &verts[i]);
+}
+
+static void swnvg__drawStrip(SWNVGcontext* sw, const SWNVGraster* r, int offset, int count)
+{
+	const NVGvertex* verts = &sw->verts[offset];
+	int i;
+	for (i = 2; i < count; i++) {
+		// Keep the winding of every other triangle like GL does.
+		if (i & 1)
+			swnvg__rasterizeTriangle(sw, r, &verts[i-1], &verts[i-2], &verts[i]);
+		else
+			swnvg__rasterizeTriangle(sw, r, &verts[i-2], &verts[i-1], &verts[i]);
+	}
+}
+
+static void swnvg__setUniforms(SWNVGcontext* sw, SWNVGraster* r, SWNVGcall* call, int uniformOffset, int image)
+{
+	r->frag = &sw->uniforms[uniformOffset];
+	r->tex = image != 0 ? swnvg__findTexture(sw, image) : NULL;
+	r->blend = call->blendFunc;
+}
+
+static void swnvg__fill(SWNVGcontext* sw, SWNVGcall* call)
+{
+	SWNVGpath* paths = &sw->paths[call->pathOffset];
+	int i, npaths = call->pathCount;
+	SWNVGraster r;
+
+	// Draw shapes into stencil, the winding number is accumulated per pixel.
+	swnvg__setUniforms(sw, &r, call, call->uniformOffset, 0);
+	r.cull = 0;
+	r.colorWrite = 0;
+	r.stencilFunc = SWNVG_STENCIL_ALWAYS;
+	r.stencilOp = SWNVG_OP_WINDING;
+	for (i = 0; i < npaths; i++) {
+		if (paths[i].triangulated)
+			swnvg__drawTriangles(sw, &r, paths[i].fillOffset, paths[i].fillCount);
+		else
+			swnvg__drawFan(sw, &r, paths[i].fillOffset, paths[i].fillCount);
+	}
+
+	// Draw anti-aliased pixels
+	swnvg__setUniforms(sw, &r, call, call->uniformOffset + 1, call->image);
+	r.cull = 1;
+	r.colorWrite = 1;
+
+	if (sw->flags & NVG_ANTIALIAS) {
+		r.stencilFunc = SWNVG_STENCIL_EQUAL;
+		r.stencilOp = SWNVG_OP_KEEP;
+		// Draw fringes
+		for (i = 0; i < npaths; i++)
+			swnvg__drawStrip(sw, &r, paths[i].strokeOffset, paths[i].strokeCount);
+	}
+
+	// Draw fill, pixels with non-zero winding are covered.
+	r.stencilFunc = SWNVG_STENCIL_NOTEQUAL;
+	r.stencilOp = SWNVG_OP_ZERO;
+	swnvg__drawStrip(sw, &r, call->triangleOffset, call->triangleCount);
+}
+
+static void swnvg__convexFill(SWNVGcontext* sw, SWNVGcall* call)
+{
+	SWNVGpath* paths = &sw->paths[call->pathOffset];
+	int i, npaths = call->pathCount;
+	SWNVGraster r;
+
+	swnvg__setUniforms(sw, &r, call, call->uniformOffset, call->image);
+	r.cull = 1;
+	r.colorWrite = 1;
+	r.stencilFunc = SWNVG_STENCIL_ALWAYS;
+	r.stencilOp = SWNVG_OP_KEEP;
+
+	for (i = 0; i < npaths; i++) {
+		if (paths[i].triangulated)
+			swnvg__drawTriangles(sw, &r, paths[i].fillOffset, paths[i].fillCount);
+		else
+			swnvg__drawFan(sw, &r, paths[i].fillOffset, paths[i].fillCount);
+		// Draw fringes
+		if (paths[i].strokeCount > 0) {
+			swnvg__drawStrip(sw, &r, paths[i].strokeOffset, paths[i].strokeCount);
+		}
+	}
+}
+
+static void swnvg__stroke(SWNVGcontext* sw, SWNVGcall* call)
+{
+	SWNVGpath* paths = &sw->paths[call->pathOffset];
+	int npaths = call->pathCount, i;
+	SWNVGraster r;
+
+	r.cull = 1;
+	r.colorWrite = 1;
+
+	if (sw->flags & NVG_STENCIL_STROKES) {
+
+		// Fill the stroke base without overlap
+		swnvg__setUniforms(sw, &r, call, call->uniformOffset + 1, call->image);
+		r.stencilFunc = SWNVG_STENCIL_EQUAL;
+		r.stencilOp = SWNVG_OP_INCR;
+		for (i = 0; i < npaths; i++)
+			swnvg__drawStrip(sw, &r, paths[i].strokeOffset, paths[i].strokeCount);
+
+		// Draw anti-aliased pixels.
+		swnvg__setUniforms(sw, &r, call, call->uniformOffset, call->image);
+		r.stencilFunc = SWNVG_STENCIL_EQUAL;
+		r.stencilOp = SWNVG_OP_KEEP;
+		for (i = 0; i < npaths; i++)
+			swnvg__drawStrip(sw, &r, paths[i].strokeOffset, paths[i].strokeCount);
+
+		// Clear stencil buffer.
+		r.colorWrite = 0;
+		r.stencilFunc = SWNVG_STENCIL_ALWAYS;
+		r.stencilOp = SWNVG_OP_ZERO;
+		for (i = 0; i < npaths; i++)
+			swnvg__drawStrip(sw, &r, paths[i].strokeOffset, paths[i].strokeCount);
+
+	} else {
+		swnvg__setUniforms(sw, &r, call, call->uniformOffset, call->image);
+		r.stencilFunc = SWNVG_STENCIL_ALWAYS;
+		r.stencilOp = SWNVG_OP_KEEP;
+		// Draw Strokes
+		for (i = 0; i < npaths; i++)
+			swnvg__drawStrip(sw, &r, paths[i].strokeOffset, paths[i].strokeCount);
+	}
+}
+
+static void swnvg__triangles(SWNVGcontext* sw, SWNVGcall* call)
+{
+	SWNVGraster r;
+
+	swnvg__setUniforms(sw, &r, call, call->uniformOffset, call->image);
+	r.cull = 1;
+	r.colorWrite = 1;
+	r.stencilFunc = SWNVG_STENCIL_ALWAYS;
+	r.stencilOp = SWNVG_OP_KEEP;
+
+	swnvg__drawTriangles(sw, &r, call->triangleOffset, call->triangleCount);
+}
+
+static void swnvg__resetFrameBuffers(SWNVGcontext* sw)
+{
+	sw->nverts = 0;
+	sw->npaths = 0;
+	sw->ncalls = 0;
+	sw->nuniforms = 0;
+
+	// The memory is released when the frame allocator is reset, keep the capacities
+	// so that the next frame allocates the buffers at once.
+	if (sw->frameAllocator.alloc != NULL) {
+		sw->calls = NULL;
+		sw->paths = NULL;
+		sw->verts = NULL;
+		sw->uniforms = NULL;
+	}
+}
+
+static void swnvg__renderCancel(void* uptr) {
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	swnvg__resetFrameBuffers(sw);
+}
+
+static int swnvg__validBlendFactor(int factor)
+{
+	return factor == NVG_ZERO || factor == NVG_ONE ||
+		factor == NVG_SRC_COLOR || factor == NVG_ONE_MINUS_SRC_COLOR ||
+		factor == NVG_DST_COLOR || factor == NVG_ONE_MINUS_DST_COLOR ||
+		factor == NVG_SRC_ALPHA || factor == NVG_ONE_MINUS_SRC_ALPHA ||
+		factor == NVG_DST_ALPHA || factor == NVG_ONE_MINUS_DST_ALPHA ||
+		factor == NVG_SRC_ALPHA_SATURATE;
+}
+
+static SWNVGblend swnvg__blendCompositeOperation(NVGcompositeOperationState op)
+{
+	SWNVGblend blend;
+	blend.srcRGB = op.srcRGB;
+	blend.dstRGB = op.dstRGB;
+	blend.srcAlpha = op.srcAlpha;
+	blend.dstAlpha = op.dstAlpha;
+	if (!swnvg__validBlendFactor(blend.srcRGB) || !swnvg__validBlendFactor(blend.dstRGB) ||
+		!swnvg__validBlendFactor(blend.srcAlpha) || !swnvg__validBlendFactor(blend.dstAlpha))
+	{
+		blend.srcRGB = NVG_ONE;
+		blend.dstRGB = NVG_ONE_MINUS_SRC_ALPHA;
+		blend.srcAlpha = NVG_ONE;
+		blend.dstAlpha = NVG_ONE_MINUS_SRC_ALPHA;
+	}
+	return blend;
+}
+
+static void swnvg__renderFlush(void* uptr)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	int i;
+
+	if (sw->ncalls > 0 && sw->pixels != NULL) {
+
+		memset(sw->stencil, 0, sw->width * sw->height);
+
+		for (i = 0; i < sw->ncalls; i++) {
+			SWNVGcall* call = &sw->calls[i];
+			if (call->type == SWNVG_FILL)
+				swnvg__fill(sw, call);
+			else if (call->type == SWNVG_CONVEXFILL)
+				swnvg__convexFill(sw, call);
+			else if (call->type == SWNVG_STROKE)
+				swnvg__stroke(sw, call);
+			else if (call->type == SWNVG_TRIANGLES)
+				swnvg__triangles(sw, call);
+		}
+	}
+
+	// Reset calls
+	swnvg__resetFrameBuffers(sw);
+}
+
+static int swnvg__maxVertCount(const NVGpath* paths, int npaths)
+{
+	int i, count = 0;
+	for (i = 0; i < npaths; i++) {
+		count += paths[i].nfill;
+		count += paths[i].nstroke;
+	}
+	return count;
+}
+
+// Makes room for n more items to a per frame buffer and returns the new buffer, or NULL on failure.
+static void* swnvg__allocBuffer(SWNVGcontext* sw, void* items, int* citems, int nitems, int n, int minItems, int itemSize)
+{
+	void* ret;
+	int c;
+
+	if (items != NULL && nitems+n <= *citems)
+		return items;
+
+	if (items == NULL)
+		c = swnvg__maxi(swnvg__maxi(nitems+n, minItems), *citems); // Start from the size of the previous frame.
+	else
+		c = swnvg__maxi(nitems+n, minItems) + *citems/2; // 1.5x Overallocate
+
+	if (sw->frameAllocator.alloc != NULL) {
+		ret = sw->frameAllocator.alloc(sw->frameAllocator.userPtr, itemSize * c);
+		if (ret != NULL && nitems > 0)
+			memcpy(ret, items, itemSize * nitems);
+	} else {
+		ret = nvgInternalRealloc(sw->allocator, NVG_MEMORY_BACKEND, items, itemSize * c);
+	}
+	if (ret == NULL) return NULL;
+
+	*citems = c;
+	return ret;
+}
+
+static SWNVGcall* swnvg__allocCall(SWNVGcontext* sw)
+{
+	SWNVGcall* ret = NULL;
+	SWNVGcall* calls = (SWNVGcall*)swnvg__allocBuffer(sw, sw->calls, &sw->ccalls, sw->ncalls, 1, 128, sizeof(SWNVGcall));
+	if (calls == NULL) return NULL;
+	sw->calls = calls;
+	ret = &sw->calls[sw->ncalls++];
+	memset(ret, 0, sizeof(SWNVGcall));
+	return ret;
+}
+
+static int swnvg__allocPaths(SWNVGcontext* sw, int n)
+{
+	int ret = 0;
+	SWNVGpath* paths = (SWNVGpath*)swnvg__allocBuffer(sw, sw->paths, &sw->cpaths, sw->npaths, n, 128, sizeof(SWNVGpath));
+	if (paths == NULL) return -1;
+	sw->paths = paths;
+	ret = sw->npaths;
+	sw->npaths += n;
+	return ret;
+}
+
+static int swnvg__allocVerts(SWNVGcontext* sw, int n)
+{
+	int ret = 0;
+	NVGvertex* verts = (NVGvertex*)swnvg__allocBuffer(sw, sw->verts, &sw->cverts, sw->nverts, n, 4096, sizeof(NVGvertex));
+	if (verts == NULL) return -1;
+	sw->verts = verts;
+	ret = sw->nverts;
+	sw->nverts += n;
+	return ret;
+}
+
+static int swnvg__allocFragUniforms(SWNVGcontext* sw, int n)
+{
+	int ret = 0;
+	SWNVGfragUniforms* uniforms = (SWNVGfragUniforms*)swnvg__allocBuffer(sw, sw->uniforms, &sw->cuniforms, sw->nuniforms, n, 128, sizeof(SWNVGfragUniforms));
+	if (uniforms == NULL) return -1;
+	sw->uniforms = uniforms;
+	ret = sw->nuniforms;
+	sw->nuniforms += n;
+	return ret;
+}
+
+static void swnvg__vset(NVGvertex* vtx, float x, float y, float u, float v)
+{
+	vtx->x = x;
+	vtx->y = y;
+	vtx->u = u;
+	vtx->v = v;
+}
+
+static void swnvg__renderFill(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+							  const float* bounds, const NVGpath* paths, int npaths)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGcall* call = swnvg__allocCall(sw);
+	NVGvertex* quad;
+	SWNVGfragUniforms* frag;
+	int i, maxverts, offset;
+
+	if (call == NULL) return;
+
+	call->type = SWNVG_FILL;
+	call->triangleCount = 4;
+	call->pathOffset = swnvg__allocPaths(sw, npaths);
+	if (call->pathOffset == -1) goto error;
+	call->pathCount = npaths;
+	call->image = paint->image;
+	call->blendFunc = swnvg__blendCompositeOperation(compositeOperation);
+
+	// Triangulated fills with a fringe are stenciled, so that the fringe is not drawn over the fill.
+	if (npaths == 1 && (paths[0].convex || (paths[0].triangulated && paths[0].nstroke == 0)))
+	{
+		call->type = SWNVG_CONVEXFILL;
+		call->triangleCount = 0;	// Bounding box fill quad not needed for convex fill
+	}
+
+	// Allocate vertices for all the paths.
+	maxverts = swnvg__maxVertCount(paths, npaths) + call->triangleCount;
+	offset = swnvg__allocVerts(sw, maxverts);
+	if (offset == -1) goto error;
+
+	for (i = 0; i < npaths; i++) {
+		SWNVGpath* copy = &sw->paths[call->pathOffset + i];
+		const NVGpath* path = &paths[i];
+		memset(copy, 0, sizeof(SWNVGpath));
+		if (path->nfill > 0) {
+			copy->fillOffset = offset;
+			copy->fillCount = path->nfill;
+			copy->triangulated = path->triangulated;
+			memcpy(&sw->verts[offset], path->fill, sizeof(NVGvertex) * path->nfill);
+			offset += path->nfill;
+		}
+		if (path->nstroke > 0) {
+			copy->strokeOffset = offset;
+			copy->strokeCount = path->nstroke;
+			memcpy(&sw->verts[offset], path->stroke, sizeof(NVGvertex) * path->nstroke);
+			offset += path->nstroke;
+		}
+	}
+
+	// Setup uniforms for draw calls
+	if (call->type == SWNVG_FILL) {
+		// Quad
+		call->triangleOffset = offset;
+		quad = &sw->verts[call->triangleOffset];
+		swnvg__vset(&quad[0], bounds[2], bounds[3], 0.5f, 1.0f);
+		swnvg__vset(&quad[1], bounds[2], bounds[1], 0.5f, 1.0f);
+		swnvg__vset(&quad[2], bounds[0], bounds[3], 0.5f, 1.0f);
+		swnvg__vset(&quad[3], bounds[0], bounds[1], 0.5f, 1.0f);
+
+		call->uniformOffset = swnvg__allocFragUniforms(sw, 2);
+		if (call->uniformOffset == -1) goto error;
+		// Simple shader for stencil
+		frag = &sw->uniforms[call->uniformOffset];
+		memset(frag, 0, sizeof(*frag));
+		frag->strokeThr = -1.0f;
+		frag->type = SWNVG_SHADER_SIMPLE;
+		// Fill shader
+		swnvg__convertPaint(sw, &sw->uniforms[call->uniformOffset + 1], paint, scissor, fringe, fringe, -1.0f);
+	} else {
+		call->uniformOffset = swnvg__allocFragUniforms(sw, 1);
+		if (call->uniformOffset == -1) goto error;
+		// Fill shader
+		swnvg__convertPaint(sw, &sw->uniforms[call->uniformOffset], paint, scissor, fringe, fringe, -1.0f);
+	}
+
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (sw->ncalls > 0) sw->ncalls--;
+}
+
+static void swnvg__renderStroke(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor, float fringe,
+								float strokeWidth, const NVGpath* paths, int npaths)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGcall* call = swnvg__allocCall(sw);
+	int i, maxverts, offset;
+
+	if (call == NULL) return;
+
+	call->type = SWNVG_STROKE;
+	call->pathOffset = swnvg__allocPaths(sw, npaths);
+	if (call->pathOffset == -1) goto error;
+	call->pathCount = npaths;
+	call->image = paint->image;
+	call->blendFunc = swnvg__blendCompositeOperation(compositeOperation);
+
+	// Allocate vertices for all the paths.
+	maxverts = swnvg__maxVertCount(paths, npaths);
+	offset = swnvg__allocVerts(sw, maxverts);
+	if (offset == -1) goto error;
+
+	for (i = 0; i < npaths; i++) {
+		SWNVGpath* copy = &sw->paths[call->pathOffset + i];
+		const NVGpath* path = &paths[i];
+		memset(copy, 0, sizeof(SWNVGpath));
+		if (path->nstroke) {
+			copy->strokeOffset = offset;
+			copy->strokeCount = path->nstroke;
+			memcpy(&sw->verts[offset], path->stroke, sizeof(NVGvertex) * path->nstroke);
+			offset += path->nstroke;
+		}
+	}
+
+	if (sw->flags & NVG_STENCIL_STROKES) {
+		// Fill shader
+		call->uniformOffset = swnvg__allocFragUniforms(sw, 2);
+		if (call->uniformOffset == -1) goto error;
+
+		swnvg__convertPaint(sw, &sw->uniforms[call->uniformOffset], paint, scissor, strokeWidth, fringe, -1.0f);
+		swnvg__convertPaint(sw, &sw->uniforms[call->uniformOffset + 1], paint, scissor, strokeWidth, fringe, 1.0f - 0.5f/255.0f);
+
+	} else {
+		// Fill shader
+		call->uniformOffset = swnvg__allocFragUniforms(sw, 1);
+		if (call->uniformOffset == -1) goto error;
+		swnvg__convertPaint(sw, &sw->uniforms[call->uniformOffset], paint, scissor, strokeWidth, fringe, -1.0f);
+	}
+
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (sw->ncalls > 0) sw->ncalls--;
+}
+
+static void swnvg__renderTriangles(void* uptr, NVGpaint* paint, NVGcompositeOperationState compositeOperation, NVGscissor* scissor,
+								   const NVGvertex* verts, int nverts, float fringe)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	SWNVGcall* call = swnvg__allocCall(sw);
+	SWNVGfragUniforms* frag;
+
+	if (call == NULL) return;
+
+	call->type = SWNVG_TRIANGLES;
+	call->image = paint->image;
+	call->blendFunc = swnvg__blendCompositeOperation(compositeOperation);
+
+	// Allocate vertices for all the paths.
+	call->triangleOffset = swnvg__allocVerts(sw, nverts);
+	if (call->triangleOffset == -1) goto error;
+	call->triangleCount = nverts;
+
+	memcpy(&sw->verts[call->triangleOffset], verts, sizeof(NVGvertex) * nverts);
+
+	// Fill shader
+	call->uniformOffset = swnvg__allocFragUniforms(sw, 1);
+	if (call->uniformOffset == -1) goto error;
+	frag = &sw->uniforms[call->uniformOffset];
+	swnvg__convertPaint(sw, frag, paint, scissor, 1.0f, fringe, -1.0f);
+	frag->type = SWNVG_SHADER_IMG;
+
+	return;
+
+error:
+	// We get here if call alloc was ok, but something else is not.
+	// Roll back the last call to prevent drawing it.
+	if (sw->ncalls > 0) sw->ncalls--;
+}
+
+static void swnvg__renderDelete(void* uptr)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)uptr;
+	int i;
+	if (sw == NULL) return;
+
+	for (i = 0; i < sw->ntextures; i++)
+		nvgInternalFree(sw->textures[i].data);
+	nvgInternalFree(sw->textures);
+
+	nvgInternalFree(sw->stencil);
+
+	if (sw->frameAllocator.alloc == NULL) {
+		nvgInternalFree(sw->paths);
+		nvgInternalFree(sw->verts);
+		nvgInternalFree(sw->uniforms);
+		nvgInternalFree(sw->calls);
+	}
+
+	nvgInternalFree(sw);
+}
+
+NVGcontext* nvgCreateSW(int flags)
+{
+	return nvgCreateSWWithAllocator(flags, NULL);
+}
+
+NVGcontext* nvgCreateSWWithAllocator(int flags, NVGallocator* allocator)
+{
+	NVGparams params;
+	NVGcontext* ctx = NULL;
+	SWNVGcontext* sw = (SWNVGcontext*)nvgInternalAlloc(allocator, NVG_MEMORY_BACKEND, sizeof(SWNVGcontext));
+	if (sw == NULL) goto error;
+	memset(sw, 0, sizeof(SWNVGcontext));
+	sw->allocator = allocator;
+
+	memset(&params, 0, sizeof(params));
+	params.allocator = allocator;
+	params.renderCreate = swnvg__renderCreate;
+	params.renderCreateTexture = swnvg__renderCreateTexture;
+	params.renderDeleteTexture = swnvg__renderDeleteTexture;
+	params.renderUpdateTexture = swnvg__renderUpdateTexture;
+	params.renderGetTextureSize = swnvg__renderGetTextureSize;
+	params.renderViewport = swnvg__renderViewport;
+	params.renderCancel = swnvg__renderCancel;
+	params.renderFlush = swnvg__renderFlush;
+	params.renderFill = swnvg__renderFill;
+	params.renderStroke = swnvg__renderStroke;
+	params.renderTriangles = swnvg__renderTriangles;
+	params.renderDelete = swnvg__renderDelete;
+	params.userPtr = sw;
+	params.edgeAntiAlias = flags & NVG_ANTIALIAS ? 1 : 0;
+	params.sdfText = flags & NVG_SDF_TEXT ? 1 : 0;
+	params.triangulatedFills = 1;
+
+	sw->flags = flags;
+
+	ctx = nvgCreateInternal(&params);
+	if (ctx == NULL) goto error;
+
+	sw->allocator = nvgInternalParams(ctx)->allocator;
+	sw->frameAllocator = nvgInternalParams(ctx)->frameAllocator;
+
+	return ctx;
+
+error:
+	// 'sw' is freed by nvgDeleteInternal.
+	if (ctx != NULL) nvgDeleteInternal(ctx);
+	return NULL;
+}
+
+void nvgDeleteSW(NVGcontext* ctx)
+{
+	nvgDeleteInternal(ctx);
+}
+
+int nvgswSetFramebuffer(NVGcontext* ctx, unsigned char* pixels, int w, int h, int stride)
+{
+	SWNVGcontext* sw = (SWNVGcontext*)nvgInternalParams(ctx)->userPtr;
+
+	if (pixels != NULL && w*h > sw->cstencil) {
+		unsigned char* stencil = (unsigned char*)nvgInternalRealloc(sw->allocator, NVG_MEMORY_BACKEND, sw->stencil, w*h);
+		if (stencil == NULL) return 0;
+		sw->stencil = stencil;
+		sw->cstencil = w*h;
+	}
+
+	sw->pixels = pixels;
+	sw->width = w;
+	sw->height = h;
+	sw->stride = stride;
+
+	return 1;
+}
+
+#endif /* NANOVG_SW_IMPLEMENTATION */